@@ -0,0 +1,526 @@
+#ifndef ASSET_COOKER_H
+#define ASSET_COOKER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <functional>
+#include <chrono>
+#include <mutex>
+#include <algorithm>
+#include <cstdlib>
+
+#include <sys/stat.h>
+
+#include "Hash.h"
+#include "ThreadPool.h"
+#include "OBJImporter.h"
+
+// Offline asset cooking driven by a dependency graph (OBJ -> MTL -> textures -> outputs).
+// Every file is identified by its content hash; the hashes used to produce each output
+// are stored in a manifest so that only outputs whose inputs changed get rebuilt.
+
+enum AssetKind
+{
+  ASSET_OBJ,
+  ASSET_MTL,
+  ASSET_TEXTURE,
+  ASSET_OTHER
+};
+
+struct AssetNode
+{
+  std::string path;
+  AssetKind kind = ASSET_OTHER;
+  std::vector<std::string> deps; // files referenced by this one
+  std::string mtlKey;            // textures: map_Kd, map_Ks, map_bump or map_d
+};
+
+struct CookJob
+{
+  std::string rule;
+  std::string output;
+  std::vector<std::string> inputs;
+  std::string params; // rule options, a change forces a rebuild
+
+  // Filled by Cook()
+  bool stale = false;
+  bool ok = true;
+  std::string reason;
+  std::string report; // optional one line summary set by the rule
+  double ms = 0.0;
+};
+
+// First line of the manifest, bumped when its records change
+const char* const MANIFEST_HEADER = "# asset cooker manifest 2, do not edit";
+
+struct CookRule
+{
+  std::string name;
+  unsigned int version;
+  std::function<bool(CookJob&)> build;
+};
+
+class AssetCooker
+{
+  public:
+    AssetCooker(const std::string& manifestPath) : manifestPath(manifestPath)
+    {
+      loadManifest();
+    }
+
+    void AddRule(const CookRule& rule)
+    {
+      rules[rule.name] = rule;
+    }
+
+    // Record OBJ -> MTL -> texture edges, returns the OBJ and MTL paths
+    std::vector<std::string> ScanModel(const std::string& objPath)
+    {
+      std::vector<std::string> files;
+      files.push_back(objPath);
+
+      AssetNode& obj = addNode(objPath, ASSET_OBJ);
+      std::string dir = objPath.substr(0, objPath.find_last_of("\\/"));
+
+      std::ifstream in(objPath);
+      std::string line;
+      while (getline(in, line))
+      {
+        if (line.substr(0, 7) != "mtllib ")
+          continue;
+
+        std::istringstream s(line.substr(7));
+        std::string mtl;
+        s >> mtl;
+        mtl = dir + "/" + mtl;
+
+        obj.deps.push_back(mtl);
+        files.push_back(mtl);
+        scanMtl(mtl);
+      }
+
+      return files;
+    }
+
+    // Record MTL -> texture edges of a material library not reached through an OBJ
+    void ScanMtl(const std::string& mtlPath)
+    {
+      scanMtl(mtlPath);
+    }
+
+    // Textures referenced by every scanned MTL
+    std::vector<std::string> Textures() const
+    {
+      std::vector<std::string> textures;
+      for (auto& n : nodes)
+        if (n.second.kind == ASSET_TEXTURE)
+          textures.push_back(n.first);
+      return textures;
+    }
+
+    // Textures referenced by the MTLs of one scanned model
+    std::vector<std::string> ModelTextures(const std::string& objPath) const
+    {
+      std::vector<std::string> textures;
+      auto obj = nodes.find(objPath);
+      if (obj == nodes.end())
+        return textures;
+      for (const std::string& mtl : obj->second.deps)
+      {
+        auto m = nodes.find(mtl);
+        if (m != nodes.end())
+          textures.insert(textures.end(), m->second.deps.begin(), m->second.deps.end());
+      }
+      return textures;
+    }
+
+    const AssetNode* Node(const std::string& path) const
+    {
+      auto n = nodes.find(path);
+      return n != nodes.end() ? &n->second : nullptr;
+    }
+
+    // Whether path was produced by a previous run (as opposed to a hand made file)
+    bool IsCookedOutput(const std::string& path) const
+    {
+      return outputs.find(path) != outputs.end();
+    }
+
+    const std::vector<CookJob>& Jobs() const { return jobs; }
+
+    void AddJob(const std::string& rule, const std::string& output, const std::vector<std::string>& inputs, const std::string& params = "")
+    {
+      CookJob job;
+      job.rule = rule;
+      job.output = output;
+      job.inputs = inputs;
+      job.params = params;
+      jobs.push_back(job);
+    }
+
+    // Rebuild stale outputs on the pool, returns false if any job failed
+    bool Cook(ThreadPool& pool, bool force = false)
+    {
+      hashInputs(pool);
+
+      std::mutex printMutex;
+      for (unsigned int i = 0; i < jobs.size(); i++)
+      {
+        CookJob& job = jobs[i];
+        if (rules.find(job.rule) == rules.end())
+        {
+          job.ok = false;
+          job.reason = "unknown rule " + job.rule;
+          continue;
+        }
+
+        job.stale = force || isStale(job);
+        if (force)
+          job.reason = "forced";
+        if (!job.stale)
+          continue;
+
+        const CookRule& rule = rules[job.rule];
+        pool.Submit([&job, &rule, &printMutex] {
+          auto start = std::chrono::high_resolution_clock::now();
+          job.ok = rule.build(job);
+          auto end = std::chrono::high_resolution_clock::now();
+          job.ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+          std::lock_guard<std::mutex> lock(printMutex);
+          std::cout << (job.ok ? "cooked " : "FAILED ") << job.output << " (" << job.reason << ")" << std::endl;
+        });
+      }
+      pool.WaitIdle();
+
+      bool ok = true;
+      for (unsigned int i = 0; i < jobs.size(); i++)
+      {
+        CookJob& job = jobs[i];
+        if (!job.ok)
+        {
+          ok = false;
+          outputs.erase(job.output);
+          continue;
+        }
+        if (job.stale)
+          recordOutput(job);
+      }
+
+      saveManifest();
+      return ok;
+    }
+
+    void PrintGraph() const
+    {
+      for (auto& n : nodes)
+      {
+        if (n.second.kind != ASSET_OBJ)
+          continue;
+        printNode(n.first, 0);
+      }
+    }
+
+    void PrintSummary() const
+    {
+      std::vector<const CookJob*> sorted;
+      double total = 0.0;
+      unsigned int rebuilt = 0;
+      for (unsigned int i = 0; i < jobs.size(); i++)
+      {
+        sorted.push_back(&jobs[i]);
+        total += jobs[i].ms;
+        if (jobs[i].stale)
+          rebuilt++;
+      }
+      std::sort(sorted.begin(), sorted.end(), [](const CookJob* a, const CookJob* b) { return a->ms > b->ms; });
+
+      printf("\n%-10s %-50s %10s  %s\n", "rule", "output", "ms", "status");
+      for (const CookJob* job : sorted)
+      {
+        const char* status = !job->ok ? "failed" : (job->stale ? "rebuilt" : "up to date");
+        printf("%-10s %-50s %10.1f  %s%s%s\n", job->rule.c_str(), job->output.c_str(), job->ms, status,
+            job->reason.empty() ? "" : ": ", job->reason.c_str());
+      }
+      printf("%u/%u outputs rebuilt, %.1f ms of cooking\n", rebuilt, (unsigned int)jobs.size(), total);
+    }
+
+  private:
+    struct FileStamp
+    {
+      uint64_t hash = 0;
+      long long size = -1;
+      long long mtime = -1;
+    };
+
+    struct OutputRecord
+    {
+      std::string rule;
+      unsigned int version = 0;
+      uint64_t hash = 0;
+      uint64_t params = 0;
+      std::map<std::string, uint64_t> inputs;
+    };
+
+    std::string manifestPath;
+    std::map<std::string, CookRule> rules;
+    std::map<std::string, AssetNode> nodes;
+    std::vector<CookJob> jobs;
+
+    std::map<std::string, FileStamp> stamps;     // last known hash of every file
+    std::map<std::string, OutputRecord> outputs; // what each output was built from
+    std::map<std::string, FileStamp> current;    // hashes for this run
+
+    AssetNode& addNode(const std::string& path, AssetKind kind)
+    {
+      AssetNode& node = nodes[path];
+      node.path = path;
+      node.kind = kind;
+      return node;
+    }
+
+    void scanMtl(const std::string& mtlPath)
+    {
+      AssetNode& mtl = addNode(mtlPath, ASSET_MTL);
+      std::string dir = mtlPath.substr(0, mtlPath.find_last_of("\\/"));
+
+      std::ifstream in(mtlPath);
+      std::string line;
+      while (getline(in, line))
+      {
+        size_t space = line.find(' ');
+        std::string key = line.substr(0, space);
+        if (space == std::string::npos || (key != "map_Kd" && key != "map_Ks" && key != "map_bump" && key != "map_d"))
+          continue;
+
+        std::istringstream s(line.substr(space + 1));
+        std::string tex;
+        s >> tex;
+        tex = OBJImporter::resolveTexturePath(dir, tex);
+
+        if (std::find(mtl.deps.begin(), mtl.deps.end(), tex) == mtl.deps.end())
+          mtl.deps.push_back(tex);
+        addNode(tex, ASSET_TEXTURE).mtlKey = key;
+      }
+    }
+
+    void printNode(const std::string& path, int depth) const
+    {
+      auto it = nodes.find(path);
+      auto stamp = current.find(path);
+      printf("%*s%s %s\n", depth * 2, "", path.c_str(),
+          stamp != current.end() ? hashToString(stamp->second.hash).c_str() : "");
+      if (it == nodes.end())
+        return;
+      for (const std::string& dep : it->second.deps)
+        printNode(dep, depth + 1);
+
+      // Outputs built from this file
+      for (const CookJob& job : jobs)
+        if (!job.inputs.empty() && job.inputs[0] == path)
+          printf("%*s-> %s [%s]\n", (depth + 1) * 2, "", job.output.c_str(), job.rule.c_str());
+    }
+
+    static bool statFile(const std::string& path, FileStamp& stamp)
+    {
+      struct stat st;
+      if (stat(path.c_str(), &st) != 0)
+        return false;
+      stamp.size = st.st_size;
+      stamp.mtime = st.st_mtime;
+      return true;
+    }
+
+    // Content hash every input (and output, to detect hand edits). Files whose size and
+    // mtime match the manifest reuse the stored hash instead of being read again.
+    void hashInputs(ThreadPool& pool)
+    {
+      std::set<std::string> files;
+      for (const CookJob& job : jobs)
+      {
+        files.insert(job.output);
+        for (const std::string& input : job.inputs)
+          files.insert(input);
+      }
+      for (auto& n : nodes)
+        files.insert(n.first);
+
+      std::mutex mutex;
+      for (const std::string& file : files)
+      {
+        pool.Submit([this, file, &mutex] {
+          FileStamp stamp;
+          if (!statFile(file, stamp))
+            return;
+
+          auto known = stamps.find(file);
+          if (known != stamps.end() && known->second.size == stamp.size && known->second.mtime == stamp.mtime)
+            stamp.hash = known->second.hash;
+          else if (!hashFile(file, stamp.hash))
+            return;
+
+          std::lock_guard<std::mutex> lock(mutex);
+          current[file] = stamp;
+        });
+      }
+      pool.WaitIdle();
+    }
+
+    bool isStale(CookJob& job)
+    {
+      auto record = outputs.find(job.output);
+      if (record == outputs.end())
+      {
+        job.reason = "never cooked";
+        return true;
+      }
+
+      const OutputRecord& r = record->second;
+      if (r.rule != job.rule || r.version != rules[job.rule].version)
+      {
+        job.reason = "rule " + job.rule + " updated";
+        return true;
+      }
+
+      if (r.params != hashString(job.params))
+      {
+        job.reason = "options changed";
+        return true;
+      }
+
+      auto out = current.find(job.output);
+      if (out == current.end())
+      {
+        job.reason = "output missing";
+        return true;
+      }
+      if (out->second.hash != r.hash)
+      {
+        job.reason = "output modified";
+        return true;
+      }
+
+      if (r.inputs.size() != job.inputs.size())
+      {
+        job.reason = "inputs changed";
+        return true;
+      }
+
+      for (const std::string& input : job.inputs)
+      {
+        auto known = r.inputs.find(input);
+        auto now = current.find(input);
+        if (now == current.end())
+        {
+          job.reason = input + " missing";
+          return true;
+        }
+        if (known == r.inputs.end() || known->second != now->second.hash)
+        {
+          job.reason = input + " changed";
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    void recordOutput(const CookJob& job)
+    {
+      OutputRecord r;
+      r.rule = job.rule;
+      r.version = rules[job.rule].version;
+      r.params = hashString(job.params);
+      for (const std::string& input : job.inputs)
+        r.inputs[input] = current[input].hash;
+
+      FileStamp stamp;
+      if (statFile(job.output, stamp) && hashFile(job.output, stamp.hash))
+      {
+        r.hash = stamp.hash;
+        current[job.output] = stamp;
+      }
+      outputs[job.output] = r;
+    }
+
+    // A manifest of another version (or a damaged record) is ignored: what it described
+    // is rebuilt
+    void loadManifest()
+    {
+      std::ifstream in(manifestPath);
+      std::string line;
+      if (!getline(in, line) || line != MANIFEST_HEADER)
+        return;
+
+      OutputRecord* last = nullptr;
+      std::string lastPath;
+      while (getline(in, line))
+      {
+        std::istringstream s(line);
+        std::string type, hash, path;
+        s >> type;
+        if (type == "file")
+        {
+          FileStamp stamp;
+          if (s >> hash >> stamp.size >> stamp.mtime >> std::ws && getline(s, path) && parseHash(hash, stamp.hash))
+            stamps[path] = stamp;
+        }
+        else if (type == "output")
+        {
+          OutputRecord r;
+          std::string params;
+          last = nullptr;
+          if (s >> r.rule >> r.version >> hash >> params >> std::ws && getline(s, path) && parseHash(hash, r.hash)
+              && parseHash(params, r.params))
+          {
+            last = &(outputs[path] = r);
+            lastPath = path;
+          }
+        }
+        else if (type == "input" && last)
+        {
+          uint64_t h;
+          if (s >> hash >> std::ws && getline(s, path) && parseHash(hash, h))
+            last->inputs[path] = h;
+          else
+          {
+            // Without all its inputs the output can't be checked
+            outputs.erase(lastPath);
+            last = nullptr;
+          }
+        }
+      }
+    }
+
+    static bool parseHash(const std::string& s, uint64_t& h)
+    {
+      char* end = nullptr;
+      h = strtoull(s.c_str(), &end, 16);
+      return !s.empty() && *end == '\0';
+    }
+
+    void saveManifest()
+    {
+      // Keep stamps of files not seen this run (other invocations may cook them)
+      for (auto& c : current)
+        stamps[c.first] = c.second;
+
+      std::ofstream out(manifestPath);
+      out << MANIFEST_HEADER << std::endl;
+      for (auto& s : stamps)
+        out << "file " << hashToString(s.second.hash) << " " << s.second.size << " " << s.second.mtime << " " << s.first << std::endl;
+      for (auto& o : outputs)
+      {
+        out << "output " << o.second.rule << " " << o.second.version << " " << hashToString(o.second.hash) << " " << hashToString(o.second.params) << " " << o.first << std::endl;
+        for (auto& i : o.second.inputs)
+          out << "input " << hashToString(i.second) << " " << i.first << std::endl;
+      }
+    }
+};
+
+#endif
@@ -0,0 +1,265 @@
+#ifndef BC_ENCODER_H
+#define BC_ENCODER_H
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Block compression (BC1/BC3/BC4/BC5) of 4x4 pixel blocks. Blocks come in as 16
+// RGBA8 pixels in row order; output layouts follow the D3D/S3TC/RGTC specs so the
+// result can be uploaded with glCompressedTexImage2D as is.
+
+inline uint16_t packRGB565(const float c[3])
+{
+  int r = std::min(31, std::max(0, (int)(c[0] * 31.0f / 255.0f + 0.5f)));
+  int g = std::min(63, std::max(0, (int)(c[1] * 63.0f / 255.0f + 0.5f)));
+  int b = std::min(31, std::max(0, (int)(c[2] * 31.0f / 255.0f + 0.5f)));
+  return (r << 11) | (g << 5) | b;
+}
+
+inline void unpackRGB565(uint16_t c, float out[3])
+{
+  int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+  out[0] = (r << 3) | (r >> 2);
+  out[1] = (g << 2) | (g >> 4);
+  out[2] = (b << 3) | (b >> 2);
+}
+
+// Nearest palette entry for each of the 16 pixels (4 entries, RGB distance)
+inline void bc1SelectIndices(const float r[16], const float g[16], const float b[16], const float palette[4][3], unsigned int indices[16])
+{
+#ifdef __SSE2__
+  for (unsigned int i = 0; i < 16; i += 4)
+  {
+    __m128 pr = _mm_loadu_ps(r + i), pg = _mm_loadu_ps(g + i), pb = _mm_loadu_ps(b + i);
+    __m128 best = _mm_set1_ps(INFINITY);
+    __m128i bestIndex = _mm_setzero_si128();
+    for (int p = 0; p < 4; p++)
+    {
+      __m128 dr = _mm_sub_ps(pr, _mm_set1_ps(palette[p][0]));
+      __m128 dg = _mm_sub_ps(pg, _mm_set1_ps(palette[p][1]));
+      __m128 db = _mm_sub_ps(pb, _mm_set1_ps(palette[p][2]));
+      __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+      __m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+      best = _mm_min_ps(d, best);
+      bestIndex = _mm_or_si128(_mm_andnot_si128(closer, bestIndex), _mm_and_si128(closer, _mm_set1_epi32(p)));
+    }
+    int out[4];
+    _mm_storeu_si128((__m128i*)out, bestIndex);
+    for (int k = 0; k < 4; k++)
+      indices[i + k] = out[k];
+  }
+#else
+  for (unsigned int i = 0; i < 16; i++)
+  {
+    float best = INFINITY;
+    for (unsigned int p = 0; p < 4; p++)
+    {
+      float dr = r[i] - palette[p][0], dg = g[i] - palette[p][1], db = b[i] - palette[p][2];
+      float d = dr * dr + dg * dg + db * db;
+      if (d < best)
+      {
+        best = d;
+        indices[i] = p;
+      }
+    }
+  }
+#endif
+}
+
+// Endpoints along the principal axis of the block colors
+inline void bc1Endpoints(const float r[16], const float g[16], const float b[16], float e0[3], float e1[3])
+{
+  float mean[3] = { 0, 0, 0 };
+  for (int i = 0; i < 16; i++)
+  {
+    mean[0] += r[i]; mean[1] += g[i]; mean[2] += b[i];
+  }
+  for (int c = 0; c < 3; c++)
+    mean[c] /= 16.0f;
+
+  float cov[6] = { 0, 0, 0, 0, 0, 0 };
+  for (int i = 0; i < 16; i++)
+  {
+    float d[3] = { r[i] - mean[0], g[i] - mean[1], b[i] - mean[2] };
+    cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+    cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+  }
+
+  // Power iteration
+  float axis[3] = { 1.0f, 1.0f, 1.0f };
+  for (int it = 0; it < 6; it++)
+  {
+    float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+    float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+    float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+    float len = std::sqrt(x * x + y * y + z * z);
+    if (len < 1e-6f)
+      break;
+    axis[0] = x / len; axis[1] = y / len; axis[2] = z / len;
+  }
+
+  float lo = INFINITY, hi = -INFINITY;
+  for (int i = 0; i < 16; i++)
+  {
+    float t = (r[i] - mean[0]) * axis[0] + (g[i] - mean[1]) * axis[1] + (b[i] - mean[2]) * axis[2];
+    lo = std::min(lo, t);
+    hi = std::max(hi, t);
+  }
+
+  // Inset slightly: the extremes are rarely worth a whole endpoint
+  float inset = (hi - lo) / 16.0f;
+  lo += inset;
+  hi -= inset;
+  for (int c = 0; c < 3; c++)
+  {
+    e0[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * hi));
+    e1[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * lo));
+  }
+}
+
+// 8 byte opaque color block (always 4 color mode)
+inline void encodeBC1Block(const uint8_t rgba[64], uint8_t out[8])
+{
+  float r[16], g[16], b[16];
+  for (int i = 0; i < 16; i++)
+  {
+    r[i] = rgba[i * 4 + 0]; g[i] = rgba[i * 4 + 1]; b[i] = rgba[i * 4 + 2];
+  }
+
+  float e0[3], e1[3];
+  bc1Endpoints(r, g, b, e0, e1);
+  uint16_t c0 = packRGB565(e0), c1 = packRGB565(e1);
+
+  uint32_t bits = 0;
+  if (c0 == c1)
+  {
+    // Flat block, every pixel uses c0 (index 0)
+  }
+  else
+  {
+    if (c0 < c1)
+      std::swap(c0, c1);
+
+    float palette[4][3];
+    unpackRGB565(c0, palette[0]);
+    unpackRGB565(c1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+      palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+      palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+
+    unsigned int indices[16];
+    bc1SelectIndices(r, g, b, palette, indices);
+    for (int i = 0; i < 16; i++)
+      bits |= indices[i] << (i * 2);
+  }
+
+  out[0] = c0 & 0xff; out[1] = c0 >> 8;
+  out[2] = c1 & 0xff; out[3] = c1 >> 8;
+  out[4] = bits & 0xff; out[5] = (bits >> 8) & 0xff; out[6] = (bits >> 16) & 0xff; out[7] = bits >> 24;
+}
+
+// 8 byte single channel block (8 value mode), channel is the byte offset in the pixel
+inline void encodeBC4Block(const uint8_t rgba[64], unsigned int channel, uint8_t out[8])
+{
+  int lo = 255, hi = 0;
+  for (int i = 0; i < 16; i++)
+  {
+    lo = std::min(lo, (int)rgba[i * 4 + channel]);
+    hi = std::max(hi, (int)rgba[i * 4 + channel]);
+  }
+
+  out[0] = hi;
+  out[1] = lo;
+
+  uint64_t bits = 0;
+  if (hi != lo)
+  {
+    // Palette is ordered hi, lo, then 6 interpolants from hi to lo
+    static const unsigned int order[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+    for (int i = 0; i < 16; i++)
+    {
+      int step = (int)std::floor((rgba[i * 4 + channel] - lo) * 7.0f / (hi - lo) + 0.5f);
+      bits |= (uint64_t)order[step] << (i * 3);
+    }
+  }
+
+  for (int i = 0; i < 6; i++)
+    out[2 + i] = (bits >> (i * 8)) & 0xff;
+}
+
+inline void encodeBC3Block(const uint8_t rgba[64], uint8_t out[16])
+{
+  encodeBC4Block(rgba, 3, out);
+  encodeBC1Block(rgba, out + 8);
+}
+
+inline void encodeBC5Block(const uint8_t rgba[64], uint8_t out[16])
+{
+  encodeBC4Block(rgba, 0, out);
+  encodeBC4Block(rgba, 1, out + 8);
+}
+
+// Decoders, used to measure the encoding error
+
+inline void decodeBC1Block(const uint8_t in[8], uint8_t rgba[64])
+{
+  uint16_t c0 = in[0] | (in[1] << 8), c1 = in[2] | (in[3] << 8);
+  uint32_t bits = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t)in[7] << 24);
+
+  float palette[4][3];
+  unpackRGB565(c0, palette[0]);
+  unpackRGB565(c1, palette[1]);
+  for (int c = 0; c < 3; c++)
+  {
+    if (c0 > c1)
+    {
+      palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+      palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+    else
+    {
+      palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0f;
+      palette[3][c] = 0.0f;
+    }
+  }
+
+  for (int i = 0; i < 16; i++)
+  {
+    unsigned int idx = (bits >> (i * 2)) & 3;
+    for (int c = 0; c < 3; c++)
+      rgba[i * 4 + c] = (uint8_t)(palette[idx][c] + 0.5f);
+  }
+}
+
+inline void decodeBC4Block(const uint8_t in[8], unsigned int channel, uint8_t rgba[64])
+{
+  float palette[8];
+  palette[0] = in[0];
+  palette[1] = in[1];
+  if (in[0] > in[1])
+    for (int i = 1; i < 7; i++)
+      palette[i + 1] = ((7 - i) * palette[0] + i * palette[1]) / 7.0f;
+  else
+  {
+    for (int i = 1; i < 5; i++)
+      palette[i + 1] = ((5 - i) * palette[0] + i * palette[1]) / 5.0f;
+    palette[6] = 0.0f;
+    palette[7] = 255.0f;
+  }
+
+  uint64_t bits = 0;
+  for (int i = 0; i < 6; i++)
+    bits |= (uint64_t)in[2 + i] << (i * 8);
+  for (int i = 0; i < 16; i++)
+    rgba[i * 4 + channel] = (uint8_t)(palette[(bits >> (i * 3)) & 7] + 0.5f);
+}
+
+#endif
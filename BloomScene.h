@@ -1,6 +1,7 @@
 #ifndef BLOOM_SCENE_H
 #define BLOOM_SCENE_H
 
+#include "GLState.h"
 #include "Scene.h"
 #include "Model.h"
 
@@ -16,13 +17,13 @@ class BloomScene : public Scene
 
       // Configure (floating point) framebuffers
       glGenFramebuffers(1, &hdrFBO);
-      glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+      glState().BindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
 
       // Create 2 floating point color buffers (1 for normal rendering, other for brightness treshold values)
       glGenTextures(2, colorBuffers);
       for (unsigned int i = 0; i < 2; i++)
       {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
+        glState().BindTexture(GL_TEXTURE_2D, colorBuffers[i]);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, NULL);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -43,15 +44,15 @@ class BloomScene : public Scene
       // Finally check if framebuffer is complete
       if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "Framebuffer not complete!" << std::endl;
-      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
 
       // Ping-pong-framebuffer for blurring
       glGenFramebuffers(2, pingpongFBO);
       glGenTextures(2, pingpongColorbuffers);
       for (unsigned int i = 0; i < 2; i++)
       {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
+        glState().BindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
+        glState().BindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, NULL);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -81,13 +82,26 @@ class BloomScene : public Scene
       shaderBlur = new Shader("res/shaders/bloom/blur.vs", "res/shaders/bloom/blur.fs");
       shaderBloomFinal = new Shader("res/shaders/bloom/bloom_final.vs", "res/shaders/bloom/bloom_final.fs");
 
-      shader->use();
-      shader->setInt("diffuseTexture", 0);
-      shaderBlur->use();
-      shaderBlur->setInt("image", 0);
-      shaderBloomFinal->use();
-      shaderBloomFinal->setInt("scene", 0);
-      shaderBloomFinal->setInt("bloomBlur", 1);
+      // Set again on the new programs when the shaders are reloaded
+      shader->onReload = [this](Shader& s) {
+        for (unsigned int i = 0; i < lightPositions.size() && i < 4; i++)
+        {
+          lightPositionUniforms[i] = s.Get<glm::vec3>("lights[" + std::to_string(i) + "].Position");
+          lightColorUniforms[i] = s.Get<glm::vec3>("lights[" + std::to_string(i) + "].Color");
+        }
+        s.setInt("diffuseTexture", 0);
+      };
+      shaderBlur->onReload = [](Shader& s) { s.setInt("image", 0); };
+      shaderBloomFinal->onReload = [](Shader& s) {
+        s.setInt("scene", 0);
+        s.setInt("bloomBlur", 1);
+      };
+
+      for (Shader* s : { shader, shaderBlur, shaderBloomFinal })
+      {
+        s->use();
+        s->onReload(*s);
+      }
     }
 
     void Draw()
@@ -96,7 +110,7 @@ class BloomScene : public Scene
      
       // 1. render scene into floating point framebuffer
       // -----------------------------------------------
-      glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+      glState().BindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
       glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)s_WindowWidth / (float)s_WindowHeight, 0.1f, 100.0f);
       glm::mat4 view = camera.GetViewMatrix();
@@ -106,10 +120,10 @@ class BloomScene : public Scene
       shader->setMat4("view", view);
 
       // set lighting uniforms
-      for (unsigned int i = 0; i < lightPositions.size(); i++)
+      for (unsigned int i = 0; i < lightPositions.size() && i < 4; i++)
       {
-        shader->setVec3("lights[" + std::to_string(i) + "].Position", lightPositions[i]);
-        shader->setVec3("lights[" + std::to_string(i) + "].Color", lightColors[i]);
+        shader->set(lightPositionUniforms[i], lightPositions[i]);
+        shader->set(lightColorUniforms[i], lightColors[i]);
       }
       shader->setVec3("viewPos", camera.Position);
 
@@ -133,7 +147,7 @@ class BloomScene : public Scene
         shaderLight->setVec3("lightColor", lightColors[i]);
         m_Lamp->Draw(*shaderLight);
       }
-      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
 
       // 2. blur bright fragments with two-pass Gaussian Blur
       // --------------------------------------------------
@@ -142,23 +156,23 @@ class BloomScene : public Scene
       shaderBlur->use();
       for (unsigned int i = 0; i < amount; i++)
       {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
+        glState().BindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
         shaderBlur->setInt("horizontal", horizontal);
-        glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
+        glState().BindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
         renderQuad();
         horizontal = !horizontal;
         if (first_iteration)
           first_iteration = false;
       }
-      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
 
       // 3. now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
       shaderBloomFinal->use();
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-      glActiveTexture(GL_TEXTURE1);
-      glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
+      glState().ActiveTexture(GL_TEXTURE0);
+      glState().BindTexture(GL_TEXTURE_2D, colorBuffers[0]);
+      glState().ActiveTexture(GL_TEXTURE1);
+      glState().BindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
       shaderBloomFinal->setInt("bloom", bloom);
       shaderBloomFinal->setFloat("exposure", exposure);
       renderQuad();
@@ -181,6 +195,7 @@ class BloomScene : public Scene
 
     std::vector<glm::vec3> lightPositions;
     std::vector<glm::vec3> lightColors;
+    Uniform<glm::vec3> lightPositionUniforms[4], lightColorUniforms[4]; // lights[i] of bloom.fs
 
     float exposure = 1.0f;
     bool bloom = true;
@@ -201,7 +216,7 @@ class BloomScene : public Scene
         // setup plane VAO
         glGenVertexArrays(1, &quadVAO);
         glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
+        glState().BindVertexArray(quadVAO);
         glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -209,9 +224,9 @@ class BloomScene : public Scene
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
       }
-      glBindVertexArray(quadVAO);
+      glState().BindVertexArray(quadVAO);
       glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-      glBindVertexArray(0);
+      glState().BindVertexArray(0);
     }
 };
 
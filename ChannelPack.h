@@ -0,0 +1,104 @@
+#ifndef CHANNEL_PACK_H
+#define CHANNEL_PACK_H
+
+#include <string>
+#include <iostream>
+#include <algorithm>
+
+#include <sys/stat.h>
+
+#include "dep/stb_image/stb_image.h"
+
+#include "MipChain.h"
+
+// Material maps with a single useful channel (alpha mask, specular intensity) ride in
+// the alpha channel of the diffuse map instead of a texture of their own: one array
+// layer, one bind and one sample less per mesh, and a BC3 diffuse takes as much memory
+// as the BC1 diffuse and BC4 mask it replaces. The combined image has no file of its
+// own, it is named after both sources ("dir/diffuse.png+mask.png") and cooked into
+// "dir/diffuse+mask.dds" (see ddsPath).
+enum PackedAlpha
+{
+  PACKED_NONE = 0,
+  PACKED_MASK,
+  PACKED_SPECULAR
+};
+
+static bool fileExists(const std::string& path)
+{
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+// Map to move into the diffuse alpha: the mask when there is one (discarding needs it
+// at full rate), the specular map otherwise
+static std::string packedAlphaMap(const std::string& maskPath, const std::string& specularPath, PackedAlpha& usage)
+{
+  usage = !maskPath.empty() ? PACKED_MASK : !specularPath.empty() ? PACKED_SPECULAR : PACKED_NONE;
+  return usage == PACKED_MASK ? maskPath : specularPath;
+}
+
+// Name of the combined image, empty when the maps cannot be packed (missing, or in
+// different directories)
+static std::string packedTexturePath(const std::string& diffusePath, const std::string& alphaPath)
+{
+  if (diffusePath.empty() || alphaPath.empty())
+    return "";
+
+  size_t slash = diffusePath.find_last_of('/');
+  std::string dir = slash == std::string::npos ? "" : diffusePath.substr(0, slash + 1);
+  if (alphaPath.compare(0, dir.size(), dir) != 0 || alphaPath.find('/', dir.size()) != std::string::npos)
+    return "";
+  if (!fileExists(diffusePath) || !fileExists(alphaPath))
+    return "";
+  return diffusePath + "+" + alphaPath.substr(dir.size());
+}
+
+static bool isPackedTexturePath(const std::string& path)
+{
+  size_t slash = path.find_last_of('/');
+  return path.find('+', slash == std::string::npos ? 0 : slash) != std::string::npos;
+}
+
+static void splitPackedTexturePath(const std::string& path, std::string& diffusePath, std::string& alphaPath)
+{
+  size_t slash = path.find_last_of('/');
+  size_t plus = path.find('+', slash == std::string::npos ? 0 : slash);
+  diffusePath = path.substr(0, plus);
+  alphaPath = path.substr(0, slash == std::string::npos ? 0 : slash + 1) + path.substr(plus + 1);
+}
+
+// Diffuse rgb with the red channel of the other map as alpha, resized to the diffuse
+static bool loadPackedImage(const std::string& path, MipImage& img)
+{
+  std::string diffusePath, alphaPath;
+  splitPackedTexturePath(path, diffusePath, alphaPath);
+
+  int n;
+  unsigned char* data = stbi_load(diffusePath.c_str(), &img.width, &img.height, &n, 4);
+  if (!data)
+  {
+    std::cerr << "Cannot load " << diffusePath << std::endl;
+    return false;
+  }
+  img.rgba.assign(data, data + (size_t)img.width * img.height * 4);
+  stbi_image_free(data);
+
+  MipImage alpha;
+  data = stbi_load(alphaPath.c_str(), &alpha.width, &alpha.height, &n, 4);
+  if (!data)
+  {
+    std::cerr << "Cannot load " << alphaPath << std::endl;
+    return false;
+  }
+  alpha.rgba.assign(data, data + (size_t)alpha.width * alpha.height * 4);
+  stbi_image_free(data);
+
+  if (alpha.width != img.width || alpha.height != img.height)
+    alpha = resizeImage(alpha, img.width, img.height);
+  for (size_t i = 0; i < img.rgba.size(); i += 4)
+    img.rgba[i + 3] = alpha.rgba[i];
+  return true;
+}
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef CHUNKED_MODEL_H
+#define CHUNKED_MODEL_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+
+#include "Mesh.h"
+#include "CookedMesh.h"
+
+// Spatially chunked model file (.chunks): the model is split in a uniform grid of
+// cells, each one holding its own geometry grouped by material. A table of contents
+// at the head of the file lets the runtime seek to and read single cells.
+//
+// [header][materials][cell table][cell payloads...]
+const uint32_t CHUNKED_MODEL_MAGIC = 0x4b4e4843; // "CHNK"
+const uint32_t CHUNKED_MODEL_VERSION = 1;
+
+struct ChunkCell
+{
+  glm::vec3 min;
+  glm::vec3 max;
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct ChunkedModelHeader
+{
+  std::vector<Material> materials;
+  std::vector<ChunkCell> cells;
+};
+
+inline std::string chunkedModelPath(const std::string& objPath)
+{
+  return objPath.substr(0, objPath.find_last_of('.')) + ".chunks";
+}
+
+// Partition every triangle by centroid into cells of cellSize and write the chunk file
+inline bool writeChunkedModel(const std::string& path, const std::vector<MeshData>& meshes, float cellSize)
+{
+  glm::vec3 bmin(INFINITY), bmax(-INFINITY);
+  for (const MeshData& m : meshes)
+    for (const Vertex& v : m.vertices)
+    {
+      bmin = glm::min(bmin, v.Position);
+      bmax = glm::max(bmax, v.Position);
+    }
+
+  // Materials are shared by all cells and referenced by index
+  std::vector<Material> materials;
+  std::map<std::string, uint32_t> materialIndex;
+  for (const MeshData& m : meshes)
+    if (materialIndex.find(m.material.name) == materialIndex.end())
+    {
+      materialIndex[m.material.name] = materials.size();
+      materials.push_back(m.material);
+    }
+
+  // cell key -> material -> geometry, vertices are remapped per cell
+  struct Part
+  {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::map<uint64_t, unsigned int> remap;
+  };
+  std::map<uint64_t, std::map<uint32_t, Part>> grid;
+
+  for (unsigned int mi = 0; mi < meshes.size(); mi++)
+  {
+    const MeshData& m = meshes[mi];
+    uint32_t mat = materialIndex[m.material.name];
+    for (unsigned int i = 0; i + 2 < m.indices.size(); i += 3)
+    {
+      glm::vec3 c = (m.vertices[m.indices[i]].Position + m.vertices[m.indices[i + 1]].Position + m.vertices[m.indices[i + 2]].Position) / 3.0f;
+      glm::ivec3 cell = glm::ivec3(glm::floor((c - bmin) / cellSize));
+      uint64_t key = ((uint64_t)(cell.x & 0x1fffff) << 42) | ((uint64_t)(cell.y & 0x1fffff) << 21) | (uint64_t)(cell.z & 0x1fffff);
+
+      // Vertex indices are only unique within a source mesh
+      Part& part = grid[key][mat];
+      for (unsigned int k = 0; k < 3; k++)
+      {
+        uint64_t src = ((uint64_t)mi << 32) | m.indices[i + k];
+        auto it = part.remap.find(src);
+        if (it == part.remap.end())
+        {
+          it = part.remap.insert(std::make_pair(src, (unsigned int)part.vertices.size())).first;
+          part.vertices.push_back(m.vertices[m.indices[i + k]]);
+        }
+        part.indices.push_back(it->second);
+      }
+    }
+  }
+
+  std::ofstream out(path, std::ofstream::binary);
+  if (!out)
+  {
+    std::cerr << "Cannot write " << path << std::endl;
+    return false;
+  }
+
+  uint32_t header[4] = { CHUNKED_MODEL_MAGIC, CHUNKED_MODEL_VERSION, (uint32_t)materials.size(), (uint32_t)grid.size() };
+  out.write((const char*)header, sizeof(header));
+  for (const Material& m : materials)
+    writeMaterial(out, m);
+
+  // Reserve the table, it is filled once payload offsets are known
+  std::vector<ChunkCell> cells(grid.size());
+  std::streamoff tableOffset = out.tellp();
+  out.write((const char*)cells.data(), cells.size() * sizeof(ChunkCell));
+
+  unsigned int c = 0;
+  for (auto& g : grid)
+  {
+    ChunkCell& cell = cells[c++];
+    cell.min = glm::vec3(INFINITY);
+    cell.max = glm::vec3(-INFINITY);
+    cell.offset = out.tellp();
+
+    uint32_t parts = g.second.size();
+    out.write((const char*)&parts, sizeof(parts));
+    for (auto& p : g.second)
+    {
+      out.write((const char*)&p.first, sizeof(p.first));
+      writeArray(out, p.second.vertices);
+      writeArray(out, p.second.indices);
+      for (const Vertex& v : p.second.vertices)
+      {
+        cell.min = glm::min(cell.min, v.Position);
+        cell.max = glm::max(cell.max, v.Position);
+      }
+    }
+    cell.size = (uint64_t)out.tellp() - cell.offset;
+  }
+
+  out.seekp(tableOffset);
+  out.write((const char*)cells.data(), cells.size() * sizeof(ChunkCell));
+  return (bool)out;
+}
+
+inline bool readChunkedModelHeader(const std::string& path, ChunkedModelHeader& h)
+{
+  std::ifstream in(path, std::ifstream::binary);
+  if (!in)
+    return false;
+
+  uint32_t header[4];
+  in.read((char*)header, sizeof(header));
+  if (!in || header[0] != CHUNKED_MODEL_MAGIC || header[1] != CHUNKED_MODEL_VERSION)
+  {
+    std::cout << "Ignoring outdated chunked model " << path << std::endl;
+    return false;
+  }
+
+  h.materials.resize(header[2]);
+  for (Material& m : h.materials)
+    if (!readMaterial(in, m))
+      return false;
+
+  h.cells.resize(header[3]);
+  if (!h.cells.empty())
+    in.read((char*)&h.cells[0], h.cells.size() * sizeof(ChunkCell));
+  return (bool)in;
+}
+
+// Read back the geometry of one cell (safe to call from worker threads)
+inline bool readChunkCell(const std::string& path, const ChunkedModelHeader& h, unsigned int cell, std::vector<MeshData>& meshes)
+{
+  std::ifstream in(path, std::ifstream::binary);
+  if (!in)
+    return false;
+
+  in.seekg(h.cells[cell].offset);
+  uint32_t parts = 0;
+  in.read((char*)&parts, sizeof(parts));
+  meshes.resize(parts);
+  for (MeshData& m : meshes)
+  {
+    uint32_t mat = 0;
+    in.read((char*)&mat, sizeof(mat));
+    if (!in || mat >= h.materials.size() || !readArray(in, m.vertices) || !readArray(in, m.indices))
+      return false;
+    m.material = h.materials[mat];
+    m.name = m.material.name;
+  }
+  return true;
+}
+
+#endif
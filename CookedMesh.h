@@ -0,0 +1,137 @@
+#ifndef COOKED_MESH_H
+#define COOKED_MESH_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+
+#include "Mesh.h"
+
+// Binary dump of imported meshes, written by the cooker and loaded by Model
+// instead of parsing the OBJ/MTL text at startup.
+const uint32_t COOKED_MESH_MAGIC = 0x4853454d; // "MESH"
+const uint32_t COOKED_MESH_VERSION = 1;
+
+inline std::string cookedMeshPath(const std::string& objPath)
+{
+  return objPath.substr(0, objPath.find_last_of('.')) + ".mesh";
+}
+
+inline void writeString(std::ofstream& out, const std::string& s)
+{
+  uint32_t size = s.size();
+  out.write((const char*)&size, sizeof(size));
+  out.write(s.data(), size);
+}
+
+inline bool readString(std::ifstream& in, std::string& s)
+{
+  uint32_t size = 0;
+  in.read((char*)&size, sizeof(size));
+  if (!in || size > (1 << 16))
+    return false;
+  s.resize(size);
+  in.read(&s[0], size);
+  return (bool)in;
+}
+
+template<typename T>
+inline void writeArray(std::ofstream& out, const std::vector<T>& v)
+{
+  uint32_t size = v.size();
+  out.write((const char*)&size, sizeof(size));
+  if (size)
+    out.write((const char*)&v[0], size * sizeof(T));
+}
+
+template<typename T>
+inline bool readArray(std::ifstream& in, std::vector<T>& v)
+{
+  uint32_t size = 0;
+  in.read((char*)&size, sizeof(size));
+  if (!in)
+    return false;
+  v.resize(size);
+  if (size)
+    in.read((char*)&v[0], size * sizeof(T));
+  return (bool)in;
+}
+
+inline void writeMaterial(std::ofstream& out, const Material& m)
+{
+  writeString(out, m.name);
+  writeString(out, m.texPath);
+  writeString(out, m.normalPath);
+  writeString(out, m.specularPath);
+  writeString(out, m.maskPath);
+  out.write((const char*)&m.ambient, sizeof(glm::vec3));
+  out.write((const char*)&m.diffuse, sizeof(glm::vec3));
+  out.write((const char*)&m.specular, sizeof(glm::vec3));
+}
+
+inline bool readMaterial(std::ifstream& in, Material& m)
+{
+  if (!readString(in, m.name) || !readString(in, m.texPath) || !readString(in, m.normalPath) ||
+      !readString(in, m.specularPath) || !readString(in, m.maskPath))
+    return false;
+  in.read((char*)&m.ambient, sizeof(glm::vec3));
+  in.read((char*)&m.diffuse, sizeof(glm::vec3));
+  in.read((char*)&m.specular, sizeof(glm::vec3));
+  return (bool)in;
+}
+
+inline bool writeCookedMeshes(const std::string& path, const std::vector<MeshData>& meshes)
+{
+  std::ofstream out(path, std::ofstream::binary);
+  if (!out)
+  {
+    std::cerr << "Cannot write " << path << std::endl;
+    return false;
+  }
+
+  uint32_t header[3] = { COOKED_MESH_MAGIC, COOKED_MESH_VERSION, (uint32_t)meshes.size() };
+  out.write((const char*)header, sizeof(header));
+
+  for (unsigned int i = 0; i < meshes.size(); i++)
+  {
+    writeString(out, meshes[i].name);
+    writeMaterial(out, meshes[i].material);
+    writeArray(out, meshes[i].vertices);
+    writeArray(out, meshes[i].indices);
+  }
+
+  return (bool)out;
+}
+
+inline bool readCookedMeshes(const std::string& path, std::vector<MeshData>& meshes)
+{
+  std::ifstream in(path, std::ifstream::binary);
+  if (!in)
+    return false;
+
+  uint32_t header[3];
+  in.read((char*)header, sizeof(header));
+  if (!in || header[0] != COOKED_MESH_MAGIC || header[1] != COOKED_MESH_VERSION)
+  {
+    std::cout << "Ignoring outdated cooked mesh " << path << std::endl;
+    return false;
+  }
+
+  meshes.resize(header[2]);
+  for (unsigned int i = 0; i < meshes.size(); i++)
+  {
+    if (!readString(in, meshes[i].name) || !readMaterial(in, meshes[i].material) ||
+        !readArray(in, meshes[i].vertices) || !readArray(in, meshes[i].indices))
+    {
+      std::cout << "Corrupted cooked mesh " << path << std::endl;
+      meshes.clear();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+#endif
@@ -29,6 +29,10 @@ class CryptScene : Scene
       if (lightFollowCamera)
         m_LightPos = camera.Position;
 
+      // Sorted once, drawn by the occlusion and the main pass
+      m_RenderQueue.Begin(camera.Position, glm::mat4());
+      crypt->Submit(m_RenderQueue);
+
       // Bind Godrays
       m_Godrays->Bind();
         DrawOcclusionScene();
@@ -68,7 +72,7 @@ class CryptScene : Scene
     void DrawScene()
     {
       SetShaderParams(basicParams);
-      ((CryptModel*)crypt)->DrawCrypt(m_Projection, m_View, camera, m_LightPos, *m_UberShader); 
+      m_RenderQueue.Execute(*m_UberShader);
     }
 
     void DrawOcclusionScene()
@@ -76,7 +80,7 @@ class CryptScene : Scene
       ShaderParams p;
       p.la = p.ld = p.ls = p.s = 0.0f;
       SetShaderParams(p);
-      ((CryptModel*)crypt)->DrawCrypt(m_Projection, m_View, camera, m_LightPos, *m_UberShader); 
+      m_RenderQueue.Execute(*m_UberShader);
     }
 
     // Imgui
@@ -101,6 +105,10 @@ class CryptScene : Scene
         ImGui::Text("Light Pos = %.3f %.3f %.3f", m_LightPos.x, m_LightPos.y, m_LightPos.z);
         ImGui::Text("Camera Pos = %.3f %.3f %.3f", camera.Position.x, camera.Position.y, camera.Position.z);
 
+        ImGui::Checkbox("Sort Draws", &m_RenderQueue.enabled);
+        ImGui::Text("Render queue: %u draws, %.3f ms sort, %.3f ms submit", m_RenderQueue.Draws(),
+            m_RenderQueue.SortMs(), m_RenderQueue.SubmitMs());
+
         ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 
 
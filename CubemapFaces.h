@@ -0,0 +1,17 @@
+#ifndef CUBEMAP_FACES_H
+#define CUBEMAP_FACES_H
+
+#include <string>
+#include <vector>
+
+// Skybox faces "base_ft.tga" ... in GL cube map face order (+X, -X, +Y, -Y, +Z, -Z)
+inline std::vector<std::string> cubemapFaces(const std::string& base)
+{
+  static const char* suffixes[6] = { "_ft", "_bk", "_up", "_dn", "_rt", "_lf" };
+  std::vector<std::string> faces;
+  for (const char* suffix : suffixes)
+    faces.push_back(base + suffix + ".tga");
+  return faces;
+}
+
+#endif
@@ -0,0 +1,288 @@
+#ifndef DDS_H
+#define DDS_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+
+// Load block compressed .dds copies found next to the referenced images
+static bool preferCompressedTextures = true;
+
+// DirectDraw Surface loader for block compressed textures (BC1-BC5), mip levels
+// included. Blocks are uploaded as they are stored, with glCompressedTexImage2D.
+
+#define DDS_FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+const uint32_t DDS_MAGIC = DDS_FOURCC('D', 'D', 'S', ' ');
+const uint32_t DDPF_FOURCC = 0x4;
+const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+
+struct DDSPixelFormat
+{
+  uint32_t size;
+  uint32_t flags;
+  uint32_t fourCC;
+  uint32_t rgbBitCount;
+  uint32_t rBitMask, gBitMask, bBitMask, aBitMask;
+};
+
+struct DDSHeader
+{
+  uint32_t size;
+  uint32_t flags;
+  uint32_t height;
+  uint32_t width;
+  uint32_t pitchOrLinearSize;
+  uint32_t depth;
+  uint32_t mipMapCount;
+  uint32_t reserved1[11];
+  DDSPixelFormat pixelFormat;
+  uint32_t caps, caps2, caps3, caps4;
+  uint32_t reserved2;
+};
+
+struct DDSHeaderDX10
+{
+  uint32_t dxgiFormat;
+  uint32_t resourceDimension;
+  uint32_t miscFlag;
+  uint32_t arraySize;
+  uint32_t miscFlags2;
+};
+
+struct DDSImage
+{
+  GLenum format = 0;
+  const char* formatName = "";
+  unsigned int width = 0, height = 0;
+  unsigned int levels = 0;
+  unsigned int faces = 1; // 6 for cubemaps
+  unsigned int blockBytes = 0;
+  std::vector<unsigned char> data; // faces * levels, tightly packed
+};
+
+inline unsigned int ddsLevelSize(const DDSImage& img, unsigned int level)
+{
+  unsigned int w = std::max(1u, img.width >> level), h = std::max(1u, img.height >> level);
+  return ((w + 3) / 4) * ((h + 3) / 4) * img.blockBytes;
+}
+
+inline bool ddsFormat(uint32_t fourCC, uint32_t dxgi, DDSImage& img)
+{
+  // DXGI formats of the DX10 extended header
+  switch (dxgi)
+  {
+    case 71: fourCC = DDS_FOURCC('D', 'X', 'T', '1'); break; // BC1_UNORM
+    case 74: fourCC = DDS_FOURCC('D', 'X', 'T', '3'); break; // BC2_UNORM
+    case 77: fourCC = DDS_FOURCC('D', 'X', 'T', '5'); break; // BC3_UNORM
+    case 80: fourCC = DDS_FOURCC('B', 'C', '4', 'U'); break; // BC4_UNORM
+    case 83: fourCC = DDS_FOURCC('B', 'C', '5', 'U'); break; // BC5_UNORM
+  }
+
+  if (fourCC == DDS_FOURCC('D', 'X', 'T', '1'))
+  {
+    img.format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; img.formatName = "BC1"; img.blockBytes = 8;
+  }
+  else if (fourCC == DDS_FOURCC('D', 'X', 'T', '3'))
+  {
+    img.format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; img.formatName = "BC2"; img.blockBytes = 16;
+  }
+  else if (fourCC == DDS_FOURCC('D', 'X', 'T', '5'))
+  {
+    img.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; img.formatName = "BC3"; img.blockBytes = 16;
+  }
+  else if (fourCC == DDS_FOURCC('A', 'T', 'I', '1') || fourCC == DDS_FOURCC('B', 'C', '4', 'U'))
+  {
+    img.format = GL_COMPRESSED_RED_RGTC1; img.formatName = "BC4"; img.blockBytes = 8;
+  }
+  else if (fourCC == DDS_FOURCC('A', 'T', 'I', '2') || fourCC == DDS_FOURCC('B', 'C', '5', 'U'))
+  {
+    img.format = GL_COMPRESSED_RG_RGTC2; img.formatName = "BC5"; img.blockBytes = 16;
+  }
+  else
+    return false;
+
+  return true;
+}
+
+// Parse the header of a DDS file, dataOffset is where the first level starts
+inline bool readDDSHeader(const std::string& path, DDSImage& img, size_t& dataOffset)
+{
+  std::ifstream in(path, std::ifstream::binary);
+  if (!in)
+    return false;
+
+  uint32_t magic;
+  DDSHeader header;
+  in.read((char*)&magic, sizeof(magic));
+  in.read((char*)&header, sizeof(header));
+  if (!in || magic != DDS_MAGIC || header.size != sizeof(DDSHeader) || !(header.pixelFormat.flags & DDPF_FOURCC))
+  {
+    std::cout << "Unsupported DDS " << path << std::endl;
+    return false;
+  }
+
+  uint32_t dxgi = 0;
+  if (header.pixelFormat.fourCC == DDS_FOURCC('D', 'X', '1', '0'))
+  {
+    DDSHeaderDX10 dx10;
+    in.read((char*)&dx10, sizeof(dx10));
+    dxgi = dx10.dxgiFormat;
+  }
+
+  if (!ddsFormat(header.pixelFormat.fourCC, dxgi, img))
+  {
+    std::cout << "Unsupported DDS format in " << path << std::endl;
+    return false;
+  }
+
+  img.width = header.width;
+  img.height = header.height;
+  img.levels = std::max(1u, header.mipMapCount);
+  img.faces = (header.caps2 & DDSCAPS2_CUBEMAP) ? 6 : 1;
+  dataOffset = in.tellg();
+  return true;
+}
+
+// Read levels [first, last] of a 2D DDS whose header was parsed with readDDSHeader
+inline bool readDDSLevels(const std::string& path, const DDSImage& img, size_t dataOffset, unsigned int first, unsigned int last, std::vector<unsigned char>& data)
+{
+  std::ifstream in(path, std::ifstream::binary);
+  if (!in)
+    return false;
+
+  size_t offset = dataOffset, size = 0;
+  for (unsigned int l = 0; l < first; l++)
+    offset += ddsLevelSize(img, l);
+  for (unsigned int l = first; l <= last; l++)
+    size += ddsLevelSize(img, l);
+
+  data.resize(size);
+  in.seekg(offset);
+  in.read((char*)data.data(), size);
+  return (bool)in;
+}
+
+// Parse a DDS file into memory (no GL calls, can run on any thread)
+inline bool readDDS(const std::string& path, DDSImage& img)
+{
+  size_t dataOffset;
+  if (!readDDSHeader(path, img, dataOffset))
+    return false;
+
+  std::ifstream in(path, std::ifstream::binary);
+  size_t size = 0;
+  for (unsigned int l = 0; l < img.levels; l++)
+    size += ddsLevelSize(img, l);
+  size *= img.faces;
+
+  img.data.resize(size);
+  in.seekg(dataOffset);
+  in.read((char*)img.data.data(), size);
+  if (!in)
+  {
+    std::cout << "Truncated DDS " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Write img as a legacy FourCC DDS (DXT1/DXT5/ATI1/ATI2), readable by readDDS and
+// by common tools
+inline bool writeDDS(const std::string& path, const DDSImage& img)
+{
+  uint32_t fourCC;
+  switch (img.format)
+  {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: fourCC = DDS_FOURCC('D', 'X', 'T', '1'); break;
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT: fourCC = DDS_FOURCC('D', 'X', 'T', '3'); break;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: fourCC = DDS_FOURCC('D', 'X', 'T', '5'); break;
+    case GL_COMPRESSED_RED_RGTC1: fourCC = DDS_FOURCC('A', 'T', 'I', '1'); break;
+    case GL_COMPRESSED_RG_RGTC2: fourCC = DDS_FOURCC('A', 'T', 'I', '2'); break;
+    default:
+      std::cerr << "Cannot write DDS format " << img.formatName << std::endl;
+      return false;
+  }
+
+  DDSHeader header;
+  memset(&header, 0, sizeof(header));
+  header.size = sizeof(DDSHeader);
+  header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // caps, height, width, pixelformat, mipmapcount, linearsize
+  header.height = img.height;
+  header.width = img.width;
+  header.pitchOrLinearSize = ddsLevelSize(img, 0);
+  header.mipMapCount = img.levels;
+  header.pixelFormat.size = sizeof(DDSPixelFormat);
+  header.pixelFormat.flags = DDPF_FOURCC;
+  header.pixelFormat.fourCC = fourCC;
+  header.caps = 0x1000 | (img.levels > 1 ? 0x400008 : 0); // texture, mipmap + complex
+  if (img.faces == 6)
+  {
+    header.caps |= 0x8;
+    header.caps2 = DDSCAPS2_CUBEMAP | 0xfc00; // all six faces
+  }
+
+  std::ofstream out(path, std::ofstream::binary);
+  if (!out)
+  {
+    std::cerr << "Cannot write " << path << std::endl;
+    return false;
+  }
+  out.write((const char*)&DDS_MAGIC, sizeof(DDS_MAGIC));
+  out.write((const char*)&header, sizeof(header));
+  out.write((const char*)img.data.data(), img.data.size());
+  return (bool)out;
+}
+
+// Upload every stored level to the texture bound on target (GL_TEXTURE_2D, or the
+// cube map faces for cubemaps), returns the uploaded size in bytes
+inline size_t uploadDDS(const DDSImage& img, GLenum target)
+{
+  size_t offset = 0;
+  for (unsigned int f = 0; f < img.faces; f++)
+  {
+    GLenum face = img.faces == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + f : target;
+    for (unsigned int l = 0; l < img.levels; l++)
+    {
+      unsigned int size = ddsLevelSize(img, l);
+      glCompressedTexImage2D(face, l, img.format, std::max(1u, img.width >> l), std::max(1u, img.height >> l), 0, size, &img.data[offset]);
+      offset += size;
+    }
+  }
+
+  glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, img.levels - 1);
+  return offset;
+}
+
+inline bool ddsSupported(const DDSImage& img)
+{
+  if (img.format == GL_COMPRESSED_RED_RGTC1 || img.format == GL_COMPRESSED_RG_RGTC2)
+    return true; // core since 3.0
+  return hasGLExtension("GL_EXT_texture_compression_s3tc");
+}
+
+// "foo/bar.png" -> "foo/bar.dds", and for packed images (see ChannelPack.h)
+// "foo/bar.png+mask.png" -> "foo/bar+mask.dds"
+inline std::string ddsPath(const std::string& path)
+{
+  size_t slash = path.find_last_of('/');
+  size_t plus = path.find('+', slash == std::string::npos ? 0 : slash);
+  if (plus != std::string::npos)
+  {
+    std::string first = path.substr(0, plus), second = path.substr(plus + 1);
+    return first.substr(0, first.find_last_of('.')) + "+" + second.substr(0, second.find_last_of('.')) + ".dds";
+  }
+  return path.substr(0, path.find_last_of('.')) + ".dds";
+}
+
+#endif
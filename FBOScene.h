@@ -1,6 +1,7 @@
 #ifndef FBO_SCENE_H
 #define FBO_SCENE_H
 
+#include "GLState.h"
 #include "Scene.h"
 #include "Shader.h"
 #include "Model.h"
@@ -19,7 +20,7 @@ class FBOScene : public Scene
       lightPos = glm::vec3(1.2f, 1.0f, 2.0f);
 
       // configure global opengl state
-      glEnable(GL_DEPTH_TEST);
+      glState().Enable(GL_DEPTH_TEST);
 
       // build and compile our shader zprogram
       modelShader = new Shader("res/shaders/basic/basic.vs", "res/shaders/basic/basic.fs");
@@ -32,15 +33,15 @@ class FBOScene : public Scene
 
       // Generate and bind to FBO
       glGenFramebuffers(1, &framebuffer);
-      glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+      glState().BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 
       // generate texture
       glGenTextures(1, &texColorBuffer);
-      glBindTexture(GL_TEXTURE_2D, texColorBuffer);
+      glState().BindTexture(GL_TEXTURE_2D, texColorBuffer);
       glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 800, 600, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      glBindTexture(GL_TEXTURE_2D, 0);
+      glState().BindTexture(GL_TEXTURE_2D, 0);
 
       // attach it to currently bound framebuffer object
       glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texColorBuffer, 0);
@@ -57,7 +58,7 @@ class FBOScene : public Scene
       // Check attachments and unbind fbo
       if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
-      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
 
       // Create quad VAO
       float quadVertices[] = {
@@ -70,7 +71,7 @@ class FBOScene : public Scene
       };
       glGenVertexArrays(1, &quadVAO);
       glGenBuffers(1, &quadVBO);
-      glBindVertexArray(quadVAO);
+      glState().BindVertexArray(quadVAO);
       glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
       glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
       glEnableVertexAttribArray(0);
@@ -95,10 +96,10 @@ class FBOScene : public Scene
       view = camera.GetViewMatrix();
 
       // First pass - bind fbo
-      glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+      glState().BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
       glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // we're not using the stencil buffer now
-      glEnable(GL_DEPTH_TEST);
+      glState().Enable(GL_DEPTH_TEST);
 
       // Draw model
       DrawModel(); 
@@ -107,16 +108,16 @@ class FBOScene : public Scene
       DrawLamp();
 
       // Second pass - unbind fbo
-      glBindFramebuffer(GL_FRAMEBUFFER, 0); // back to default
+      glState().BindFramebuffer(GL_FRAMEBUFFER, 0); // back to default
       glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
       glClear(GL_COLOR_BUFFER_BIT);
-      glDisable(GL_DEPTH_TEST);
+      glState().Disable(GL_DEPTH_TEST);
 
       screenShader->use();
       screenShader->setInt("screenTexture", 0);
-      glBindVertexArray(quadVAO);
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, texColorBuffer);
+      glState().BindVertexArray(quadVAO);
+      glState().ActiveTexture(GL_TEXTURE0);
+      glState().BindTexture(GL_TEXTURE_2D, texColorBuffer);
       glDrawArrays(GL_TRIANGLES, 0, 6);
     }
 
@@ -124,10 +125,10 @@ class FBOScene : public Scene
     void DrawModel()
     {
       // Bind textures
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, diffuseMap);
-      glActiveTexture(GL_TEXTURE1);
-      glBindTexture(GL_TEXTURE_2D, specularMap);
+      glState().ActiveTexture(GL_TEXTURE0);
+      glState().BindTexture(GL_TEXTURE_2D, diffuseMap);
+      glState().ActiveTexture(GL_TEXTURE1);
+      glState().BindTexture(GL_TEXTURE_2D, specularMap);
 
       // Set shader uniforms
       modelShader->use();
@@ -153,8 +154,7 @@ class FBOScene : public Scene
     {
       // also draw the lamp object
       lampShader->use();
-      lampShader->setMat4("projection", projection);
-      lampShader->setMat4("view", view);
+      uniformBlocks().SetCamera(projection, view, camera.Position); // lamp.vs reads the Camera block
       glm::mat4 model = glm::mat4();
       model = glm::translate(model, lightPos);
       model = glm::scale(model, glm::vec3(0.2f)); // a smaller cube
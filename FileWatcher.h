@@ -0,0 +1,88 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <iostream>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Files saved on disk, for hot reloading: inotify watches the directories of the
+// watched files (editors often save by writing a new file and renaming it over the old
+// one, which a watch on the file itself would lose) and Poll reports the watched files
+// written or replaced since the last call, without ever blocking.
+class FileWatcher
+{
+  public:
+    ~FileWatcher()
+    {
+      if (fd >= 0)
+        close(fd);
+    }
+
+    void Watch(const std::string& path)
+    {
+      if (files.count(path))
+        return;
+      files.insert(path);
+
+      if (fd < 0)
+      {
+        if (unavailable)
+          return;
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0)
+        {
+          std::cerr << "inotify unavailable, files will not reload on save" << std::endl;
+          unavailable = true;
+          return;
+        }
+      }
+      size_t slash = path.find_last_of('/');
+      std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+      for (auto& d : dirs)
+        if (d.second == dir)
+          return;
+      int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+      if (wd >= 0)
+        dirs[wd] = dir;
+    }
+
+    // Watched files changed since the last call, each once
+    void Poll(std::vector<std::string>& changed)
+    {
+      if (fd < 0)
+        return;
+      alignas(inotify_event) char buffer[4096];
+      ssize_t length;
+      while ((length = read(fd, buffer, sizeof(buffer))) > 0)
+        for (char* p = buffer; p < buffer + length; p += sizeof(inotify_event) + ((inotify_event*)p)->len)
+        {
+          const inotify_event* event = (const inotify_event*)p;
+          auto dir = dirs.find(event->wd);
+          if (dir == dirs.end() || !event->len)
+            continue;
+          std::string path = dir->second == "." ? event->name : dir->second + "/" + event->name;
+          if (files.count(path) && std::find(changed.begin(), changed.end(), path) == changed.end())
+            changed.push_back(path);
+        }
+    }
+
+  private:
+    int fd = -1;
+    bool unavailable = false;
+    std::unordered_map<int, std::string> dirs; // by watch descriptor
+    std::unordered_set<std::string> files;
+};
+
+inline FileWatcher& fileWatcher()
+{
+  static FileWatcher watcher;
+  return watcher;
+}
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <set>
+
+// glad is generated for the plain 3.3 core profile: enums and entry points of the
+// extensions we opportunistically use are declared here.
+
+// EXT_texture_compression_s3tc
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+
+// ARB_get_program_binary (core in 4.1)
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH           0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS      0x87FE
+
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+// KHR_parallel_shader_compile (or its ARB twin)
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR           0x91B1
+
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// ARB_multi_draw_indirect (core in 4.3)
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+
+// Entry points of the extensions above, null when the driver lacks them
+struct GLExtensionFunctions
+{
+  PFNGLGETPROGRAMBINARYPROC getProgramBinary = nullptr;
+  PFNGLPROGRAMBINARYPROC programBinary = nullptr;
+  PFNGLPROGRAMPARAMETERIPROC programParameteri = nullptr;
+  PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads = nullptr;
+  bool parallelShaderCompile = false; // GL_COMPLETION_STATUS_KHR can be polled
+  PFNGLMULTIDRAWELEMENTSINDIRECTPROC multiDrawElementsIndirect = nullptr;
+  bool baseInstance = false; // ARB_base_instance (core in 4.2): indirect commands can offset instanced attributes
+};
+
+inline GLExtensionFunctions& glExtensionFunctions()
+{
+  static GLExtensionFunctions functions;
+  return functions;
+}
+
+inline bool hasGLExtension(const char* name)
+{
+  static std::set<std::string> extensions;
+  if (extensions.empty())
+  {
+    GLint n = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+    for (GLint i = 0; i < n; i++)
+      extensions.insert((const char*)glGetStringi(GL_EXTENSIONS, i));
+  }
+  return extensions.count(name) > 0;
+}
+
+// Resolve the extension entry points, once the context is current (after glad)
+inline void loadGLExtensions(GLADloadproc load)
+{
+  GLExtensionFunctions& f = glExtensionFunctions();
+  GLint binaryFormats = 0;
+  if (hasGLExtension("GL_ARB_get_program_binary"))
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+  if (binaryFormats > 0)
+  {
+    f.getProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+    f.programBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+    f.programParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+  }
+
+  // Let the driver use as many compiler threads as it likes
+  if (hasGLExtension("GL_KHR_parallel_shader_compile"))
+    f.maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+  else if (hasGLExtension("GL_ARB_parallel_shader_compile"))
+    f.maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsARB");
+  if (f.maxShaderCompilerThreads)
+  {
+    f.maxShaderCompilerThreads(0xFFFFFFFF);
+    f.parallelShaderCompile = true;
+  }
+
+  if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 3) || hasGLExtension("GL_ARB_multi_draw_indirect"))
+    f.multiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+  f.baseInstance = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 2) || hasGLExtension("GL_ARB_base_instance");
+}
+
+#endif
@@ -0,0 +1,308 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+// Shadow of the GL state we change (program, VAO, texture units, framebuffers,
+// capabilities, blend, depth and stencil state, viewport): calls setting what is
+// already set never reach the driver. All our code goes through it; code that does not
+// (ImGui) restores what it changes, which keeps the shadow right. Deleted objects have
+// to be forgotten, their names get reused.
+//
+// Counts the calls issued and filtered each frame; with filtering off every call is
+// issued (and still counted as redundant) to compare driver overhead.
+enum GLStateCall
+{
+  STATE_PROGRAM = 0,
+  STATE_VERTEX_ARRAY,
+  STATE_TEXTURE,
+  STATE_FRAMEBUFFER,
+  STATE_CAPABILITY,
+  STATE_BLEND_DEPTH_STENCIL,
+  STATE_VIEWPORT,
+  STATE_CALLS
+};
+
+inline const char* glStateCallName(GLStateCall call)
+{
+  static const char* names[STATE_CALLS] = { "program", "vertex array", "texture", "framebuffer", "enable", "blend/depth/stencil", "viewport" };
+  return names[call];
+}
+
+class GLState
+{
+  public:
+    bool filtering = true;
+
+    struct Counters
+    {
+      unsigned int issued[STATE_CALLS] = {}, filtered[STATE_CALLS] = {};
+
+      unsigned int Issued() const { return sum(issued); }
+      unsigned int Filtered() const { return sum(filtered); }
+
+      private:
+        static unsigned int sum(const unsigned int* n)
+        {
+          unsigned int total = 0;
+          for (unsigned int i = 0; i < STATE_CALLS; i++)
+            total += n[i];
+          return total;
+        }
+    };
+
+    GLState() { Invalidate(); }
+
+    void UseProgram(GLuint program)
+    {
+      if (changed(STATE_PROGRAM, program != this->program))
+        glUseProgram(this->program = program);
+    }
+
+    void BindVertexArray(GLuint vao)
+    {
+      if (changed(STATE_VERTEX_ARRAY, vao != vertexArray))
+        glBindVertexArray(vertexArray = vao);
+    }
+
+    void ActiveTexture(GLenum unit)
+    {
+      if (changed(STATE_TEXTURE, unit != activeUnit))
+        glActiveTexture(activeUnit = unit);
+    }
+
+    // On the active unit
+    void BindTexture(GLenum target, GLuint texture)
+    {
+      GLuint* bound = binding(activeUnit, target);
+      if (changed(STATE_TEXTURE, !bound || texture != *bound))
+      {
+        if (bound)
+          *bound = texture;
+        glBindTexture(target, texture);
+      }
+    }
+
+    // Activates unit only when the binding has to change; true when it did
+    bool BindTexture(unsigned int unit, GLenum target, GLuint texture)
+    {
+      GLuint* bound = binding(GL_TEXTURE0 + unit, target);
+      if (!changed(STATE_TEXTURE, !bound || texture != *bound))
+        return false;
+      ActiveTexture(GL_TEXTURE0 + unit);
+      if (bound)
+        *bound = texture;
+      glBindTexture(target, texture);
+      return true;
+    }
+
+    // GL_FRAMEBUFFER binds both the draw and read targets
+    void BindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+      bool draw = target != GL_READ_FRAMEBUFFER, read = target != GL_DRAW_FRAMEBUFFER;
+      if (!changed(STATE_FRAMEBUFFER, (draw && framebuffer != drawFramebuffer) || (read && framebuffer != readFramebuffer)))
+        return;
+      glBindFramebuffer(target, framebuffer);
+      if (draw)
+        drawFramebuffer = framebuffer;
+      if (read)
+        readFramebuffer = framebuffer;
+    }
+
+    void Enable(GLenum cap) { set(cap, true); }
+    void Disable(GLenum cap) { set(cap, false); }
+
+    void BlendFunc(GLenum src, GLenum dst)
+    {
+      if (changed(STATE_BLEND_DEPTH_STENCIL, src != blendSrc || dst != blendDst))
+        glBlendFunc(blendSrc = src, blendDst = dst);
+    }
+
+    void DepthFunc(GLenum func)
+    {
+      if (changed(STATE_BLEND_DEPTH_STENCIL, func != depthFunc))
+        glDepthFunc(depthFunc = func);
+    }
+
+    void DepthMask(GLboolean mask)
+    {
+      if (changed(STATE_BLEND_DEPTH_STENCIL, mask != depthMask))
+        glDepthMask(depthMask = mask);
+    }
+
+    void StencilFunc(GLenum func, GLint ref, GLuint mask)
+    {
+      if (changed(STATE_BLEND_DEPTH_STENCIL, func != stencilFunc || ref != stencilRef || mask != stencilFuncMask))
+        glStencilFunc(stencilFunc = func, stencilRef = ref, stencilFuncMask = mask);
+    }
+
+    void StencilOp(GLenum sfail, GLenum dpfail, GLenum dppass)
+    {
+      if (changed(STATE_BLEND_DEPTH_STENCIL, sfail != stencilOp[0] || dpfail != stencilOp[1] || dppass != stencilOp[2]))
+      {
+        stencilOp[0] = sfail;
+        stencilOp[1] = dpfail;
+        stencilOp[2] = dppass;
+        glStencilOp(sfail, dpfail, dppass);
+      }
+    }
+
+    void StencilMask(GLuint mask)
+    {
+      if (changed(STATE_BLEND_DEPTH_STENCIL, mask != stencilMask))
+        glStencilMask(stencilMask = mask);
+    }
+
+    void Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+      if (changed(STATE_VIEWPORT, x != viewport[0] || y != viewport[1] || width != viewport[2] || height != viewport[3]))
+      {
+        viewport[0] = x;
+        viewport[1] = y;
+        viewport[2] = width;
+        viewport[3] = height;
+        glViewport(x, y, width, height);
+      }
+    }
+
+    // Before deleting an object whose name may be bound
+    void ForgetProgram(GLuint id)
+    {
+      if (program == id)
+        program = UNKNOWN;
+    }
+
+    void ForgetVertexArray(GLuint id)
+    {
+      if (vertexArray == id)
+        vertexArray = UNKNOWN;
+    }
+
+    void ForgetTexture(GLuint id)
+    {
+      for (auto& unit : textures)
+        for (GLuint& bound : unit)
+          if (bound == id)
+            bound = UNKNOWN;
+    }
+
+    void ForgetFramebuffer(GLuint id)
+    {
+      if (drawFramebuffer == id)
+        drawFramebuffer = UNKNOWN;
+      if (readFramebuffer == id)
+        readFramebuffer = UNKNOWN;
+    }
+
+    // Everything unknown, the next call of each kind reaches the driver
+    void Invalidate()
+    {
+      program = vertexArray = drawFramebuffer = readFramebuffer = UNKNOWN;
+      activeUnit = UNKNOWN;
+      for (auto& unit : textures)
+        for (GLuint& bound : unit)
+          bound = UNKNOWN;
+      for (unsigned int i = 0; i < CAPABILITIES; i++)
+        capabilities[i] = -1;
+      blendSrc = blendDst = depthFunc = stencilFunc = UNKNOWN;
+      stencilOp[0] = stencilOp[1] = stencilOp[2] = UNKNOWN;
+      depthMask = 2;
+      stencilRef = -1;
+      stencilFuncMask = stencilMask = UNKNOWN;
+      viewport[0] = viewport[1] = viewport[2] = viewport[3] = -1;
+    }
+
+    // Once per frame, from the render loop
+    void EndFrame()
+    {
+      last = frame;
+      frame = Counters();
+    }
+
+    const Counters& LastFrame() const { return last; }
+
+  private:
+    static const GLuint UNKNOWN = 0xffffffff;
+    static const unsigned int UNITS = 32, TARGETS = 4, CAPABILITIES = 6;
+
+    GLuint program, vertexArray, drawFramebuffer, readFramebuffer;
+    GLenum activeUnit;
+    GLuint textures[UNITS][TARGETS];
+    int capabilities[CAPABILITIES]; // -1 unknown
+    GLenum blendSrc, blendDst, depthFunc, stencilFunc, stencilOp[3];
+    GLboolean depthMask;
+    GLint stencilRef;
+    GLuint stencilFuncMask, stencilMask;
+    GLint viewport[4];
+    Counters frame, last;
+
+    // Counts the call, true when it has to be issued
+    bool changed(GLStateCall call, bool differs)
+    {
+      if (differs)
+      {
+        frame.issued[call]++;
+        return true;
+      }
+      frame.filtered[call]++;
+      if (filtering)
+        return false;
+      frame.issued[call]++;
+      return true;
+    }
+
+    void set(GLenum cap, bool on)
+    {
+      int i = capabilityIndex(cap);
+      if (i < 0)
+      {
+        frame.issued[STATE_CAPABILITY]++;
+        on ? glEnable(cap) : glDisable(cap);
+        return;
+      }
+      if (changed(STATE_CAPABILITY, capabilities[i] != (int)on))
+      {
+        capabilities[i] = on;
+        on ? glEnable(cap) : glDisable(cap);
+      }
+    }
+
+    static int capabilityIndex(GLenum cap)
+    {
+      switch (cap)
+      {
+        case GL_DEPTH_TEST: return 0;
+        case GL_BLEND: return 1;
+        case GL_STENCIL_TEST: return 2;
+        case GL_CULL_FACE: return 3;
+        case GL_SCISSOR_TEST: return 4;
+        case GL_FRAMEBUFFER_SRGB: return 5;
+        default: return -1;
+      }
+    }
+
+    // Shadow of a texture binding, null for units and targets not tracked (never
+    // filtered)
+    GLuint* binding(GLenum unit, GLenum target)
+    {
+      unsigned int i = unit - GL_TEXTURE0;
+      if (unit == UNKNOWN || i >= UNITS)
+        return nullptr;
+      switch (target)
+      {
+        case GL_TEXTURE_2D: return &textures[i][0];
+        case GL_TEXTURE_2D_ARRAY: return &textures[i][1];
+        case GL_TEXTURE_CUBE_MAP: return &textures[i][2];
+        case GL_TEXTURE_BUFFER: return &textures[i][3];
+        default: return nullptr;
+      }
+    }
+};
+
+inline GLState& glState()
+{
+  static GLState state;
+  return state;
+}
+
+#endif
@@ -0,0 +1,312 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "ResourceManager.h"
+
+// Multi-draws go through glMultiDrawElementsIndirect when the driver has it (4.3 or
+// ARB_multi_draw_indirect); off, or without it, through glMultiDrawElementsBaseVertex
+static bool indirectDraws = true;
+
+// Layout of the records in GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand
+{
+  GLuint count;
+  GLuint instanceCount;
+  GLuint firstIndex;
+  GLint baseVertex;
+  GLuint baseInstance;
+};
+
+// Where a mesh lives in an arena, in vertices and indices
+struct GeometryRange
+{
+  unsigned int baseVertex = 0, vertexCount = 0;
+  unsigned int firstIndex = 0, indexCount = 0;
+};
+
+// Offsets in a buffer of capacity elements: first fit over the free ranges, merged
+// again with their neighbours when freed
+class RangeAllocator
+{
+  public:
+    bool Allocate(unsigned int size, unsigned int& offset)
+    {
+      for (auto it = free.begin(); it != free.end(); ++it)
+        if (it->second >= size)
+        {
+          offset = it->first;
+          unsigned int left = it->second - size;
+          free.erase(it);
+          if (left)
+            free[offset + size] = left;
+          used += size;
+          return true;
+        }
+      return false;
+    }
+
+    void Free(unsigned int offset, unsigned int size)
+    {
+      if (!size)
+        return;
+      used -= size;
+      auto next = free.lower_bound(offset);
+      if (next != free.end() && offset + size == next->first)
+      {
+        size += next->second;
+        next = free.erase(next);
+      }
+      if (next != free.begin())
+      {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset)
+        {
+          prev->second += size;
+          return;
+        }
+      }
+      free[offset] = size;
+    }
+
+    // The new elements at the end are free
+    void Grow(unsigned int newCapacity)
+    {
+      unsigned int added = newCapacity - capacity;
+      capacity = newCapacity;
+      Free(capacity - added, added);
+      used += added;
+    }
+
+    unsigned int Capacity() const { return capacity; }
+    unsigned int Used() const { return used; }
+
+  private:
+    std::map<unsigned int, unsigned int> free; // size by offset
+    unsigned int capacity = 0, used = 0;
+};
+
+// One vertex and one index buffer shared by every mesh of a vertex format, with the
+// single VAO reading them: meshes sub-allocate a range (indices stay relative to the
+// mesh, draws add baseVertex) and switching meshes never switches vertex arrays.
+// Buffers double when full, the content is copied on the GPU.
+//
+// MultiDraw submits any number of ranges in one call. With a draw ID attribute, each
+// draw can carry an unsigned int for the shaders (a material, see MaterialTable): set
+// as the constant attribute value for single draws, read per draw from an instanced
+// array (baseInstance selects the element) for multi-draws.
+class GeometryArena
+{
+  public:
+    // setupAttributes sets the attribute pointers of the format, the vertex buffer bound
+    GeometryArena(const std::string& name, size_t vertexSize, std::function<void()> setupAttributes,
+        unsigned int vertexCapacity = 1 << 16, unsigned int indexCapacity = 1 << 18, GLint drawIdAttribute = -1)
+      : name(name), vertexSize(vertexSize), setupAttributes(setupAttributes),
+        initialVertices(vertexCapacity), initialIndices(indexCapacity), drawIdAttribute(drawIdAttribute)
+    {
+    }
+
+    GeometryRange Allocate(const void* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount)
+    {
+      GeometryRange r;
+      r.vertexCount = vertexCount;
+      r.indexCount = indexCount;
+      VAO();
+      reserve(vertices, r.baseVertex, vertexCount, VBO, vertexSize, " vertices");
+      reserve(indices, r.firstIndex, indexCount, EBO, sizeof(unsigned int), " indices");
+
+      glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+      glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)r.baseVertex * vertexSize, (GLsizeiptr)vertexCount * vertexSize, vertexData);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+      glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)r.firstIndex * sizeof(unsigned int), (GLsizeiptr)indexCount * sizeof(unsigned int), indexData);
+      ranges++;
+      return r;
+    }
+
+    void Free(const GeometryRange& r)
+    {
+      vertices.Free(r.baseVertex, r.vertexCount);
+      indices.Free(r.firstIndex, r.indexCount);
+      ranges--;
+    }
+
+    // Created with the buffers on first use
+    unsigned int VAO()
+    {
+      if (!vao)
+      {
+        glGenVertexArrays(1, &vao);
+        grow(vertices, VBO, vertexSize, initialVertices, " vertices");
+        grow(indices, EBO, sizeof(unsigned int), initialIndices, " indices");
+        if (drawIdAttribute >= 0)
+        {
+          glGenBuffers(1, &drawIdBuffer);
+          glState().BindVertexArray(vao);
+          glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+          glVertexAttribIPointer(drawIdAttribute, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+          glVertexAttribDivisor(drawIdAttribute, 1);
+          glState().BindVertexArray(0);
+        }
+      }
+      return vao;
+    }
+
+    void Draw(const GeometryRange& r)
+    {
+      glState().BindVertexArray(vao);
+      glDrawElementsBaseVertex(GL_TRIANGLES, r.indexCount, GL_UNSIGNED_INT, (void*)((uintptr_t)r.firstIndex * sizeof(unsigned int)), r.baseVertex);
+    }
+
+    void Draw(const GeometryRange& r, GLuint drawId)
+    {
+      glState().BindVertexArray(vao);
+      drawIdArray(false);
+      glVertexAttribI1ui(drawIdAttribute, drawId);
+      glDrawElementsBaseVertex(GL_TRIANGLES, r.indexCount, GL_UNSIGNED_INT, (void*)((uintptr_t)r.firstIndex * sizeof(unsigned int)), r.baseVertex);
+    }
+
+    // Whether MultiDraw can give each draw its ID, false falls back to single draws
+    bool MultiDrawIds() const
+    {
+      return drawIdAttribute >= 0 && indirectDraws && glExtensionFunctions().multiDrawElementsIndirect && glExtensionFunctions().baseInstance;
+    }
+
+    // Every command in one call, command i drawn with drawIds[i] (see MultiDrawIds)
+    void MultiDraw(std::vector<DrawElementsIndirectCommand>& commands, const std::vector<GLuint>& drawIds)
+    {
+      if (commands.empty())
+        return;
+      for (unsigned int i = 0; i < commands.size(); i++)
+        commands[i].baseInstance = i;
+      glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+      glBufferData(GL_ARRAY_BUFFER, drawIds.size() * sizeof(GLuint), drawIds.data(), GL_STREAM_DRAW);
+      glState().BindVertexArray(vao);
+      drawIdArray(true);
+      MultiDraw(commands);
+    }
+
+    static DrawElementsIndirectCommand Command(const GeometryRange& r, unsigned int baseInstance = 0)
+    {
+      return { r.indexCount, 1, r.firstIndex, (GLint)r.baseVertex, baseInstance };
+    }
+
+    // Every command in one call (commands with a baseInstance need GL 4.2)
+    void MultiDraw(const std::vector<DrawElementsIndirectCommand>& commands)
+    {
+      if (commands.empty())
+        return;
+      glState().BindVertexArray(vao);
+      multiDraws++;
+      draws += commands.size();
+
+      if (indirectDraws && glExtensionFunctions().multiDrawElementsIndirect)
+      {
+        if (!indirectBuffer)
+          glGenBuffers(1, &indirectBuffer);
+        // Orphaned every call, the driver hands out a fresh buffer while the last
+        // commands are still read
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+        glExtensionFunctions().multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, commands.size(), 0);
+        return;
+      }
+
+      counts.clear();
+      offsets.clear();
+      baseVertices.clear();
+      for (const DrawElementsIndirectCommand& c : commands)
+      {
+        counts.push_back(c.count);
+        offsets.push_back((const void*)((uintptr_t)c.firstIndex * sizeof(unsigned int)));
+        baseVertices.push_back(c.baseVertex);
+      }
+      glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), commands.size(), baseVertices.data());
+    }
+
+    unsigned int Ranges() const { return ranges; }
+    size_t VertexBytes() const { return (size_t)vertices.Used() * vertexSize; }
+    size_t IndexBytes() const { return (size_t)indices.Used() * sizeof(unsigned int); }
+    size_t CapacityBytes() const { return (size_t)vertices.Capacity() * vertexSize + (size_t)indices.Capacity() * sizeof(unsigned int); }
+
+    // Once per frame, from the render loop
+    void EndFrame()
+    {
+      multiDrawsLastFrame = multiDraws;
+      drawsLastFrame = draws;
+      multiDraws = draws = 0;
+    }
+
+    // MultiDraw calls of the last frame, and the ranges they drew
+    unsigned int MultiDrawsLastFrame() const { return multiDrawsLastFrame; }
+    unsigned int DrawsLastFrame() const { return drawsLastFrame; }
+
+  private:
+    std::string name;
+    size_t vertexSize;
+    std::function<void()> setupAttributes;
+    unsigned int initialVertices, initialIndices;
+    unsigned int vao = 0, VBO = 0, EBO = 0, indirectBuffer = 0;
+    GLint drawIdAttribute;
+    unsigned int drawIdBuffer = 0;
+    bool drawIdEnabled = false; // the instanced array, or the constant value
+    RangeAllocator vertices, indices;
+    unsigned int ranges = 0, multiDraws = 0, draws = 0, multiDrawsLastFrame = 0, drawsLastFrame = 0;
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> baseVertices;
+
+    // Enabled is VAO state, the arena's VAO bound
+    void drawIdArray(bool enabled)
+    {
+      if (enabled == drawIdEnabled)
+        return;
+      enabled ? glEnableVertexAttribArray(drawIdAttribute) : glDisableVertexAttribArray(drawIdAttribute);
+      drawIdEnabled = enabled;
+    }
+
+    void reserve(RangeAllocator& allocator, unsigned int& offset, unsigned int size, unsigned int& buffer, size_t elementSize, const char* label)
+    {
+      while (!allocator.Allocate(size, offset))
+        grow(allocator, buffer, elementSize, std::max(allocator.Capacity() * 2, allocator.Capacity() + size), label);
+    }
+
+    // A bigger buffer holding the old content, the VAO pointed at it
+    void grow(RangeAllocator& allocator, unsigned int& buffer, size_t elementSize, unsigned int capacity, const char* label)
+    {
+      unsigned int grown;
+      glGenBuffers(1, &grown);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+      glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)capacity * elementSize, nullptr, GL_STATIC_DRAW);
+      if (buffer)
+      {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)allocator.Capacity() * elementSize);
+        resources().Release(RESOURCE_BUFFER, buffer);
+      }
+      buffer = grown;
+      allocator.Grow(capacity);
+      resources().Add(RESOURCE_BUFFER, buffer, (size_t)capacity * elementSize, name + label);
+
+      glState().BindVertexArray(vao);
+      if (&allocator == &indices)
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+      else
+      {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        setupAttributes();
+      }
+      glState().BindVertexArray(0);
+    }
+};
+
+#endif
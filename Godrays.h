@@ -1,6 +1,7 @@
 #ifndef GODRAYS_H
 #define GODRAYS_H
 
+#include "GLState.h"
 #include "Shader.h"
 
 #include <glad/glad.h>
@@ -28,15 +29,15 @@ class Godrays
 
       // Generate FBO
       glGenFramebuffers(1, &framebuffer);
-      glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+      glState().BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 
       // Generate texture
       glGenTextures(1, &texColorBuffer);
-      glBindTexture(GL_TEXTURE_2D, texColorBuffer);
+      glState().BindTexture(GL_TEXTURE_2D, texColorBuffer);
       glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, windowWidth/4, windowHeight/4, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      glBindTexture(GL_TEXTURE_2D, 0);
+      glState().BindTexture(GL_TEXTURE_2D, 0);
 
       // attach it to currently bound framebuffer object
       glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texColorBuffer, 0);
@@ -53,7 +54,7 @@ class Godrays
       // Check attachments and unbind fbo
       if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
-      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
 
       // Generate texture quad
       float quadVertices[] = {
@@ -66,7 +67,7 @@ class Godrays
       };
       glGenVertexArrays(1, &quadVAO);
       glGenBuffers(1, &quadVBO);
-      glBindVertexArray(quadVAO);
+      glState().BindVertexArray(quadVAO);
       glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
       glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
       glEnableVertexAttribArray(0);
@@ -77,16 +78,16 @@ class Godrays
 
     void Bind()
     {
-      glViewport(0, 0, windowWidth/4, windowHeight/4);
-      glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+      glState().Viewport(0, 0, windowWidth/4, windowHeight/4);
+      glState().BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
       glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     }
 
     void Unbind()
     {
-      glViewport(0, 0, windowWidth, windowHeight);
-      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glState().Viewport(0, 0, windowWidth, windowHeight);
+      glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
     }
 
     void Draw(glm::mat4 projection, glm::mat4 view, glm::vec3 lightPos, GodraysParams& params)
@@ -103,15 +104,15 @@ class Godrays
       godraysShader->setFloat("density", params.density);
       godraysShader->setFloat("weight", params.weight);
       
-      glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+      glState().Enable(GL_BLEND);
+			glState().BlendFunc(GL_SRC_ALPHA, GL_ONE);
 
-      glBindVertexArray(quadVAO);
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, texColorBuffer);
+      glState().BindVertexArray(quadVAO);
+      glState().ActiveTexture(GL_TEXTURE0);
+      glState().BindTexture(GL_TEXTURE_2D, texColorBuffer);
       glDrawArrays(GL_TRIANGLES, 0, 6);
 
-      glDisable(GL_BLEND);
+      glState().Disable(GL_BLEND);
     }
   
   private:
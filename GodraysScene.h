@@ -1,6 +1,7 @@
 #ifndef GODRAYS_SCENE_H
 #define GODRAYS_SCENE_H
 
+#include "GLState.h"
 #include "Scene.h"
 #include "Shader.h"
 #include "Mesh.h"
@@ -22,7 +23,7 @@ class GodraysScene : public Scene
       lightPos = glm::vec3(4.0f, 4.0f, -4.0f);
 
       // configure global opengl state
-      glEnable(GL_DEPTH_TEST);
+      glState().Enable(GL_DEPTH_TEST);
 
       // build and compile our shader program
       modelShader = new Shader("res/shaders/basic/basic.vs", "res/shaders/basic/basic.fs");
@@ -42,7 +43,7 @@ class GodraysScene : public Scene
       // Generate skybox
       skybox = new Skybox();
 
-      glEnable(GL_DEPTH_TEST);
+      glState().Enable(GL_DEPTH_TEST);
     }
 
     void Draw()
@@ -153,8 +154,7 @@ class GodraysScene : public Scene
     void DrawLamp()
     {
       lampShader->use();
-      lampShader->setMat4("projection", projection);
-      lampShader->setMat4("view", view);
+      uniformBlocks().SetCamera(projection, view, camera.Position); // lamp.vs reads the Camera block
       glm::mat4 model = glm::mat4();
       model = glm::translate(model, lightPos);
       model = glm::scale(model, glm::vec3(0.2f)); // a smaller cube
@@ -0,0 +1,68 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+// GPU time of a section of the frame with GL_TIME_ELAPSED queries, read back a few
+// frames later so the CPU never waits. Time elapsed queries cannot nest, sections
+// timed this way must not overlap (TextureLoader times its uploads outside of
+// Scene::Draw).
+class GpuTimer
+{
+  public:
+    void Begin()
+    {
+      if (!queries[0])
+        glGenQueries(FRAMES, queries);
+      collect();
+      if (pending[next])
+        return; // every query in flight, skip this frame
+      glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+      running = true;
+    }
+
+    void End()
+    {
+      if (!running)
+        return;
+      glEndQuery(GL_TIME_ELAPSED);
+      pending[next] = true;
+      next = (next + 1) % FRAMES;
+      running = false;
+    }
+
+    // Moving average over the last results, in milliseconds
+    double Ms() const { return ms; }
+
+    // Start averaging again, after switching what is measured
+    void Reset() { samples = 0; ms = 0.0; }
+
+  private:
+    static const unsigned int FRAMES = 4;
+    unsigned int queries[FRAMES] = {};
+    bool pending[FRAMES] = {};
+    unsigned int next = 0;
+    bool running = false;
+    double ms = 0.0;
+    unsigned int samples = 0;
+
+    void collect()
+    {
+      for (unsigned int i = 0; i < FRAMES; i++)
+      {
+        if (!pending[i])
+          continue;
+        GLint available = 0;
+        glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+          continue;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &ns);
+        pending[i] = false;
+        samples = samples < 60 ? samples + 1 : 60;
+        ms += (ns / 1.0e6 - ms) / samples;
+      }
+    }
+};
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef HLOD_H
+#define HLOD_H
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "GLState.h"
+#include "Model.h"
+#include "Shader.h"
+#include "GeometryArena.h"
+#include "ResourceManager.h"
+#include "TextureStats.h"
+#include "HLODFile.h"
+
+// Runtime side of a .hlod file (see cooker --hlod). Clusters farther than the switch
+// distance are drawn as their merged proxy, closer ones draw their member meshes of
+// the source model as usual. Proxies share an arena, the far ones draw in one call.
+class HLOD
+{
+  public:
+    float switchDistance = 40.0f;
+
+    // Stats of the last frame
+    unsigned int drawCalls = 0;
+    unsigned int triangles = 0;
+    unsigned int proxies = 0;
+
+    HLOD(const char* path, Model& model)
+      : model(model), proxyArena("hlod proxy", sizeof(HLODVertex), setupProxyAttributes)
+    {
+      HLODData data;
+      if (!readHLOD(path, data))
+      {
+        std::cout << "Cannot open HLOD " << path << std::endl;
+        return;
+      }
+
+      // Atlas
+      glGenTextures(1, &atlas);
+      glState().BindTexture(GL_TEXTURE_2D, atlas);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, data.atlasSize, data.atlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, data.atlas.data());
+      glGenerateMipmap(GL_TEXTURE_2D);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      resources().Add(RESOURCE_TEXTURE, atlas, rgba8MipChainBytes(data.atlasSize, data.atlasSize), path);
+
+      for (HLODCluster& c : data.clusters)
+      {
+        Cluster cluster;
+        cluster.min = c.min;
+        cluster.max = c.max;
+        cluster.members = c.members;
+        for (uint32_t m : c.members)
+          if (m < model.Meshes().size())
+            cluster.memberTriangles += model.Meshes()[m].indices.size() / 3;
+        cluster.geometry = proxyArena.Allocate(c.vertices.data(), c.vertices.size(), c.indices.data(), c.indices.size());
+        clusters.push_back(cluster);
+      }
+    }
+
+    ~HLOD()
+    {
+      if (atlas)
+        resources().Release(RESOURCE_TEXTURE, atlas);
+    }
+
+    // Pick proxy or members for every cluster
+    void Update(const glm::vec3& cameraPos, const glm::mat4& modelMatrix)
+    {
+      for (Cluster& c : clusters)
+      {
+        glm::vec3 lo = glm::vec3(modelMatrix * glm::vec4(c.min, 1.0f));
+        glm::vec3 hi = glm::vec3(modelMatrix * glm::vec4(c.max, 1.0f));
+        glm::vec3 bmin = glm::min(lo, hi), bmax = glm::max(lo, hi);
+        float d = glm::length(glm::max(glm::max(bmin - cameraPos, cameraPos - bmax), glm::vec3(0.0f)));
+        c.useProxy = d > switchDistance;
+      }
+    }
+
+    // Members of the near clusters, with the model's shader
+    void Draw(const Shader& shader)
+    {
+      drawCalls = triangles = proxies = 0;
+      for (Cluster& c : clusters)
+      {
+        if (c.useProxy)
+          continue;
+        for (uint32_t m : c.members)
+          model.Meshes()[m].Draw(shader);
+        drawCalls += c.members.size();
+        triangles += c.memberTriangles;
+      }
+    }
+
+    // Members of the near clusters, to draw sorted with the model's shader
+    void Submit(RenderQueue& queue)
+    {
+      drawCalls = triangles = proxies = 0;
+      for (Cluster& c : clusters)
+      {
+        if (c.useProxy)
+          continue;
+        for (uint32_t m : c.members)
+          queue.Submit(model.Meshes()[m]);
+        drawCalls += c.members.size();
+        triangles += c.memberTriangles;
+      }
+    }
+
+    // Proxies of the far clusters, shader uniforms are set by the caller
+    void DrawProxies(const Shader& proxyShader)
+    {
+      proxyShader.setInt("atlas", 0);
+      glState().ActiveTexture(GL_TEXTURE0);
+      glState().BindTexture(GL_TEXTURE_2D, atlas);
+      commands.clear();
+      for (Cluster& c : clusters)
+      {
+        if (!c.useProxy)
+          continue;
+        commands.push_back(GeometryArena::Command(c.geometry));
+        proxies++;
+        triangles += c.geometry.indexCount / 3;
+      }
+      proxyArena.MultiDraw(commands);
+      drawCalls += !commands.empty();
+    }
+
+    unsigned int ClusterCount() const { return clusters.size(); }
+
+  private:
+    struct Cluster
+    {
+      glm::vec3 min, max;
+      std::vector<uint32_t> members;
+      unsigned int memberTriangles = 0;
+      GeometryRange geometry;
+      bool useProxy = false;
+    };
+
+    Model& model;
+    std::vector<Cluster> clusters;
+    unsigned int atlas = 0;
+    GeometryArena proxyArena;
+    std::vector<DrawElementsIndirectCommand> commands;
+
+    // Attributes of HLODVertex, for the proxy arena
+    static void setupProxyAttributes()
+    {
+      glEnableVertexAttribArray(0);
+      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(HLODVertex), (void*)0);
+      glEnableVertexAttribArray(1);
+      glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(HLODVertex), (void*)offsetof(HLODVertex, Normal));
+      glEnableVertexAttribArray(2);
+      glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(HLODVertex), (void*)offsetof(HLODVertex, TexCoords));
+      glEnableVertexAttribArray(3);
+      glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(HLODVertex), (void*)offsetof(HLODVertex, Tile));
+    }
+};
+#endif
@@ -0,0 +1,171 @@
+#ifndef HLOD_BUILDER_H
+#define HLOD_BUILDER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "Mesh.h"
+#include "HLODFile.h"
+#include "dep/stb_image/stb_image.h"
+
+// Box filter an RGBA image into a tile of the atlas
+static void bakeAtlasTile(HLODData& hlod, unsigned int tx, unsigned int ty, const unsigned char* src, int w, int h, const glm::vec3& tint)
+{
+  for (unsigned int y = 0; y < HLOD_TILE_SIZE; y++)
+    for (unsigned int x = 0; x < HLOD_TILE_SIZE; x++)
+    {
+      unsigned char* dst = &hlod.atlas[((ty + y) * hlod.atlasSize + tx + x) * 4];
+      if (!src)
+      {
+        dst[0] = tint.r * 255; dst[1] = tint.g * 255; dst[2] = tint.b * 255; dst[3] = 255;
+        continue;
+      }
+
+      int x0 = x * w / HLOD_TILE_SIZE, x1 = std::max((int)((x + 1) * w / HLOD_TILE_SIZE), x0 + 1);
+      int y0 = y * h / HLOD_TILE_SIZE, y1 = std::max((int)((y + 1) * h / HLOD_TILE_SIZE), y0 + 1);
+      unsigned int sum[4] = { 0, 0, 0, 0 };
+      for (int sy = y0; sy < y1; sy++)
+        for (int sx = x0; sx < x1; sx++)
+          for (int c = 0; c < 4; c++)
+            sum[c] += src[(sy * w + sx) * 4 + c];
+      unsigned int n = (x1 - x0) * (y1 - y0);
+      for (int c = 0; c < 4; c++)
+        dst[c] = sum[c] / n;
+    }
+}
+
+// Group meshes by the grid cell of their bounds center, merge each group and simplify
+// it by vertex clustering on a grid of `resolution` cells along its largest side.
+static void buildHLOD(const std::vector<MeshData>& meshes, float clusterSize, unsigned int resolution, HLODData& hlod)
+{
+  // Atlas: one tile per material with a diffuse map, others get their Kd color
+  std::map<std::string, glm::vec4> tiles;
+  for (const MeshData& m : meshes)
+    tiles[m.material.name];
+
+  unsigned int perRow = (unsigned int)std::ceil(std::sqrt((float)tiles.size()));
+  hlod.atlasSize = std::max(perRow, 1u) * HLOD_TILE_SIZE;
+  hlod.atlas.assign(hlod.atlasSize * hlod.atlasSize * 4, 255);
+
+  unsigned int t = 0;
+  for (auto& tile : tiles)
+  {
+    const Material* mat = nullptr;
+    for (const MeshData& m : meshes)
+      if (m.material.name == tile.first)
+        mat = &m.material;
+
+    unsigned int tx = (t % perRow) * HLOD_TILE_SIZE, ty = (t / perRow) * HLOD_TILE_SIZE;
+    int w = 0, h = 0, n = 0;
+    unsigned char* data = mat->texPath.empty() ? nullptr : stbi_load(mat->texPath.c_str(), &w, &h, &n, 4);
+    bakeAtlasTile(hlod, tx, ty, data, w, h, mat->diffuse);
+    if (data)
+      stbi_image_free(data);
+
+    // Inset by half a texel so bilinear filtering stays inside the tile
+    float texel = 1.0f / hlod.atlasSize;
+    tile.second = glm::vec4(tx * texel + 0.5f * texel, ty * texel + 0.5f * texel,
+        (HLOD_TILE_SIZE - 1) * texel, (HLOD_TILE_SIZE - 1) * texel);
+    t++;
+  }
+
+  // Cluster meshes
+  std::map<uint64_t, std::vector<uint32_t>> groups;
+  for (unsigned int i = 0; i < meshes.size(); i++)
+  {
+    if (meshes[i].indices.empty())
+      continue;
+    glm::vec3 lo(INFINITY), hi(-INFINITY);
+    for (const Vertex& v : meshes[i].vertices)
+    {
+      lo = glm::min(lo, v.Position);
+      hi = glm::max(hi, v.Position);
+    }
+    glm::ivec3 cell = glm::ivec3(glm::floor((lo + hi) * 0.5f / clusterSize));
+    uint64_t key = ((uint64_t)(cell.x & 0x1fffff) << 42) | ((uint64_t)(cell.y & 0x1fffff) << 21) | (uint64_t)(cell.z & 0x1fffff);
+    groups[key].push_back(i);
+  }
+
+  for (auto& g : groups)
+  {
+    HLODCluster cluster;
+    cluster.members = g.second;
+    cluster.min = glm::vec3(INFINITY);
+    cluster.max = glm::vec3(-INFINITY);
+    for (uint32_t mi : cluster.members)
+      for (const Vertex& v : meshes[mi].vertices)
+      {
+        cluster.min = glm::min(cluster.min, v.Position);
+        cluster.max = glm::max(cluster.max, v.Position);
+      }
+
+    glm::vec3 extent = cluster.max - cluster.min;
+    float cell = std::max(std::max(extent.x, extent.y), extent.z) / resolution;
+    if (cell <= 0.0f)
+      cell = 1.0f;
+
+    // Vertices are welded per (grid cell, source mesh) so the atlas tile stays constant
+    struct Accum
+    {
+      glm::vec3 position = glm::vec3(0.0f);
+      glm::vec3 normal = glm::vec3(0.0f);
+      glm::vec2 uv;
+      unsigned int count = 0;
+      unsigned int index;
+    };
+    std::map<std::pair<uint64_t, uint32_t>, Accum> welded;
+    std::vector<std::pair<uint64_t, uint32_t>> corners;
+
+    for (uint32_t mi : cluster.members)
+    {
+      const MeshData& m = meshes[mi];
+      for (unsigned int i = 0; i < m.indices.size(); i++)
+      {
+        const Vertex& v = m.vertices[m.indices[i]];
+        glm::ivec3 q = glm::ivec3(glm::floor((v.Position - cluster.min) / cell));
+        uint64_t key = ((uint64_t)(q.x & 0x1fffff) << 42) | ((uint64_t)(q.y & 0x1fffff) << 21) | (uint64_t)(q.z & 0x1fffff);
+        std::pair<uint64_t, uint32_t> k(key, mi);
+
+        Accum& a = welded[k];
+        if (a.count == 0)
+          a.uv = v.TexCoords;
+        a.position += v.Position;
+        a.normal += v.Normal;
+        a.count++;
+        corners.push_back(k);
+      }
+    }
+
+    for (auto& w : welded)
+    {
+      Accum& a = w.second;
+      HLODVertex v;
+      v.Position = a.position / (float)a.count;
+      v.Normal = glm::length(a.normal) > 0.0f ? glm::normalize(a.normal) : glm::vec3(0.0f, 1.0f, 0.0f);
+      v.TexCoords = a.uv;
+      v.Tile = tiles[meshes[w.first.second].material.name];
+      a.index = cluster.vertices.size();
+      cluster.vertices.push_back(v);
+    }
+
+    // Keep only triangles that did not collapse
+    for (unsigned int i = 0; i + 2 < corners.size(); i += 3)
+    {
+      unsigned int a = welded[corners[i]].index, b = welded[corners[i + 1]].index, c = welded[corners[i + 2]].index;
+      if (a == b || b == c || a == c)
+        continue;
+      cluster.indices.push_back(a);
+      cluster.indices.push_back(b);
+      cluster.indices.push_back(c);
+    }
+
+    hlod.clusters.push_back(cluster);
+  }
+}
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef HLOD_FILE_H
+#define HLOD_FILE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+
+#include "dep/glm/glm.hpp"
+
+#include "CookedMesh.h"
+
+// Hierarchical LOD file (.hlod): meshes of a model are grouped into spatial clusters,
+// each one carrying a merged and simplified proxy mesh. Proxies sample a single
+// texture atlas holding a downscaled copy of every material's diffuse map.
+//
+// [header][atlas RGBA8][clusters...]
+const uint32_t HLOD_MAGIC = 0x444f4c48; // "HLOD"
+const uint32_t HLOD_VERSION = 1;
+const unsigned int HLOD_TILE_SIZE = 128;
+
+struct HLODVertex
+{
+  glm::vec3 Position;
+  glm::vec3 Normal;
+  glm::vec2 TexCoords;
+  glm::vec4 Tile; // atlas rect of the material: offset.xy, size.zw
+};
+
+struct HLODCluster
+{
+  glm::vec3 min;
+  glm::vec3 max;
+  std::vector<uint32_t> members; // indices in the model's mesh list
+  std::vector<HLODVertex> vertices;
+  std::vector<unsigned int> indices;
+};
+
+struct HLODData
+{
+  unsigned int atlasSize = 0;
+  std::vector<unsigned char> atlas;
+  std::vector<HLODCluster> clusters;
+};
+
+inline std::string hlodPath(const std::string& objPath)
+{
+  return objPath.substr(0, objPath.find_last_of('.')) + ".hlod";
+}
+
+inline bool writeHLOD(const std::string& path, const HLODData& hlod)
+{
+  std::ofstream out(path, std::ofstream::binary);
+  if (!out)
+  {
+    std::cerr << "Cannot write " << path << std::endl;
+    return false;
+  }
+
+  uint32_t header[4] = { HLOD_MAGIC, HLOD_VERSION, hlod.atlasSize, (uint32_t)hlod.clusters.size() };
+  out.write((const char*)header, sizeof(header));
+  out.write((const char*)hlod.atlas.data(), hlod.atlas.size());
+  for (const HLODCluster& c : hlod.clusters)
+  {
+    out.write((const char*)&c.min, sizeof(glm::vec3));
+    out.write((const char*)&c.max, sizeof(glm::vec3));
+    writeArray(out, c.members);
+    writeArray(out, c.vertices);
+    writeArray(out, c.indices);
+  }
+  return (bool)out;
+}
+
+inline bool readHLOD(const std::string& path, HLODData& hlod)
+{
+  std::ifstream in(path, std::ifstream::binary);
+  if (!in)
+    return false;
+
+  uint32_t header[4];
+  in.read((char*)header, sizeof(header));
+  if (!in || header[0] != HLOD_MAGIC || header[1] != HLOD_VERSION)
+  {
+    std::cout << "Ignoring outdated HLOD " << path << std::endl;
+    return false;
+  }
+
+  hlod.atlasSize = header[2];
+  hlod.atlas.resize(hlod.atlasSize * hlod.atlasSize * 4);
+  in.read((char*)hlod.atlas.data(), hlod.atlas.size());
+  hlod.clusters.resize(header[3]);
+  for (HLODCluster& c : hlod.clusters)
+  {
+    in.read((char*)&c.min, sizeof(glm::vec3));
+    in.read((char*)&c.max, sizeof(glm::vec3));
+    if (!readArray(in, c.members) || !readArray(in, c.vertices) || !readArray(in, c.indices))
+      return false;
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstdio>
+
+// 64-bit FNV-1a, used to key cooked assets and caches by content
+const uint64_t HASH_SEED = 14695981039346656037ULL;
+
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t h = HASH_SEED)
+{
+  const unsigned char* p = (const unsigned char*)data;
+  for (size_t i = 0; i < size; i++)
+  {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+inline uint64_t hashString(const std::string& s, uint64_t h = HASH_SEED)
+{
+  return hashBytes(s.data(), s.size(), h);
+}
+
+inline uint64_t hashCombine(uint64_t h, uint64_t v)
+{
+  return hashBytes(&v, sizeof(v), h);
+}
+
+// Hash the whole content of a file, returns false if it can't be read
+inline bool hashFile(const std::string& path, uint64_t& out)
+{
+  std::ifstream in(path, std::ifstream::binary);
+  if (!in)
+    return false;
+
+  uint64_t h = HASH_SEED;
+  char buffer[64 * 1024];
+  while (in)
+  {
+    in.read(buffer, sizeof(buffer));
+    h = hashBytes(buffer, in.gcount(), h);
+  }
+
+  out = h;
+  return true;
+}
+
+inline std::string hashToString(uint64_t h)
+{
+  char s[17];
+  snprintf(s, sizeof(s), "%016llx", (unsigned long long)h);
+  return std::string(s);
+}
+
+#endif
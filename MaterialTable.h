@@ -0,0 +1,98 @@
+#ifndef MATERIAL_TABLE_H
+#define MATERIAL_TABLE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <glad/glad.h>
+
+#include "dep/glm/glm.hpp"
+
+#include "GLState.h"
+#include "ResourceManager.h"
+
+// Texture unit of the table, after the ubershader's (see Scene::SetSamplerUnits)
+const unsigned int MATERIAL_TABLE_UNIT = 7;
+
+// Vertex attribute carrying the table entry of a draw (see GeometryArena, drawId)
+const GLuint MATERIAL_ID_ATTRIBUTE = 5;
+
+// One entry, five RGBA32F texels (see fetchMaterial in include/materials.glsl)
+struct MaterialRecord
+{
+  glm::vec4 ambient;  // w: what the diffuse alpha holds, see ChannelPack.h
+  glm::vec4 diffuse;  // w: 1 when the diffuse map is in the virtual texture
+  glm::vec4 specular;
+  glm::vec4 layers;   // texture array layers of the diffuse, normal, specular and mask maps, -1 for none
+  glm::vec4 vtRegion; // of the diffuse map in the virtual texture
+};
+
+// Everything a draw of the ubershader used to get as uniforms (colors, layers, which
+// maps there are, virtual texture region), one entry per distinct material, in a
+// texture buffer the shaders index with the draw's material ID. A draw then only
+// needs its ID: a vertex attribute, constant for single draws and instanced for
+// multi-draws, so whole runs of meshes go out in one call.
+//
+// A texture buffer works from GL 3.1 and, unlike a uniform block, holds any number of
+// entries.
+class MaterialTable
+{
+  public:
+    // Index of the entry holding record, added when no material has it yet. Entries
+    // are uploaded with the next Bind.
+    unsigned int Add(const MaterialRecord& record)
+    {
+      std::string key((const char*)&record, sizeof(record));
+      auto it = indices.find(key);
+      if (it != indices.end())
+        return it->second;
+
+      records.push_back(record);
+      dirty = true;
+      return indices[key] = records.size() - 1;
+    }
+
+    // On MATERIAL_TABLE_UNIT
+    void Bind()
+    {
+      if (dirty)
+        upload();
+      glState().BindTexture(MATERIAL_TABLE_UNIT, GL_TEXTURE_BUFFER, texture);
+    }
+
+    unsigned int Count() const { return records.size(); }
+
+  private:
+    std::vector<MaterialRecord> records;
+    std::unordered_map<std::string, unsigned int> indices; // by record bytes
+    unsigned int buffer = 0, texture = 0;
+    bool dirty = false;
+
+    void upload()
+    {
+      if (!buffer)
+      {
+        glGenBuffers(1, &buffer);
+        glGenTextures(1, &texture);
+        resources().Add(RESOURCE_BUFFER, buffer, 0, "material table");
+      }
+      glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+      glBufferData(GL_TEXTURE_BUFFER, records.size() * sizeof(MaterialRecord), records.data(), GL_STATIC_DRAW);
+      glBindBuffer(GL_TEXTURE_BUFFER, 0);
+      resources().SetBytes(RESOURCE_BUFFER, buffer, records.size() * sizeof(MaterialRecord));
+
+      // The texture reads the buffer's new store
+      glState().BindTexture(MATERIAL_TABLE_UNIT, GL_TEXTURE_BUFFER, texture);
+      glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+      dirty = false;
+    }
+};
+
+inline MaterialTable& materialTable()
+{
+  static MaterialTable table;
+  return table;
+}
+
+#endif
@@ -7,7 +7,19 @@
 #include "dep/glm/gtc/matrix_transform.hpp"
 #include "dep/stb_image/stb_image.h"
 
+#include "GLState.h"
 #include "Shader.h"
+#include "ShaderVariants.h"
+#include "DDS.h"
+#include "TextureStats.h"
+#include "TextureLoader.h"
+#include "TextureArrays.h"
+#include "VirtualTexture.h"
+#include "ChannelPack.h"
+#include "ResourceManager.h"
+#include "UniformBlocks.h"
+#include "GeometryArena.h"
+#include "MaterialTable.h"
 
 #include <string>
 #include <fstream>
@@ -15,11 +27,12 @@
 #include <iostream>
 #include <vector>
 #include <unordered_map>
+#include <array>
+#include <chrono>
+#include <cmath>
 
 using namespace std;
 
-static unordered_map<std::string, unsigned int> texturesMap;
-
 struct Vertex {
   // position
   glm::vec3 Position;
@@ -33,6 +46,34 @@ struct Vertex {
   glm::vec3 Bitangent;
 };
 
+// Attribute pointers of Vertex, the vertex buffer bound
+static void setupVertexAttributes()
+{
+  // vertex Positions
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+  // vertex normals
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+  // vertex texture coords
+  glEnableVertexAttribArray(2);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+  // vertex tangent
+  glEnableVertexAttribArray(3);
+  glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+  // vertex bitangent
+  glEnableVertexAttribArray(4);
+  glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+}
+
+// Vertices and indices of every Mesh, behind one VAO (see GeometryArena); draws carry
+// their material table entry
+inline GeometryArena& meshArena()
+{
+  static GeometryArena arena("mesh", sizeof(Vertex), setupVertexAttributes, 1 << 18, 1 << 20, MATERIAL_ID_ATTRIBUTE);
+  return arena;
+}
+
 struct Texture {
   unsigned int id;
   string type;
@@ -50,59 +91,192 @@ struct Material {
   glm::vec3 specular = glm::vec3(1.0f, 1.0f, 1.0f);
 };
 
-// Utility function for loading a 2D texture from file
-static unsigned int loadTexture(char const * path)
+// CPU side geometry of a mesh, as produced by the importer or read back from a cooked file
+struct MeshData {
+  string name;
+  vector<Vertex> vertices;
+  vector<unsigned int> indices;
+  Material material;
+};
+
+// Per-triangle tangents for normal mapping
+static void computeTangents(vector<Vertex>& vertices, const vector<unsigned int>& indices)
 {
-  if (texturesMap.find(std::string(path)) != texturesMap.end())
-    return texturesMap[std::string(path)];
+  for (unsigned int i = 0; i < indices.size(); i += 3)
+  {
+    Vertex v1, v2, v3;
+    v1 = vertices[indices[i]];
+    v2 = vertices[indices[i + 1]];
+    v3 = vertices[indices[i + 2]];
+
+    glm::vec2 uv1 = v1.TexCoords;
+    glm::vec2 uv2 = v2.TexCoords;
+    glm::vec2 uv3 = v3.TexCoords;
+
+    glm::vec3 tangent;
+
+    glm::vec3 edge1 = v2.Position - v1.Position;
+    glm::vec3 edge2 = v3.Position - v1.Position;
+    glm::vec2 deltaUV1 = uv2 - uv1;
+    glm::vec2 deltaUV2 = uv3 - uv1;
+
+    GLfloat f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+
+    tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
+    tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
+    tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
+    tangent = glm::normalize(tangent);
+
+    v1.Tangent = tangent;
+    v2.Tangent = tangent;
+    v3.Tangent = tangent;
+
+    vertices[indices[i]] = v1;
+    vertices[indices[i + 1]] = v2;
+    vertices[indices[i + 2]] = v3;
+  }
+
+  // Normalize
+  for (unsigned int i = 0; i < indices.size(); i++)
+  {
+    vertices[indices[i]].Tangent = glm::normalize(vertices[indices[i]].Tangent);
+  }
+}
+
+// Utility function for loading a 2D texture from file, filter tells how to build its
+// mips (color, normal or plain data, see MipChain.h). Textures are shared through the
+// resource manager, every call takes a reference to give back with
+// resources().Release(RESOURCE_TEXTURE, id).
+inline unsigned int loadTexture(char const * path, MipFilter filter = MIP_SRGB)
+{
+  if (unsigned int cached = resources().Acquire(RESOURCE_TEXTURE, path))
+    return cached;
+
+  if (asyncTextureLoading)
+  {
+    unsigned int textureID = textureLoader().Load(path, filter);
+    resources().Add(RESOURCE_TEXTURE, textureID, 0, path, true);
+    resources().SetLoading(RESOURCE_TEXTURE, textureID);
+    return textureID;
+  }
+
+  auto start = std::chrono::high_resolution_clock::now();
+  TextureRecord record = { path, "", 0, 0, 0, 0, 0, 0.0 };
 
   unsigned int textureID;
   glGenTextures(1, &textureID);
 
-  int width, height, nrComponents;
-  unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-  if (data)
+  DDSImage dds;
+  if (preferCompressedTextures && readDDS(ddsPath(path), dds) && ddsSupported(dds))
   {
-    GLenum format;
-    if (nrComponents == 1)
-      format = GL_RED;
-    if (nrComponents == 2)
-      format = GL_ALPHA;
-    else if (nrComponents == 3)
-      format = GL_RGB;
-    else if (nrComponents == 4)
-      format = GL_RGBA;
-
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    glState().BindTexture(GL_TEXTURE_2D, textureID);
+    record.bytes = uploadDDS(dds, GL_TEXTURE_2D);
+    record.path = ddsPath(path);
+    record.format = dds.formatName;
+    record.width = dds.width;
+    record.height = dds.height;
+    record.levels = dds.levels;
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, dds.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    stbi_image_free(data);
   }
   else
   {
-    std::cout << "Texture failed to load at path: " << path << std::endl;
-    stbi_image_free(data);
+    int width, height, nrComponents;
+    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
+    if (data)
+    {
+      GLenum format;
+      if (nrComponents == 1)
+        format = GL_RED;
+      if (nrComponents == 2)
+        format = GL_ALPHA;
+      else if (nrComponents == 3)
+        format = GL_RGB;
+      else if (nrComponents == 4)
+        format = GL_RGBA;
+
+      glState().BindTexture(GL_TEXTURE_2D, textureID);
+      glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+      glGenerateMipmap(GL_TEXTURE_2D);
+
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+      stbi_image_free(data);
+
+      record.format = "RGBA8";
+      record.width = width;
+      record.height = height;
+      record.levels = 1 + (unsigned int)std::floor(std::log2((float)std::max(width, height)));
+      record.bytes = rgba8MipChainBytes(width, height);
+    }
+    else
+    {
+      std::cout << "Texture failed to load at path: " << path << std::endl;
+      stbi_image_free(data);
+    }
   }
 
-  texturesMap[std::string(path)] = textureID;
+  record.uncompressedBytes = record.width ? rgba8MipChainBytes(record.width, record.height) : 0;
+  record.ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+  textureRecords().push_back(record);
+
+  resources().Add(RESOURCE_TEXTURE, textureID, record.bytes, path, true);
   return textureID;
 }
 
+// Uniforms set by Mesh::Draw for programs without the material table (see
+// MaterialTable), resolved once per program
+struct MeshUniforms
+{
+  bool materialTable = false; // the program reads the table, nothing is set
+  Uniform<glm::ivec4> layers;
+  Uniform<bool> hasNormalMap, hasSpecularMap, hasMaskMap, hasVirtualTexture;
+  Uniform<int> diffuseAlpha;
+  Uniform<glm::vec4> vtRegion;
+};
+
+static const MeshUniforms& meshUniforms(const Shader& shader)
+{
+  static std::unordered_map<unsigned int, MeshUniforms> programs;
+  auto it = programs.find(shader.Serial());
+  if (it != programs.end())
+    return it->second;
+
+  MeshUniforms& u = programs[shader.Serial()];
+  u.materialTable = shader.Location("materialTable") >= 0;
+  u.layers = shader.Get<glm::ivec4>("layers");
+  u.hasNormalMap = shader.Get<bool>("hasNormalMap");
+  u.hasSpecularMap = shader.Get<bool>("hasSpecularMap");
+  u.hasMaskMap = shader.Get<bool>("hasMaskMap");
+  u.hasVirtualTexture = shader.Get<bool>("hasVirtualTexture");
+  u.diffuseAlpha = shader.Get<int>("diffuseAlpha");
+  u.vtRegion = shader.Get<glm::vec4>("vtRegion");
+  return u;
+}
+
 class Mesh {
   public:
     vector<Vertex> vertices;
     vector<unsigned int> indices;
     Material material;
-    unsigned int diffuseMap, normalMap, maskMap, specularMap;
-    unsigned int VAO;
+    const TextureLayer *diffuseMap = nullptr, *normalMap = nullptr, *maskMap = nullptr, *specularMap = nullptr;
+    const glm::vec4* virtualRegion = nullptr; // diffuse map in the virtual texture, if packed there
+    PackedAlpha diffuseAlpha = PACKED_NONE;   // map carried in the diffuse alpha, see ChannelPack.h
+    GeometryRange geometry;                   // in meshArena()
+    unsigned int VAO;                         // the arena's, shared by every mesh
     std::string name;
 
+    // Model space bounds and UV units per model unit, for texture streaming
+    glm::vec3 center;
+    float radius = 0.0f, uvDensity = 0.0f;
+
+    // Tangents are expected to be already computed (see computeTangents)
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, Material material)
     {
       this->vertices = vertices;
@@ -113,159 +287,215 @@ class Mesh {
       std::cout << "NRM" << material.normalPath << std::endl;
       std::cout << "MSK" << material.maskPath << std::endl;*/
 
+      // Layers of the shared texture arrays, see TextureArrays, unless the diffuse map
+      // is paged in from the virtual texture
       if (!material.texPath.empty())
-        diffuseMap = loadTexture(material.texPath.c_str());
+        virtualRegion = virtualTexture().Region(material.texPath);
 
-      if (!material.normalPath.empty())
+      // The mask, or else the specular map, goes into the diffuse alpha
+      std::string packedPath;
+      if (!material.texPath.empty() && !virtualRegion)
       {
-        normalMap = loadTexture(material.normalPath.c_str());
-        computeTangents();
+        PackedAlpha usage;
+        packedPath = packedTexturePath(material.texPath, packedAlphaMap(material.maskPath, material.specularPath, usage));
+        if (!packedPath.empty())
+          diffuseAlpha = usage;
+        diffuseMap = textureArrays().Add(packedPath.empty() ? material.texPath : packedPath, MIP_SRGB);
       }
 
-      if (!material.specularPath.empty())
-        specularMap = loadTexture(material.specularPath.c_str());
+      if (!material.normalPath.empty())
+        normalMap = textureArrays().Add(material.normalPath, MIP_NORMAL);
+
+      if (!material.specularPath.empty() && diffuseAlpha != PACKED_SPECULAR)
+        specularMap = textureArrays().Add(material.specularPath, MIP_LINEAR);
+
+      if (!material.maskPath.empty() && diffuseAlpha != PACKED_MASK)
+        maskMap = textureArrays().Add(material.maskPath, MIP_LINEAR);
 
-      if (!material.maskPath.empty())
-        maskMap = loadTexture(material.maskPath.c_str());
+      computeTexelDensity();
 
       // now that we have all the required data, set the vertex buffers and its attribute pointers.
       setupMesh();
     }
 
-    // Render the mesh
-    void Draw(const Shader& shader)
+    // Material features for the ubershader permutations (see ShaderVariants)
+    unsigned int Features() const
     {
-      // Bind textures
-      if (!material.texPath.empty())
-      {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseMap);
-      }
+      return (normalMap ? FEATURE_NORMAL_MAP : 0) | (specularMap ? FEATURE_SPECULAR_MAP : 0)
+        | (maskMap ? FEATURE_MASK_MAP : 0) | (virtualRegion ? FEATURE_VIRTUAL_TEXTURE : 0)
+        | (diffuseAlpha == PACKED_MASK ? FEATURE_ALPHA_MASK : 0) | (diffuseAlpha == PACKED_SPECULAR ? FEATURE_ALPHA_SPECULAR : 0);
+    }
 
-      shader.setBool("hasNormalMap", false);
-      if (!material.normalPath.empty())
+    // Bind what the mesh draws with: its texture arrays (usually still bound from the
+    // previous mesh) and the permutation of shader for its features, put in use and
+    // returned. Programs without the material table get the mesh's uniforms.
+    const Shader& Prepare(const Shader& shader)
+    {
+      for (unsigned int unit = 0; unit < 4; unit++)
+        if (const TextureLayer* map = maps()[unit])
+          if (map->array)
+            textureArrays().Bind(unit, map->array);
+      TouchTextures();
+
+      const Shader& program = shader.Variant(features());
+      const MeshUniforms& u = meshUniforms(program);
+      if (u.materialTable)
       {
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, normalMap);
-        shader.setBool("hasNormalMap", true);
+        materialTable().Bind();
+        return program;
       }
 
-      shader.setBool("hasSpecularMap", false);
-      if (!material.maskPath.empty())
-      {
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, specularMap);
-        shader.setBool("hasSpecularMap", true);
-      }
+      glm::ivec4 layers = Layers();
+      program.set(u.hasNormalMap, layers.y >= 0);
+      program.set(u.hasSpecularMap, layers.z >= 0);
+      program.set(u.hasMaskMap, layers.w >= 0);
+      program.set(u.layers, layers);
+      program.set(u.diffuseAlpha, (int)diffuseAlpha);
+
+      program.set(u.hasVirtualTexture, virtualRegion != nullptr);
+      if (virtualRegion)
+        program.set(u.vtRegion, *virtualRegion);
+      return program;
+    }
 
-      shader.setBool("hasMaskMap", false);
-      if (!material.maskPath.empty())
-      {
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, maskMap);
-        shader.setBool("hasMaskMap", true);
-      }
+    // Render the mesh
+    void Draw(const Shader& shader)
+    {
+      const Shader& program = Prepare(shader);
+      if (meshUniforms(program).materialTable)
+        meshArena().Draw(geometry, MaterialIndex());
+      else
+        meshArena().Draw(geometry);
+    }
 
-      // Set material params
-      shader.setVec3("material.ambient", material.ambient);
-      shader.setVec3("material.diffuse", material.diffuse);
-      shader.setVec3("material.specular", material.specular);
+    // Whether other draws with the same program and textures, so both can go in one
+    // multi-draw
+    bool SharesState(const Mesh& other) const
+    {
+      for (unsigned int i = 0; i < 4; i++)
+        if (arrayOf(maps()[i]) != arrayOf(other.maps()[i]))
+          return false;
+      return features() == other.features();
+    }
 
-      // Draw mesh
-      glBindVertexArray(VAO);
-      glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-      glBindVertexArray(0);
+    // Entry of the mesh in the material table, added on first use (the layers are
+    // known once the texture arrays are built)
+    unsigned int MaterialIndex()
+    {
+      if (materialIndex != NO_MATERIAL)
+        return materialIndex;
+
+      glm::ivec4 layers = Layers();
+      MaterialRecord r = MaterialRecord();
+      r.ambient = glm::vec4(material.ambient, (float)diffuseAlpha);
+      r.diffuse = glm::vec4(material.diffuse, virtualRegion ? 1.0f : 0.0f);
+      r.specular = glm::vec4(material.specular, 0.0f);
+      r.layers = glm::vec4(layers);
+      r.vtRegion = virtualRegion ? *virtualRegion : glm::vec4(0.0f);
+      unsigned int index = materialTable().Add(r);
+
+      bool built = true;
+      for (const TextureLayer* map : maps())
+        built &= !map || map->array;
+      if (built)
+        materialIndex = index;
+      return index;
+    }
+
+    // Layers of the diffuse, normal, specular and mask maps, -1 where there is none
+    glm::ivec4 Layers() const
+    {
+      return glm::ivec4(layerOf(diffuseMap), layerOf(normalMap), layerOf(specularMap), layerOf(maskMap));
+    }
+
+    // This frame's use of the maps, for texture streaming (see TextureStreamer::Touch)
+    void TouchTextures() const
+    {
+      for (const TextureLayer* map : maps())
+        if (map && map->array)
+          textureStreamer().Touch(map->array, center, radius, uvDensity);
+    }
+
+    // Give the arena range and the texture layer references back, once
+    void Release()
+    {
+      if (released)
+        return;
+      released = true;
+      meshArena().Free(geometry);
+      geometry = GeometryRange();
+      for (const TextureLayer** map : { &diffuseMap, &normalMap, &specularMap, &maskMap })
+        if (*map)
+        {
+          textureArrays().Release(*map);
+          *map = nullptr;
+        }
     }
 
 private:
-    /*  Render data  */
-    unsigned int VBO, EBO;
+    static const unsigned int NO_MATERIAL = ~0u;
+    unsigned int materialIndex = NO_MATERIAL;
+    bool released = false;
 
     /*  Functions    */
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    std::array<const TextureLayer*, 4> maps() const { return {{ diffuseMap, normalMap, specularMap, maskMap }}; }
+
+    static unsigned int arrayOf(const TextureLayer* texture) { return texture ? texture->array : 0; }
+
+    // Layer index for the shader, -1 when there is no texture
+    static int layerOf(const TextureLayer* texture)
+    {
+      return texture && texture->array ? texture->layer : -1;
+    }
+
+    // Material features less the maps that failed to load
+    unsigned int features() const
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+      unsigned int f = Features();
+      if (layerOf(normalMap) < 0)
+        f &= ~FEATURE_NORMAL_MAP;
+      if (layerOf(specularMap) < 0)
+        f &= ~FEATURE_SPECULAR_MAP;
+      if (layerOf(maskMap) < 0)
+        f &= ~FEATURE_MASK_MAP;
+      return f;
     }
 
-    void computeTangents()
+    // Bounding sphere, and how many UV units cover one model unit on average
+    // (sqrt of UV area over surface area), see TextureStreamer::Touch
+    void computeTexelDensity()
     {
-      for (unsigned int i = 0; i < indices.size(); i += 3)
+      if (vertices.empty())
+        return;
+
+      glm::vec3 lo = vertices[0].Position, hi = lo;
+      for (const Vertex& v : vertices)
       {
-        Vertex v1, v2, v3;
-        v1 = vertices[indices[i]];
-        v2 = vertices[indices[i + 1]];
-        v3 = vertices[indices[i + 2]];
-
-        /*glm::vec2 uv1(0.0f, 1.0f);
-        glm::vec2 uv2(0.0f, 0.0f);
-        glm::vec2 uv3(1.0f, 0.0f);  
-        glm::vec2 uv4(1.0f, 1.0f);*/
-        glm::vec2 uv1 = v1.TexCoords;
-        glm::vec2 uv2 = v2.TexCoords;
-        glm::vec2 uv3 = v3.TexCoords;
-
-        glm::vec3 tangent;
-
-        glm::vec3 edge1 = v2.Position - v1.Position;
-        glm::vec3 edge2 = v3.Position - v1.Position;
-        glm::vec2 deltaUV1 = uv2 - uv1;
-        glm::vec2 deltaUV2 = uv3 - uv1;
-
-        GLfloat f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-        tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-        tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-        tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-        tangent = glm::normalize(tangent);
-
-        v1.Tangent = tangent;
-        v2.Tangent = tangent;
-        v3.Tangent = tangent;
-
-        vertices[indices[i]] = v1;
-        vertices[indices[i + 1]] = v2;
-        vertices[indices[i + 2]] = v3;
+        lo = glm::min(lo, v.Position);
+        hi = glm::max(hi, v.Position);
       }
+      center = (lo + hi) * 0.5f;
+      radius = glm::length(hi - lo) * 0.5f;
 
-      // Normalize
-      for (unsigned int i = 0; i < indices.size(); i++)
+      double area = 0.0, uvArea = 0.0;
+      for (unsigned int i = 0; i + 2 < indices.size(); i += 3)
       {
-        vertices[indices[i]].Tangent = glm::normalize(vertices[indices[i]].Tangent);
+        const Vertex& a = vertices[indices[i]];
+        const Vertex& b = vertices[indices[i + 1]];
+        const Vertex& c = vertices[indices[i + 2]];
+        area += glm::length(glm::cross(b.Position - a.Position, c.Position - a.Position)) * 0.5;
+        glm::vec2 e1 = b.TexCoords - a.TexCoords, e2 = c.TexCoords - a.TexCoords;
+        uvArea += std::abs(e1.x * e2.y - e2.x * e1.y) * 0.5;
       }
+      if (area > 0.0)
+        uvDensity = (float)std::sqrt(uvArea / area);
+    }
+
+    // Copy the geometry into the shared arena
+    void setupMesh()
+    {
+        geometry = meshArena().Allocate(vertices.data(), vertices.size(), indices.data(), indices.size());
+        VAO = meshArena().VAO();
     }
 };
 #endif
@@ -0,0 +1,192 @@
+#ifndef MIP_CHAIN_H
+#define MIP_CHAIN_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// CPU mip chain generation (2x2 box filter), an alternative to glGenerateMipmap that
+// can run on worker threads or offline. Color maps are averaged in linear space
+// (sRGB decoded), normal maps are averaged as vectors and renormalized, everything
+// else (masks, specular, heightmaps) is averaged as stored.
+
+enum MipFilter
+{
+  MIP_LINEAR = 0,
+  MIP_SRGB = 1,
+  MIP_NORMAL = 2
+};
+
+struct MipImage
+{
+  int width = 0, height = 0;
+  std::vector<uint8_t> rgba;
+};
+
+struct SRGBTables
+{
+  float toLinear[256];
+  uint8_t fromLinear[4096];
+
+  SRGBTables()
+  {
+    for (int i = 0; i < 256; i++)
+    {
+      float c = i / 255.0f;
+      toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+    for (int i = 0; i < 4096; i++)
+    {
+      float l = i / 4095.0f;
+      float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+      fromLinear[i] = (uint8_t)std::min(255.0f, c * 255.0f + 0.5f);
+    }
+  }
+};
+
+inline const SRGBTables& srgbTables()
+{
+  static SRGBTables tables;
+  return tables;
+}
+
+// Average of the four source pixels at (x0|x1, y0|y1), one output pixel
+static void filterPixel(const MipImage& src, int x0, int x1, int y0, int y1, MipFilter filter, uint8_t* out)
+{
+  const uint8_t* p[4] = {
+    &src.rgba[(y0 * src.width + x0) * 4], &src.rgba[(y0 * src.width + x1) * 4],
+    &src.rgba[(y1 * src.width + x0) * 4], &src.rgba[(y1 * src.width + x1) * 4]
+  };
+
+  if (filter == MIP_LINEAR)
+  {
+    for (int c = 0; c < 4; c++)
+      out[c] = (p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4;
+    return;
+  }
+
+  const SRGBTables& t = srgbTables();
+#ifdef __SSE2__
+  __m128 sum = _mm_setzero_ps();
+  for (int i = 0; i < 4; i++)
+  {
+    __m128 v = filter == MIP_SRGB
+      ? _mm_setr_ps(t.toLinear[p[i][0]], t.toLinear[p[i][1]], t.toLinear[p[i][2]], p[i][3] / 255.0f)
+      : _mm_sub_ps(_mm_mul_ps(_mm_setr_ps(p[i][0], p[i][1], p[i][2], p[i][3]), _mm_setr_ps(2.0f / 255.0f, 2.0f / 255.0f, 2.0f / 255.0f, 1.0f / 255.0f)), _mm_setr_ps(1.0f, 1.0f, 1.0f, 0.0f));
+    sum = _mm_add_ps(sum, v);
+  }
+  float v[4];
+  _mm_storeu_ps(v, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+  float v[4] = { 0, 0, 0, 0 };
+  for (int i = 0; i < 4; i++)
+    for (int c = 0; c < 4; c++)
+    {
+      if (c == 3)
+        v[c] += p[i][c] / 255.0f * 0.25f;
+      else if (filter == MIP_SRGB)
+        v[c] += t.toLinear[p[i][c]] * 0.25f;
+      else
+        v[c] += (p[i][c] * (2.0f / 255.0f) - 1.0f) * 0.25f;
+    }
+#endif
+
+  if (filter == MIP_SRGB)
+  {
+    for (int c = 0; c < 3; c++)
+      out[c] = t.fromLinear[(int)(std::min(1.0f, std::max(0.0f, v[c])) * 4095.0f + 0.5f)];
+  }
+  else
+  {
+    float len = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (len > 0.0f)
+      for (int c = 0; c < 3; c++)
+        v[c] /= len;
+    for (int c = 0; c < 3; c++)
+      out[c] = (uint8_t)std::min(255.0f, std::max(0.0f, (v[c] * 0.5f + 0.5f) * 255.0f + 0.5f));
+  }
+  out[3] = (uint8_t)(std::min(1.0f, std::max(0.0f, v[3])) * 255.0f + 0.5f);
+}
+
+// Half size level of src, odd sizes clamp at the edge
+static MipImage downsample(const MipImage& src, MipFilter filter)
+{
+  MipImage dst;
+  dst.width = std::max(1, src.width / 2);
+  dst.height = std::max(1, src.height / 2);
+  dst.rgba.resize((size_t)dst.width * dst.height * 4);
+
+  for (int y = 0; y < dst.height; y++)
+  {
+    int y0 = std::min(y * 2, src.height - 1), y1 = std::min(y * 2 + 1, src.height - 1);
+    int x = 0;
+
+#ifdef __SSE2__
+    // Two output pixels per step in 16 bit integer lanes
+    if (filter == MIP_LINEAR)
+    {
+      const uint8_t* row0 = &src.rgba[(size_t)y0 * src.width * 4];
+      const uint8_t* row1 = &src.rgba[(size_t)y1 * src.width * 4];
+      const __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+      for (; x + 1 < dst.width && x * 2 + 3 < src.width; x += 2)
+      {
+        __m128i a = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+        __m128i b = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+        hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+        __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), two), 2);
+        _mm_storel_epi64((__m128i*)&dst.rgba[((size_t)y * dst.width + x) * 4], _mm_packus_epi16(sum, zero));
+      }
+    }
+#endif
+
+    for (; x < dst.width; x++)
+    {
+      int x0 = std::min(x * 2, src.width - 1), x1 = std::min(x * 2 + 1, src.width - 1);
+      filterPixel(src, x0, x1, y0, y1, filter, &dst.rgba[((size_t)y * dst.width + x) * 4]);
+    }
+  }
+  return dst;
+}
+
+// Every level down to 1x1, chain[0] is base
+static void buildMipChain(const MipImage& base, MipFilter filter, std::vector<MipImage>& chain)
+{
+  chain.clear();
+  chain.push_back(base);
+  while (chain.back().width > 1 || chain.back().height > 1)
+    chain.push_back(downsample(chain.back(), filter));
+}
+
+// Bilinear resize (no filtering beyond the four nearest texels, for moderate ratios)
+static MipImage resizeImage(const MipImage& src, int width, int height)
+{
+  MipImage dst;
+  dst.width = width;
+  dst.height = height;
+  dst.rgba.resize((size_t)width * height * 4);
+  for (int y = 0; y < height; y++)
+    for (int x = 0; x < width; x++)
+    {
+      float sx = std::max(0.0f, (x + 0.5f) * src.width / width - 0.5f), sy = std::max(0.0f, (y + 0.5f) * src.height / height - 0.5f);
+      int x0 = std::min((int)sx, src.width - 1), y0 = std::min((int)sy, src.height - 1);
+      int x1 = std::min(x0 + 1, src.width - 1), y1 = std::min(y0 + 1, src.height - 1);
+      float fx = sx - x0, fy = sy - y0;
+      for (int c = 0; c < 4; c++)
+      {
+        float top = src.rgba[(y0 * src.width + x0) * 4 + c] * (1 - fx) + src.rgba[(y0 * src.width + x1) * 4 + c] * fx;
+        float bottom = src.rgba[(y1 * src.width + x0) * 4 + c] * (1 - fx) + src.rgba[(y1 * src.width + x1) * 4 + c] * fx;
+        dst.rgba[((size_t)y * width + x) * 4 + c] = (uint8_t)(top * (1 - fy) + bottom * fy + 0.5f);
+      }
+    }
+  return dst;
+}
+
+#endif
@@ -2,7 +2,9 @@
 #define MODEL_H
 
 #include "Mesh.h"
+#include "RenderQueue.h"
 #include "OBJImporter.h"
+#include "CookedMesh.h"
 
 #include <vector>
 
@@ -17,8 +19,35 @@ class Model
   public:
     Model(const char* filename)
     {
-      OBJImporter importer;
-      importer.importOBJ(filename, meshes);
+      // Prefer the cooked binary (see cooker.cpp), fall back to parsing the OBJ
+      std::vector<MeshData> data;
+      if (readCookedMeshes(cookedMeshPath(filename), data))
+      {
+        for (unsigned int i = 0; i < data.size(); i++)
+        {
+          Mesh mesh(data[i].vertices, data[i].indices, data[i].material);
+          mesh.name = data[i].name;
+          meshes.push_back(mesh);
+        }
+      }
+      else
+      {
+        OBJImporter importer;
+        importer.importOBJ(filename, meshes);
+      }
+
+      // Pack the textures of the meshes into arrays and start loading them
+      textureLoader().LoadArrays();
+    }
+
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    // Meshes give back their arena ranges and texture layers
+    virtual ~Model()
+    {
+      for (Mesh& mesh : meshes)
+        mesh.Release();
     }
 
     virtual void Draw(const Shader& shader)
@@ -29,7 +58,18 @@ class Model
       }
     }
 
+    // Queue every mesh, to draw sorted (see RenderQueue)
+    virtual void Submit(RenderQueue& queue)
+    {
+      for (Mesh& mesh : meshes)
+        queue.Submit(mesh);
+    }
+
+    std::vector<Mesh>& Meshes() { return meshes; }
+
   protected:
     std::vector<Mesh> meshes;
+
+    Model() {}
 };
 #endif
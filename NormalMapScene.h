@@ -1,6 +1,7 @@
 #ifndef NORMAL_MAP_SCENE_H
 #define NORMAL_MAP_SCENE_H
 
+#include "GLState.h"
 #include "Scene.h"
 #include "Model.h"
 #include "Shader.h"
@@ -20,7 +21,7 @@ class NormalMapScene : Scene
       lamp = new Model("res/models/cube.obj");
 
       // Global OpenGL setting
-      glEnable(GL_DEPTH_TEST);
+      glState().Enable(GL_DEPTH_TEST);
     }
 
     void Draw()
@@ -100,8 +101,7 @@ class NormalMapScene : Scene
     void DrawLamp()
     {
       lampShader->use();
-      lampShader->setMat4("projection", projection);
-      lampShader->setMat4("view", view);
+      uniformBlocks().SetCamera(projection, view, camera.Position); // lamp.vs reads the Camera block
       glm::mat4 model = glm::mat4();
       model = glm::translate(model, lightPos);
       model = glm::scale(model, glm::vec3(0.2f)); // a smaller cube
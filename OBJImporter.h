@@ -48,11 +48,27 @@ class OBJImporter
     std::unordered_map<std::string, Material> materialMap;
 
     void importOBJ(const char* filename, std::vector<Mesh>& meshes)
+    {
+      std::vector<MeshData> data;
+      if (!importOBJ(filename, data) && data.empty())
+        exit(1);
+
+      for (unsigned int i = 0; i < data.size(); i++)
+      {
+        Mesh mesh(data[i].vertices, data[i].indices, data[i].material);
+        mesh.name = data[i].name;
+        meshes.push_back(mesh);
+      }
+    }
+
+    // GL-free import, used by both Model and the asset cooker
+    bool importOBJ(const char* filename, std::vector<MeshData>& meshes)
     {
       std::ifstream in(filename, std::ifstream::in);
       if (!in)
       {
-        std::cerr << "Cannot open " << filename << std::endl; exit(1);
+        std::cerr << "Cannot open " << filename << std::endl;
+        return false;
       }
 
       // Strip directory
@@ -135,7 +151,7 @@ class OBJImporter
           if (!done)
           {
             std::cout << "Unsupported file!\n" << std::endl;
-            return;
+            return false;
           }
         }
         else if (line.substr(0,7) == "mtllib ")
@@ -145,14 +161,13 @@ class OBJImporter
           s >> mtlPath;
           std::cout << mtlPath << std::endl;
           std::string fullPath = dir + "/" + mtlPath;
-          importMtl(fullPath.c_str(), materialMap);
+          if (!importMtl(fullPath.c_str(), materialMap))
+            return false;
         }
         else if (line.substr(0,7) == "usemtl ")
         {
           if (!firstMesh) {
-            Mesh mesh(vertices, indices, materialMap[currentMtl]);
-            mesh.name = currentObj;
-            meshes.push_back(mesh);
+            pushMesh(currentObj, materialMap[currentMtl], meshes);
             vertices.clear();
             indices.clear();
           }
@@ -176,18 +191,22 @@ class OBJImporter
         }
       }
 
-      Mesh mesh(vertices, indices, materialMap[currentMtl]);
-      meshes.push_back(mesh);
+      pushMesh(currentObj, materialMap[currentMtl], meshes);
+      return true;
     }
 
-    void importMtl(const char* filename, std::unordered_map<std::string, Material>& mtlMap)
+    bool importMtl(const char* filename, std::unordered_map<std::string, Material>& mtlMap)
     {
       std::ifstream in(filename, std::ifstream::in);
       if (!in)
       {
-        std::cerr << "Cannot open " << filename << std::endl; exit(1);
+        std::cerr << "Cannot open " << filename << std::endl;
+        return false;
       }
 
+      std::string filenameS(filename);
+      std::string dir = filenameS.substr(0, filenameS.find_last_of("\\/"));
+
       std::string line;
       Material currentMtl = Material();
       bool first = true;
@@ -209,21 +228,25 @@ class OBJImporter
         {
           std::istringstream s(line.substr(7));
           s >> currentMtl.texPath;
+          currentMtl.texPath = resolveTexturePath(dir, currentMtl.texPath);
         }
         else if (line.substr(0, 7) == "map_Ks ")
         {
           std::istringstream s(line.substr(7));
           s >> currentMtl.specularPath;
+          currentMtl.specularPath = resolveTexturePath(dir, currentMtl.specularPath);
         }
         else if (line.substr(0, 9) == "map_bump ")
         {
           std::istringstream s(line.substr(9));
           s >> currentMtl.normalPath;
+          currentMtl.normalPath = resolveTexturePath(dir, currentMtl.normalPath);
         }
         else if (line.substr(0, 6) == "map_d ")
         {
           std::istringstream s(line.substr(6));
           s >> currentMtl.maskPath;
+          currentMtl.maskPath = resolveTexturePath(dir, currentMtl.maskPath);
         }
         else if (line.substr(0, 3) == "Ka ")
         {
@@ -252,6 +275,43 @@ class OBJImporter
       }
 
       mtlMap[currentMtl.name] = currentMtl;
+      return true;
+    }
+
+    // MTL files exported on another machine carry absolute paths: fall back to
+    // the same file relative to the repo root or next to the MTL itself.
+    static std::string resolveTexturePath(const std::string& dir, const std::string& path)
+    {
+      if (std::ifstream(path).good())
+        return path;
+
+      size_t res = path.find("res/");
+      if (res != std::string::npos && std::ifstream(path.substr(res)).good())
+        return path.substr(res);
+
+      std::string local = dir + "/" + path;
+      if (std::ifstream(local).good())
+        return local;
+
+      std::string base = dir + "/" + path.substr(path.find_last_of("\\/") + 1);
+      if (std::ifstream(base).good())
+        return base;
+
+      return path;
+    }
+
+    void pushMesh(const std::string& name, const Material& material, std::vector<MeshData>& meshes)
+    {
+      MeshData mesh;
+      mesh.name = name;
+      mesh.vertices = vertices;
+      mesh.indices = indices;
+      mesh.material = material;
+
+      if (!material.normalPath.empty())
+        computeTangents(mesh.vertices, mesh.indices);
+
+      meshes.push_back(mesh);
     }
 
     void pushVertex(unsigned int v, unsigned int vt, unsigned int vn, bool hasUV)
@@ -0,0 +1,160 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstdio>
+
+#include <sys/stat.h>
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+#include "Hash.h"
+
+// Linked programs saved with glGetProgramBinary and loaded back with glProgramBinary,
+// one file per program in res/shadercache. The key hashes the driver (vendor, renderer,
+// version) and the sources as compiled, defines included, so a permutation, an edited
+// shader or a driver update each get their own entry. Binaries are only a hint: the
+// driver may reject one at any time (new driver, different GPU), the program is then
+// compiled from source and the entry written again.
+//
+// [magic, version, format, length][binary]
+const uint32_t PROGRAM_CACHE_MAGIC = 0x50524743; // "PRGC"
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+const char* const PROGRAM_CACHE_DIR = "res/shadercache/";
+
+class ProgramCache
+{
+  public:
+    bool enabled = true;
+
+    struct Stats
+    {
+      unsigned int hits = 0, misses = 0, rejected = 0, stored = 0;
+    };
+
+    bool Supported() const
+    {
+      return glExtensionFunctions().getProgramBinary && glExtensionFunctions().programBinary;
+    }
+
+    // Key of a program built from these sources (the defines are already in them,
+    // hashed again so the key never depends on where they were inserted)
+    uint64_t Key(const std::string& vertex, const std::string& fragment, const std::string& geometry, const std::string& defines)
+    {
+      uint64_t h = hashString(driver());
+      h = hashString(defines, h);
+      h = hashCombine(hashString(vertex, h), vertex.size());
+      h = hashCombine(hashString(fragment, h), fragment.size());
+      return hashCombine(hashString(geometry, h), geometry.size());
+    }
+
+    // Link program from the cached binary; false on a miss or when the driver refuses
+    // it, program then has to be compiled and linked as usual
+    bool Load(unsigned int program, uint64_t key)
+    {
+      if (!enabled || !Supported())
+        return false;
+
+      std::string path = filePath(key);
+      std::ifstream in(path, std::ifstream::binary);
+      uint32_t header[4];
+      if (!in || !in.read((char*)header, sizeof(header)) || header[0] != PROGRAM_CACHE_MAGIC || header[1] != PROGRAM_CACHE_VERSION)
+      {
+        stats.misses++;
+        return false;
+      }
+      std::vector<char> binary(header[3]);
+      in.read(binary.data(), binary.size());
+      if (!in)
+      {
+        stats.misses++;
+        return false;
+      }
+
+      glExtensionFunctions().programBinary(program, header[2], binary.data(), binary.size());
+      GLint linked = 0;
+      glGetProgramiv(program, GL_LINK_STATUS, &linked);
+      if (!linked)
+      {
+        std::cout << "Driver rejected cached program " << path << ", compiling from source" << std::endl;
+        stats.rejected++;
+        remove(path.c_str());
+        return false;
+      }
+      stats.hits++;
+      return true;
+    }
+
+    // Call before glLinkProgram for programs that will be stored
+    void PrepareLink(unsigned int program) const
+    {
+      if (enabled && glExtensionFunctions().programParameteri)
+        glExtensionFunctions().programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // Save a program freshly linked from source
+    void Store(unsigned int program, uint64_t key)
+    {
+      if (!enabled || !Supported())
+        return;
+
+      GLint length = 0;
+      glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+      if (length <= 0)
+        return;
+      std::vector<char> binary(length);
+      GLenum format = 0;
+      glExtensionFunctions().getProgramBinary(program, length, &length, &format, binary.data());
+
+      mkdir(PROGRAM_CACHE_DIR, 0755);
+      std::string path = filePath(key);
+      std::ofstream out(path, std::ofstream::binary);
+      uint32_t header[4] = { PROGRAM_CACHE_MAGIC, PROGRAM_CACHE_VERSION, format, (uint32_t)length };
+      out.write((const char*)header, sizeof(header));
+      out.write(binary.data(), length);
+      if (!out)
+      {
+        std::cerr << "Cannot write " << path << std::endl;
+        out.close();
+        remove(path.c_str());
+        return;
+      }
+      stats.stored++;
+    }
+
+    const Stats& GetStats() const { return stats; }
+
+  private:
+    Stats stats;
+    std::string driverString;
+
+    const std::string& driver()
+    {
+      if (driverString.empty())
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION })
+        {
+          const char* s = (const char*)glGetString(name);
+          driverString += s ? s : "";
+          driverString += '\n';
+        }
+      return driverString;
+    }
+
+    static std::string filePath(uint64_t key)
+    {
+      return PROGRAM_CACHE_DIR + hashToString(key) + ".bin";
+    }
+};
+
+inline ProgramCache& programCache()
+{
+  static ProgramCache cache;
+  return cache;
+}
+
+#endif
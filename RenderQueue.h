@@ -0,0 +1,192 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+#include "dep/glm/glm.hpp"
+
+#include "Mesh.h"
+#include "Hash.h"
+
+// Passes in execution order: masked geometry (alpha tested, it discards) draws after
+// every opaque mesh so it is depth tested against them and opaque meshes keep early-z
+enum RenderPass
+{
+  PASS_OPAQUE = 0,
+  PASS_MASKED,
+  RENDER_PASSES
+};
+
+// A draw as submitted by a scene: the mesh, and where it goes in the frame
+struct DrawPacket
+{
+  uint64_t key;
+  Mesh* mesh;
+};
+
+// Draws of a frame sorted to change as little state as possible between them. The
+// 64-bit key orders by, from the top bits:
+//
+// [pass 2][program 8][texture set 14][vertex array 16][depth 24]
+//
+// so a pass draws permutation after permutation, each texture set once, and meshes
+// sharing all of that front to back. Keys are radix sorted (stable, submission order
+// breaks ties). The sorted packets can be executed several times, with different
+// shaders, until the next Begin.
+//
+// With programs reading the material table, consecutive packets sharing program and
+// textures go out as one multi-draw when the driver can give each draw its material
+// ID (see GeometryArena::MultiDrawIds), one draw each otherwise.
+class RenderQueue
+{
+  public:
+    bool enabled = true;  // sort; off executes in submission order, for comparison
+    bool batching = true; // multi-draw runs of packets sharing state
+
+    // Start the frame's packets, depth is the distance to eye of the mesh bounds
+    // transformed by modelMatrix, quantized up to farDistance
+    void Begin(const glm::vec3& eye, const glm::mat4& modelMatrix, float farDistance = 1000.0f)
+    {
+      packets.clear();
+      this->eye = eye;
+      this->modelMatrix = modelMatrix;
+      this->farDistance = farDistance;
+      sorted = false;
+      sortMs = submitMs = 0.0;
+    }
+
+    void Submit(Mesh& mesh)
+    {
+      unsigned int features = mesh.Features();
+      RenderPass pass = (features & (FEATURE_MASK_MAP | FEATURE_ALPHA_MASK)) ? PASS_MASKED : PASS_OPAQUE;
+      float distance = glm::length(glm::vec3(modelMatrix * glm::vec4(mesh.center, 1.0f)) - eye);
+      packets.push_back({ Key(pass, features, textureSet(mesh), mesh.VAO, distance / farDistance), &mesh });
+    }
+
+    static uint64_t Key(RenderPass pass, unsigned int program, unsigned int textures, unsigned int vao, float depth)
+    {
+      uint64_t d = (uint64_t)(glm::clamp(depth, 0.0f, 1.0f) * 0xffffff);
+      return (uint64_t)pass << 62 | (uint64_t)(program & 0xff) << 54 | (uint64_t)(textures & 0x3fff) << 40
+        | (uint64_t)(vao & 0xffff) << 24 | d;
+    }
+
+    // Draw the packets in key order with shader (its permutations, when attached)
+    void Execute(const Shader& shader)
+    {
+      auto start = std::chrono::high_resolution_clock::now();
+      if (enabled && !sorted)
+      {
+        sort();
+        sorted = true;
+        auto sortEnd = std::chrono::high_resolution_clock::now();
+        sortMs += std::chrono::duration<double, std::milli>(sortEnd - start).count();
+        start = sortEnd;
+      }
+
+      GeometryArena& arena = meshArena();
+      bool batch = batching && arena.MultiDrawIds() && meshUniforms(shader).materialTable;
+      for (size_t i = 0; i < packets.size();)
+      {
+        Mesh& first = *packets[i].mesh;
+        if (!batch)
+        {
+          first.Draw(shader);
+          i++;
+          continue;
+        }
+
+        first.Prepare(shader);
+        commands.clear();
+        drawIds.clear();
+        for (; i < packets.size() && packets[i].mesh->SharesState(first); i++)
+        {
+          Mesh& mesh = *packets[i].mesh;
+          if (&mesh != &first)
+            mesh.TouchTextures();
+          commands.push_back(GeometryArena::Command(mesh.geometry));
+          drawIds.push_back(mesh.MaterialIndex());
+        }
+        arena.MultiDraw(commands, drawIds);
+      }
+      submitMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // Geometry alone, every packet in one multi-draw (see GeometryArena), for passes
+    // whose program needs nothing per mesh: no textures, material or permutations
+    void ExecuteGeometry()
+    {
+      auto start = std::chrono::high_resolution_clock::now();
+      commands.clear();
+      for (const DrawPacket& p : packets)
+        commands.push_back(GeometryArena::Command(p.mesh->geometry));
+      meshArena().MultiDraw(commands);
+      submitMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    unsigned int Draws() const { return packets.size(); }
+
+    // CPU time since Begin
+    double SortMs() const { return sortMs; }
+    double SubmitMs() const { return submitMs; }
+
+  private:
+    std::vector<DrawPacket> packets, scratch;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<GLuint> drawIds;
+    glm::vec3 eye;
+    glm::mat4 modelMatrix;
+    float farDistance = 1000.0f;
+    bool sorted = false;
+    double sortMs = 0.0, submitMs = 0.0;
+
+    // Arrays bound by the mesh, folded to the key's 14 bits; a collision only costs
+    // binds, never correctness
+    static unsigned int textureSet(const Mesh& mesh)
+    {
+      uint64_t h = HASH_SEED;
+      for (const TextureLayer* map : { mesh.diffuseMap, mesh.normalMap, mesh.specularMap, mesh.maskMap })
+        h = hashCombine(h, map ? map->array : 0);
+      return (unsigned int)(h ^ h >> 14 ^ h >> 28 ^ h >> 42 ^ h >> 56);
+    }
+
+    // LSD radix sort on the keys, a byte per pass; bytes equal in every key (the high
+    // vertex array byte, usually) skip their pass
+    void sort()
+    {
+      size_t n = packets.size();
+      if (n < 2)
+        return;
+      scratch.resize(n);
+
+      uint32_t counts[8][256] = {};
+      for (const DrawPacket& p : packets)
+        for (unsigned int b = 0; b < 8; b++)
+          counts[b][(p.key >> (b * 8)) & 0xff]++;
+
+      DrawPacket* src = packets.data();
+      DrawPacket* dst = scratch.data();
+      for (unsigned int b = 0; b < 8; b++)
+      {
+        unsigned int shift = b * 8;
+        if (counts[b][(src[0].key >> shift) & 0xff] == n)
+          continue;
+        uint32_t offset = 0;
+        for (unsigned int i = 0; i < 256; i++)
+        {
+          uint32_t c = counts[b][i];
+          counts[b][i] = offset;
+          offset += c;
+        }
+        for (size_t i = 0; i < n; i++)
+          dst[counts[b][(src[i].key >> shift) & 0xff]++] = src[i];
+        std::swap(src, dst);
+      }
+      if (src != packets.data())
+        packets.swap(scratch);
+    }
+};
+
+#endif
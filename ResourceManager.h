@@ -0,0 +1,222 @@
+#ifndef RESOURCE_MANAGER_H
+#define RESOURCE_MANAGER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "GLState.h"
+
+enum ResourceType
+{
+  RESOURCE_TEXTURE = 0,
+  RESOURCE_BUFFER,
+  RESOURCE_PROGRAM,
+  RESOURCE_TYPES
+};
+
+inline const char* resourceTypeName(ResourceType type)
+{
+  static const char* names[RESOURCE_TYPES] = { "Textures", "Buffers", "Programs" };
+  return names[type];
+}
+
+// Owner of the GL objects created for assets: textures, buffers and programs with their
+// size in VRAM (as far as we know it) and a reference count. Named resources are shared,
+// loading the same file again takes a new reference instead of a new object; when the
+// last reference goes they stay cached, and are deleted least recently released first
+// once the total is over budgetBytes. Unnamed resources belong to whoever added them
+// and are deleted with their last reference.
+class ResourceManager
+{
+  public:
+    size_t budgetBytes = 512 * 1024 * 1024;
+
+    struct Entry
+    {
+      ResourceType type;
+      unsigned int id = 0;
+      std::string name;        // file for shared resources, a label otherwise
+      size_t bytes = 0;
+      unsigned int refs = 0;
+      bool shared = false;
+      bool loading = false;    // size not known yet, never evicted
+      unsigned long lastUsed = 0;
+    };
+
+    struct Usage
+    {
+      unsigned int count = 0, cached = 0;
+      size_t bytes = 0, cachedBytes = 0;
+    };
+
+    // Shared resource loaded from name, with a new reference; 0 when not loaded
+    unsigned int Acquire(ResourceType type, const std::string& name)
+    {
+      auto it = byName[type].find(name);
+      if (it == byName[type].end())
+        return 0;
+      Entry& e = entries[key(type, it->second)];
+      e.refs++;
+      e.lastUsed = frame;
+      hits++;
+      return e.id;
+    }
+
+    // Take over id with one reference. Shared resources can be acquired by name.
+    void Add(ResourceType type, unsigned int id, size_t bytes, const std::string& name, bool shared = false)
+    {
+      Entry& e = entries[key(type, id)];
+      e.type = type;
+      e.id = id;
+      e.name = name;
+      e.bytes = bytes;
+      e.refs = 1;
+      e.shared = shared;
+      e.lastUsed = frame;
+      if (shared)
+        byName[type][name] = id;
+    }
+
+    // Created, its data arrives later (see TextureLoader)
+    void SetLoading(ResourceType type, unsigned int id)
+    {
+      auto it = entries.find(key(type, id));
+      if (it != entries.end())
+        it->second.loading = true;
+    }
+
+    // New size after an upload, a streamed level or an eviction
+    void SetBytes(ResourceType type, unsigned int id, size_t bytes)
+    {
+      auto it = entries.find(key(type, id));
+      if (it == entries.end())
+        return;
+      it->second.bytes = bytes;
+      it->second.loading = false;
+    }
+
+    void Release(ResourceType type, unsigned int id)
+    {
+      auto it = entries.find(key(type, id));
+      if (it == entries.end() || it->second.refs == 0)
+        return;
+      Entry& e = it->second;
+      e.lastUsed = frame;
+      if (--e.refs == 0 && !e.shared)
+        destroy(it);
+    }
+
+    // Render thread, once per frame: trim the cache to the budget
+    void Update()
+    {
+      frame++;
+      size_t total = TotalBytes();
+      while (total > budgetBytes)
+      {
+        auto lru = entries.end();
+        for (auto it = entries.begin(); it != entries.end(); ++it)
+          if (it->second.refs == 0 && !it->second.loading && (lru == entries.end() || it->second.lastUsed < lru->second.lastUsed))
+            lru = it;
+        if (lru == entries.end())
+          break; // everything over budget is in use
+        total -= lru->second.bytes;
+        destroy(lru);
+        evictions++;
+      }
+    }
+
+    // Delete every cached resource nobody references
+    void Purge()
+    {
+      for (auto it = entries.begin(); it != entries.end();)
+      {
+        auto next = std::next(it);
+        if (it->second.refs == 0 && !it->second.loading)
+          destroy(it);
+        it = next;
+      }
+    }
+
+    Usage Stats(ResourceType type) const
+    {
+      Usage u;
+      for (const auto& it : entries)
+      {
+        const Entry& e = it.second;
+        if (e.type != type)
+          continue;
+        u.count++;
+        u.bytes += e.bytes;
+        if (e.refs == 0)
+        {
+          u.cached++;
+          u.cachedBytes += e.bytes;
+        }
+      }
+      return u;
+    }
+
+    size_t TotalBytes() const
+    {
+      size_t total = 0;
+      for (const auto& it : entries)
+        total += it.second.bytes;
+      return total;
+    }
+
+    // Largest first
+    std::vector<const Entry*> Largest(unsigned int count) const
+    {
+      std::vector<const Entry*> list;
+      for (const auto& it : entries)
+        list.push_back(&it.second);
+      std::sort(list.begin(), list.end(), [](const Entry* a, const Entry* b) { return a->bytes > b->bytes; });
+      if (list.size() > count)
+        list.resize(count);
+      return list;
+    }
+
+    unsigned long Frame() const { return frame; }
+    unsigned int Evictions() const { return evictions; }
+    unsigned int Hits() const { return hits; }
+
+  private:
+    std::unordered_map<uint64_t, Entry> entries;
+    std::unordered_map<std::string, unsigned int> byName[RESOURCE_TYPES];
+    unsigned long frame = 0;
+    unsigned int evictions = 0, hits = 0;
+
+    static uint64_t key(ResourceType type, unsigned int id)
+    {
+      return (uint64_t)type << 32 | id;
+    }
+
+    void destroy(std::unordered_map<uint64_t, Entry>::iterator it)
+    {
+      Entry& e = it->second;
+      switch (e.type)
+      {
+        case RESOURCE_TEXTURE: glState().ForgetTexture(e.id); glDeleteTextures(1, &e.id); break;
+        case RESOURCE_BUFFER: glDeleteBuffers(1, &e.id); break;
+        case RESOURCE_PROGRAM: glState().ForgetProgram(e.id); glDeleteProgram(e.id); break;
+        default: break;
+      }
+      if (e.shared)
+        byName[e.type].erase(e.name);
+      entries.erase(it);
+    }
+};
+
+inline ResourceManager& resources()
+{
+  static ResourceManager manager;
+  return manager;
+}
+
+#endif
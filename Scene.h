@@ -12,9 +12,13 @@
 #include "dep/imgui/imgui.h"
 #include "dep/imgui/imgui_impl_glfw_gl3.h"
 
+#include "GLState.h"
 #include "Camera.h"
 #include "Godrays.h"
 #include "ShadowMap.h"
+#include "RenderQueue.h"
+#include "ResourceManager.h"
+#include "UniformBlocks.h"
 
 // Static variables for GLFW (they must be updated by GLFW callbacks!)
 GLFWwindow* s_Window;
@@ -30,7 +34,7 @@ Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 
 static void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-  glViewport(0, 0, width, height);
+  glState().Viewport(0, 0, width, height);
 }
 
 static void mouse_callback(GLFWwindow* window, double xpos, double ypos)
@@ -120,8 +124,12 @@ class Scene
       m_GodraysParams.density = 0.84f;
       m_GodraysParams.weight = 3.65f;
 
+      // Programs compile in the background up to here (see Shader)
+      SetSamplerUnits(*m_UberShader);
+      m_UberShader->onReload = SetSamplerUnits;
+
       // OpenGL settings
-      glEnable(GL_DEPTH_TEST);
+      glState().Enable(GL_DEPTH_TEST);
       //glEnable(GL_CULL_FACE);
       /*glEnable(GL_BLEND);
       glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);*/
@@ -139,38 +147,43 @@ class Scene
       // Projection - View matrices
       m_Projection = glm::perspective(glm::radians(camera.Zoom), (float)s_WindowWidth / (float)s_WindowHeight, 0.1f, 1000.0f);
       m_View = camera.GetViewMatrix();
+      uniformBlocks().SetCamera(m_Projection, m_View, camera.Position);
+      textureStreamer().SetView(camera.Position, glm::radians(camera.Zoom), (float)s_WindowHeight);
 
       glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     }
 
+    // Camera and material data live in uniform blocks (see UniformBlocks.h), the light
+    // block is updated here
     void SetShaderParams(ShaderParams params)
     {
       m_UberShader->use();
-      m_UberShader->setMat4("projection", m_Projection);
-      m_UberShader->setMat4("view", m_View);
       m_UberShader->setMat4("model", glm::mat4());
-
-      // Shadows
       m_UberShader->setBool("softShadows", m_SoftShadows);
-      m_UberShader->setInt("shadowMap", 4);
-
-      // Set light uniforms
-      m_UberShader->setVec3("viewPos", camera.Position);
-      m_UberShader->setVec3("lightPos", m_LightPos);
-
-      // Material
-      m_UberShader->setInt("material.diffuseMap", 0);
-      m_UberShader->setInt("normalMap", 1);
-      m_UberShader->setInt("specularMap", 2);
-      m_UberShader->setInt("maskMap", 3);
-      m_UberShader->setFloat("material.shininess", params.s);
-
-      // Light
-      m_UberShader->setVec3("light.position", m_LightPos);
-      m_UberShader->setVec3("light.ambient", glm::vec3(params.la));
-      m_UberShader->setVec3("light.diffuse", glm::vec3(params.ld));
-      m_UberShader->setVec3("light.specular", glm::vec3(params.ls));
+
+      LightBlock light = LightBlock();
+      light.position = m_LightPos;
+      light.farPlane = m_ShadowMap->far_plane;
+      light.ambient = glm::vec3(params.la);
+      light.diffuse = glm::vec3(params.ld);
+      light.specular = glm::vec3(params.ls);
+      light.shininess = params.s;
+      uniformBlocks().SetLight(light);
+    }
+
+    // Texture units of the ubershader, they stay set in the program
+    static void SetSamplerUnits(Shader& shader)
+    {
+      shader.use();
+      shader.setInt("diffuseMap", 0);
+      shader.setInt("normalMap", 1);
+      shader.setInt("specularMap", 2);
+      shader.setInt("maskMap", 3);
+      shader.setInt("shadowMap", 4);
+      shader.setInt("vtCache", 5);
+      shader.setInt("vtIndirection", 6);
+      shader.setInt("materialTable", MATERIAL_TABLE_UNIT);
     }
 
   protected:
@@ -194,6 +207,7 @@ class Scene
     Godrays* m_Godrays;
     GodraysParams m_GodraysParams;
     ShadowMap* m_ShadowMap;
+    RenderQueue m_RenderQueue;
 
     // Toggle features
     bool m_GodraysEnabled;
@@ -203,8 +217,6 @@ class Scene
     void DrawLamp()
     {
       m_LampShader->use();
-      m_LampShader->setMat4("projection", m_Projection);
-      m_LampShader->setMat4("view", m_View);
       glm::mat4 model = glm::mat4();
       model = glm::translate(model, m_LightPos);
       model = glm::scale(model, glm::vec3(0.2f)); // a smaller cube
@@ -213,6 +225,49 @@ class Scene
       m_Lamp->Draw(*m_LampShader);
     }
 
+    // GPU memory per resource type, budget and largest resources (inside an ImGui frame)
+    void DrawMemoryPanel()
+    {
+      ResourceManager& rm = resources();
+      ImGui::Begin("Memory");
+
+      float budgetMB = rm.budgetBytes / (1024.0f * 1024.0f);
+      if (ImGui::SliderFloat("Budget (MB)", &budgetMB, 16.0f, 2048.0f))
+        rm.budgetBytes = (size_t)(budgetMB * 1024.0f * 1024.0f);
+      ImGui::Text("Total %.1f/%.1f MB, %u evictions, %u cache hits", rm.TotalBytes() / (1024.0f * 1024.0f), budgetMB,
+          rm.Evictions(), rm.Hits());
+      if (ImGui::Button("Purge Unused"))
+        rm.Purge();
+
+      for (unsigned int t = 0; t < RESOURCE_TYPES; t++)
+      {
+        ResourceManager::Usage u = rm.Stats((ResourceType)t);
+        ImGui::Text("%-9s %5u  %8.2f MB  (%u unused, %.2f MB)", resourceTypeName((ResourceType)t), u.count,
+            u.bytes / (1024.0f * 1024.0f), u.cached, u.cachedBytes / (1024.0f * 1024.0f));
+      }
+
+      if (ImGui::CollapsingHeader("Largest"))
+        for (const ResourceManager::Entry* e : rm.Largest(20))
+          ImGui::Text("%8.2f MB  %2u refs  %s", e->bytes / (1024.0f * 1024.0f), e->refs, e->name.c_str());
+
+      ImGui::End();
+    }
+
+    // GL state calls of the last frame, issued and filtered as redundant, per kind
+    void DrawGLStatePanel()
+    {
+      GLState& gl = glState();
+      ImGui::Begin("GL State");
+
+      ImGui::Checkbox("Filter Redundant GL Calls", &gl.filtering);
+      const GLState::Counters& c = gl.LastFrame();
+      ImGui::Text("%u calls issued, %u redundant%s", c.Issued(), c.Filtered(), gl.filtering ? " (filtered)" : "");
+      for (unsigned int i = 0; i < STATE_CALLS; i++)
+        ImGui::Text("%-20s %6u  %6u", glStateCallName((GLStateCall)i), c.issued[i], c.filtered[i]);
+
+      ImGui::End();
+    }
+
   private:
     void processInput() const
     {
@@ -3,170 +3,568 @@
 
 #include <glad/glad.h>
 #include "dep/glm/glm.hpp"
+#include "GLState.h"
+#include "ResourceManager.h"
+#include "UniformBlocks.h"
+#include "ProgramCache.h"
+#include "FileWatcher.h"
+#include "UniformStats.h"
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <vector>
+#include <algorithm>
+
+// Location of a uniform resolved once (Shader::Get), for code setting it every draw.
+// Handles of inactive uniforms hold -1, which glUniform ignores. The name is kept for
+// UniformStats, which reports sets by name.
+template <typename T>
+struct Uniform
+{
+    GLint location = -1;
+    const std::string* name = nullptr; // owned by the Shader that resolved it
+};
 
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
-    // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
-    {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure e)
+    // runs on the new program, in use, each time a hot reload swaps it in: uniforms set
+    // once when the shader was created (sampler units) have to be set again
+    std::function<void(Shader&)> onReload;
+    // constructor generates the shader on the fly, defines are inserted after the
+    // #version line of every stage (see ShaderVariants). The program is only submitted
+    // to the driver: construct the shaders of a scene together, they compile in parallel
+    // and the first use (or Location, Get) of each waits for it.
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const std::string& defines = "")
+      : vertexPath(vertexPath), fragmentPath(fragmentPath), geometryPath(geometryPath ? geometryPath : ""), defines(defines)
+    {
+        submit(build);
+        ID = build.program;
+        if (!build.linking)
+            reflectUniforms();
+        resources().Add(RESOURCE_PROGRAM, ID, 0, fragmentPath);
+        instances().push_back(this);
+    }
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+    // gives the program back to the ResourceManager, which deletes it
+    ~Shader()
+    {
+        discard(reload);
+        collect(build);
+        resources().Release(RESOURCE_PROGRAM, ID);
+        auto& shaders = instances();
+        shaders.erase(std::remove(shaders.begin(), shaders.end(), this), shaders.end());
+    }
+    // true once the program is linked, false while it compiles and when it failed to
+    // (see Failed); never waits for the driver when it compiles in parallel, without
+    // KHR_parallel_shader_compile this collects the program right away
+    // ------------------------------------------------------------------------
+    bool Ready() const
+    {
+        if (build.linking && !linked(build))
+            return false;
+        finish();
+        return !failed;
+    }
+    // the driver is done with the program and it did not compile or link; drawing with
+    // it would fail, until a hot reload fixes it
+    bool Failed() const
+    {
+        if (build.linking && !linked(build))
+            return false;
+        finish();
+        return failed;
+    }
+    // build the program again from its files, in the background; the current program
+    // stays in use until the new one links (see UpdateReloads), and for good if it fails
+    // ------------------------------------------------------------------------
+    void Reload()
+    {
+        finish();
+        discard(reload);
+        if (!submit(reload))
+            discard(reload);
+    }
+    // source files of the program, includes too
+    const std::vector<std::string>& Dependencies() const { return dependencies; }
+    // every shader alive, for hot reloading
+    static std::vector<Shader*>& instances()
+    {
+        static std::vector<Shader*> shaders;
+        return shaders;
+    }
+    static void ReloadAll()
+    {
+        for (Shader* shader : instances())
+            shader->Reload();
+    }
+    // render thread, once per frame: rebuild the programs using a file saved since the
+    // last call, and swap in the rebuilt ones that are linked
+    // ------------------------------------------------------------------------
+    static void UpdateReloads()
+    {
+        std::vector<std::string> changed;
+        fileWatcher().Poll(changed);
+        for (Shader* shader : instances())
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            for (const std::string& file : changed)
+                if (std::find(shader->dependencies.begin(), shader->dependencies.end(), file) != shader->dependencies.end())
+                {
+                    std::cout << "Reloading " << shader->fragmentPath << " (" << file << " changed)" << std::endl;
+                    shader->Reload();
+                    break;
+                }
+            shader->swapReloaded();
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        int success;
-        char infoLog[512];
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
-        {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
-        }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        finish();
+        glState().UseProgram(ID); 
+    }
+    // location of an active uniform, -1 otherwise (no GL query, see reflectUniforms)
+    // ------------------------------------------------------------------------
+    GLint Location(const std::string &name) const
+    {
+        finish();
+        auto it = uniforms.find(name);
+        return it != uniforms.end() ? it->second : -1;
+    }
+    // program to draw with for the given ShaderFeature bits: a permutation when variants
+    // are attached (see ShaderVariants), this one otherwise
+    // ------------------------------------------------------------------------
+    std::function<const Shader&(unsigned int)> selectVariant;
+    const Shader& Variant(unsigned int features) const
+    {
+        return selectVariant ? selectVariant(features) : *this;
+    }
+    // different for every program linked, to key caches of handles on
+    unsigned int Serial() const { finish(); return serial; }
+    template <typename T>
+    Uniform<T> Get(const std::string &name) const
+    {
+        Uniform<T> uniform;
+        uniform.location = Location(name);
+        uniform.name = &*handleNames.insert(name).first;
+        return uniform;
+    }
+    // typed handles, no lookup at all
+    // ------------------------------------------------------------------------
+    void set(Uniform<bool> uniform, bool value) const { track(uniform, (int)value); glUniform1i(uniform.location, (int)value); }
+    void set(Uniform<int> uniform, int value) const { track(uniform, value); glUniform1i(uniform.location, value); }
+    void set(Uniform<float> uniform, float value) const { track(uniform, value); glUniform1f(uniform.location, value); }
+    void set(Uniform<glm::vec2> uniform, const glm::vec2 &value) const { track(uniform, value); glUniform2fv(uniform.location, 1, &value[0]); }
+    void set(Uniform<glm::vec3> uniform, const glm::vec3 &value) const { track(uniform, value); glUniform3fv(uniform.location, 1, &value[0]); }
+    void set(Uniform<glm::vec4> uniform, const glm::vec4 &value) const { track(uniform, value); glUniform4fv(uniform.location, 1, &value[0]); }
+    void set(Uniform<glm::ivec4> uniform, const glm::ivec4 &value) const { track(uniform, value); glUniform4iv(uniform.location, 1, &value[0]); }
+    void set(Uniform<glm::mat3> uniform, const glm::mat3 &mat) const { track(uniform, mat); glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]); }
+    void set(Uniform<glm::mat4> uniform, const glm::mat4 &mat) const { track(uniform, mat); glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]); }
+    // count elements of an array from the handle of its first one
+    void set(Uniform<glm::mat4> uniform, const glm::mat4 *mats, unsigned int count) const
+    {
+        if (uniformStats().enabled)
+            uniformStats().Record(ID, fragmentPath, uniform.location, handleName(uniform), mats, count * sizeof(glm::mat4));
+        glUniformMatrix4fv(uniform.location, count, GL_FALSE, &mats[0][0][0]);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        GLint location = Location(name);
+        track(location, name, (int)value);
+        glUniform1i(location, (int)value); 
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        GLint location = Location(name);
+        track(location, name, value);
+        glUniform1i(location, value); 
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        GLint location = Location(name);
+        track(location, name, value);
+        glUniform1f(location, value); 
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        GLint location = Location(name);
+        track(location, name, value);
+        glUniform2fv(location, 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        setVec2(name, glm::vec2(x, y)); 
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        GLint location = Location(name);
+        track(location, name, value);
+        glUniform3fv(location, 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        setVec3(name, glm::vec3(x, y, z)); 
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        GLint location = Location(name);
+        track(location, name, value);
+        glUniform4fv(location, 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        setVec4(name, glm::vec4(x, y, z, w)); 
+    }
+    // ------------------------------------------------------------------------
+    void setIVec4(const std::string &name, const glm::ivec4 &value) const
+    {
+        GLint location = Location(name);
+        track(location, name, value);
+        glUniform4iv(location, 1, &value[0]);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        GLint location = Location(name);
+        track(location, name, mat);
+        glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        GLint location = Location(name);
+        track(location, name, mat);
+        glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        GLint location = Location(name);
+        track(location, name, mat);
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    // filled in by finish, which const accessors may trigger
+    mutable std::unordered_map<std::string, GLint> uniforms;
+    // names of the handles given out by Get, active or not, kept for as long as the
+    // Shader (handles point at them)
+    mutable std::unordered_set<std::string> handleNames;
+    mutable unsigned int serial = 0;
+    mutable bool failed = false; // the program in ID did not link
+    std::string vertexPath, fragmentPath, geometryPath, defines;
+    std::vector<std::string> dependencies;
+
+    // instrumentation (see UniformStats), a single flag test when it is off
+    template <typename T>
+    void track(GLint location, const std::string &name, const T &value) const
+    {
+        if (uniformStats().enabled)
+            uniformStats().Record(ID, fragmentPath, location, name, &value, sizeof(value));
+    }
+    template <typename T, typename U>
+    void track(const Uniform<U> &uniform, const T &value) const
+    {
+        if (uniformStats().enabled)
+            uniformStats().Record(ID, fragmentPath, uniform.location, handleName(uniform), &value, sizeof(value));
+    }
+
+    // default constructed handles were never resolved
+    template <typename U>
+    static std::string handleName(const Uniform<U> &uniform)
+    {
+        return uniform.name ? *uniform.name : "(unresolved handle)";
+    }
+
+    // a program on its way through the driver, with the stages to check and release
+    struct Build
+    {
+        unsigned int program = 0;
+        unsigned int vertex = 0, fragment = 0, geometry = 0;
+        uint64_t key = 0;
+        bool linking = false; // submitted, results not collected yet
+    };
+    mutable Build build;      // the program in ID until it is first needed
+    Build reload;             // its replacement, while a hot reload compiles
+
+    // Read and preprocess the sources, then link the program from the binary cache or
+    // submit its compilation; false when a source file is missing
+    bool submit(Build& b)
+    {
+        std::string vertexCode, fragmentCode, geometryCode;
+        std::vector<std::string> vertexFiles, fragmentFiles, geometryFiles;
+        bool read = preprocess(vertexPath, vertexCode, vertexFiles) & preprocess(fragmentPath, fragmentCode, fragmentFiles);
+        if (!geometryPath.empty())
+            read &= preprocess(geometryPath, geometryCode, geometryFiles);
+        dependencies.clear();
+        for (const std::vector<std::string>* stage : { &vertexFiles, &fragmentFiles, &geometryFiles })
+            for (const std::string& file : *stage)
+                if (std::find(dependencies.begin(), dependencies.end(), file) == dependencies.end())
+                {
+                    dependencies.push_back(file);
+                    fileWatcher().Watch(file);
+                }
+        vertexCode = injectDefines(vertexCode, defines);
+        fragmentCode = injectDefines(fragmentCode, defines);
+        geometryCode = injectDefines(geometryCode, defines);
+        // a binary linked by an earlier run skips compiling altogether (see ProgramCache)
+        b.key = programCache().Key(vertexCode, fragmentCode, geometryCode, defines);
+        b.program = glCreateProgram();
+        if (programCache().Load(b.program, b.key))
+            return true;
+        const char* vShaderCode = vertexCode.c_str();
+        const char * fShaderCode = fragmentCode.c_str();
+        // compile and link without asking how it went: the driver builds the program in
+        // the background (KHR_parallel_shader_compile), the results are collected when
+        // the program is first needed (see Ready and finish)
+        b.vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(b.vertex, 1, &vShaderCode, NULL);
+        glCompileShader(b.vertex);
+        b.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(b.fragment, 1, &fShaderCode, NULL);
+        glCompileShader(b.fragment);
+        if (!geometryPath.empty())
+        {
+            const char * gShaderCode = geometryCode.c_str();
+            b.geometry = glCreateShader(GL_GEOMETRY_SHADER);
+            glShaderSource(b.geometry, 1, &gShaderCode, NULL);
+            glCompileShader(b.geometry);
+        }
+        glAttachShader(b.program, b.vertex);
+        glAttachShader(b.program, b.fragment);
+        if (b.geometry)
+            glAttachShader(b.program, b.geometry);
+        programCache().PrepareLink(b.program);
+        glLinkProgram(b.program);
+        b.linking = true;
+        return read;
+    }
+
+    // whether the driver is done with b, when it can tell without waiting
+    static bool linked(const Build& b)
+    {
+        if (!b.linking || !glExtensionFunctions().parallelShaderCompile)
+            return true;
+        GLint done = GL_FALSE;
+        glGetProgramiv(b.program, GL_COMPLETION_STATUS_KHR, &done);
+        return done;
+    }
+
+    // Wait for b if the driver is still on it, report compile and link errors and
+    // cache the program when it linked
+    static bool collect(Build& b)
+    {
+        if (!b.linking)
+            return b.program != 0;
+        b.linking = false;
+        checkCompileErrors(b.vertex, "VERTEX");
+        checkCompileErrors(b.fragment, "FRAGMENT");
+        if (b.geometry)
+            checkCompileErrors(b.geometry, "GEOMETRY");
+        bool ok = checkCompileErrors(b.program, "PROGRAM");
+        if (ok)
+            programCache().Store(b.program, b.key);
+        // delete the shaders as they're linked into our program now and no longer necessery
+        glDeleteShader(b.vertex);
+        glDeleteShader(b.fragment);
+        if (b.geometry)
+            glDeleteShader(b.geometry);
+        b.vertex = b.fragment = b.geometry = 0;
+        return ok;
+    }
+
+    static void discard(Build& b)
+    {
+        if (!b.program)
+            return;
+        collect(b);
+        glState().ForgetProgram(b.program);
+        glDeleteProgram(b.program);
+        b = Build();
+    }
+
+    // the program in ID, collected and reflected
+    void finish() const
+    {
+        if (!build.linking)
+            return;
+        failed = !collect(build);
+        reflectUniforms();
+    }
+
+    // Swap the reloaded program in once linked: uniforms are reflected again (a new
+    // serial drops the handles cached on the old one) and the old program is released
+    void swapReloaded()
+    {
+        if (!reload.program || !linked(reload))
+            return;
+        if (!collect(reload))
+        {
+            std::cout << "Keeping the previous " << fragmentPath << std::endl;
+            discard(reload);
+            return;
+        }
+        unsigned int previous = ID;
+        ID = reload.program;
+        reload = Build();
+        failed = false;
+        resources().Add(RESOURCE_PROGRAM, ID, 0, fragmentPath);
+        resources().Release(RESOURCE_PROGRAM, previous);
+        reflectUniforms();
+        if (onReload)
+        {
+            glState().UseProgram(ID);
+            onReload(*this);
+        }
+    }
+
+    // Source of a stage with its #include "file" lines replaced by the file (relative to
+    // the including one, each file once per stage); #line directives keep compiler
+    // messages pointing at the right line, the string number is the index in files
+    static bool preprocess(const std::string& path, std::string& code, std::vector<std::string>& files)
+    {
+        std::string file = normalizePath(path);
+        if (std::find(files.begin(), files.end(), file) != files.end())
+            return true;
+        files.push_back(file);
+        unsigned int index = files.size() - 1;
+
+        std::ifstream in(file);
+        if (!in)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << file << std::endl;
+            return false;
+        }
+        bool ok = true;
+        std::string line;
+        for (unsigned int number = 1; std::getline(in, line); number++)
+        {
+            size_t hash = line.find_first_not_of(" \t");
+            if (hash == std::string::npos || line.compare(hash, 8, "#include") != 0)
+            {
+                code += line + "\n";
+                continue;
+            }
+            size_t open = line.find('"', hash), close = line.find('"', open + 1);
+            if (open == std::string::npos || close == std::string::npos)
+            {
+                std::cout << "ERROR::SHADER::BAD_INCLUDE " << file << ":" << number << std::endl;
+                ok = false;
+                continue;
+            }
+            size_t slash = file.find_last_of('/');
+            std::string dir = slash == std::string::npos ? "" : file.substr(0, slash + 1);
+            code += "#line 1 " + std::to_string(files.size()) + "\n";
+            ok &= preprocess(dir + line.substr(open + 1, close - open - 1), code, files);
+            code += "#line " + std::to_string(number + 1) + " " + std::to_string(index) + "\n";
+        }
+        return ok;
+    }
+
+    // "a/b/../c" as "a/c", so every spelling of a file is watched and matched as one
+    static std::string normalizePath(const std::string& path)
+    {
+        std::vector<std::string> parts;
+        size_t start = 0;
+        while (start <= path.size())
+        {
+            size_t slash = path.find('/', start);
+            if (slash == std::string::npos)
+                slash = path.size();
+            std::string part = path.substr(start, slash - start);
+            if (part == ".." && !parts.empty() && parts.back() != "..")
+                parts.pop_back();
+            else if (!part.empty() && part != ".")
+                parts.push_back(part);
+            start = slash + 1;
+        }
+        std::string normalized = path.compare(0, 1, "/") == 0 ? "/" : "";
+        for (size_t i = 0; i < parts.size(); i++)
+            normalized += (i ? "/" : "") + parts[i];
+        return normalized;
+    }
+
+    // Permutation defines go right after the #version line, which has to come first
+    static std::string injectDefines(const std::string& code, const std::string& defines)
+    {
+        if (defines.empty() || code.compare(0, 8, "#version") != 0)
+            return code;
+        size_t eol = code.find('\n');
+        if (eol == std::string::npos)
+            return code + "\n" + defines;
+        return code.substr(0, eol + 1) + defines + "#line 2 0\n" + code.substr(eol + 1);
+    }
+
+    // every active uniform by name, after linking, and the binding points of the
+    // uniform blocks; arrays of basic types are listed
+    // once by the driver ("lights[0]", size n), their elements are added one by one and
+    // the bare name stands for the first
+    // ------------------------------------------------------------------------
+    void reflectUniforms() const
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        static unsigned int linked = 0;
+        serial = ++linked;
+        uniforms.clear();
+        std::string name(maxLength, '\0');
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, i, maxLength, &length, &size, &type, &name[0]);
+            std::string uniform = name.substr(0, length);
+            GLint location = glGetUniformLocation(ID, uniform.c_str());
+            if (location < 0)
+                continue; // in a uniform block
+            uniforms[uniform] = location;
+
+            size_t bracket = uniform.size() > 3 ? uniform.rfind("[0]") : std::string::npos;
+            if (bracket == std::string::npos || bracket + 3 != uniform.size())
+                continue;
+            std::string base = uniform.substr(0, bracket);
+            uniforms[base] = location;
+            for (GLint e = 1; e < size; e++)
+            {
+                std::string element = base + "[" + std::to_string(e) + "]";
+                uniforms[element] = glGetUniformLocation(ID, element.c_str());
+            }
+        }
+
+        // shared uniform blocks get their fixed binding points (see UniformBlocks.h)
+        GLint blocks = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+        for (GLint i = 0; i < blocks; i++)
+        {
+            char blockName[64];
+            glGetActiveUniformBlockName(ID, i, sizeof(blockName), NULL, blockName);
+            GLint binding = uniformBlockBinding(blockName);
+            if (binding >= 0)
+                glUniformBlockBinding(ID, i, binding);
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    static bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -188,6 +586,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success;
     }
 };
 #endif
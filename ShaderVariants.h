@@ -0,0 +1,182 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <string>
+#include <iostream>
+#include <unordered_map>
+#include <functional>
+
+#include "Shader.h"
+
+// What a draw needs from the ubershader: material features from the mesh, scene
+// features from the scene (or'ed in by ShaderVariants)
+enum ShaderFeature
+{
+  FEATURE_NORMAL_MAP      = 1 << 0,
+  FEATURE_SPECULAR_MAP    = 1 << 1,
+  FEATURE_MASK_MAP        = 1 << 2,
+  FEATURE_ALPHA_MASK      = 1 << 3, // diffuse alpha holds the mask (see ChannelPack.h)
+  FEATURE_ALPHA_SPECULAR  = 1 << 4, // diffuse alpha holds the specular intensity
+  FEATURE_VIRTUAL_TEXTURE = 1 << 5,
+  FEATURE_SHADOWS         = 1 << 6,
+  FEATURE_SOFT_SHADOWS    = 1 << 7
+};
+
+// Defines selecting a permutation, see FEATURE() in ubershader.fs
+static std::string shaderFeatureDefines(unsigned int features)
+{
+  auto flag = [features](const char* name, unsigned int bit) {
+    return std::string("#define ") + name + ((features & bit) ? " true\n" : " false\n");
+  };
+  int alpha = (features & FEATURE_ALPHA_MASK) ? 1 : (features & FEATURE_ALPHA_SPECULAR) ? 2 : 0;
+  return "#define PERMUTATION\n"
+    + flag("HAS_NORMAL_MAP", FEATURE_NORMAL_MAP)
+    + flag("HAS_SPECULAR_MAP", FEATURE_SPECULAR_MAP)
+    + flag("HAS_MASK_MAP", FEATURE_MASK_MAP)
+    + flag("HAS_VIRTUAL_TEXTURE", FEATURE_VIRTUAL_TEXTURE)
+    + flag("HAS_SHADOWS", FEATURE_SHADOWS)
+    + flag("SOFT_SHADOWS", FEATURE_SOFT_SHADOWS)
+    + "#define DIFFUSE_ALPHA " + std::to_string(alpha) + "\n";
+}
+
+// Compile time permutations of a shader whose feature switches are uniforms (the base,
+// with dynamic branches). Once attached, Mesh::Draw picks the variant for its features
+// through Shader::Variant; variants are compiled on first use with their features
+// #defined and cached by feature key. Without enabled every mesh draws with the base.
+//
+// Variants compile in the background (see Shader::Ready): until one is linked its
+// meshes draw with the base, which always works, so new permutations never stall a
+// frame. They hot reload with their sources like any Shader.
+class ShaderVariants
+{
+  public:
+    bool enabled = true;
+    unsigned int sceneFeatures = 0; // or'ed into every mesh's features
+
+    // onLink runs once for every new variant (sampler units and the like)
+    ShaderVariants(Shader& base, const char* vertexPath, const char* fragmentPath, std::function<void(Shader&)> onLink = nullptr)
+      : base(&base), vertexPath(vertexPath), fragmentPath(fragmentPath), onLink(onLink)
+    {
+      base.selectVariant = [this](unsigned int features) -> const Shader& { return Select(features); };
+    }
+
+    ~ShaderVariants()
+    {
+      base->selectVariant = nullptr;
+      for (auto& v : variants)
+        delete v.second.shader;
+    }
+
+    // Submit the program of a feature key to the driver, if not done yet; queue every
+    // permutation a scene needs up front so they compile together
+    void Prepare(unsigned int features)
+    {
+      if (variants.find(features) != variants.end())
+        return;
+      Shader* shader = new Shader(vertexPath.c_str(), fragmentPath.c_str(), nullptr, shaderFeatureDefines(features));
+      variants[features].shader = shader;
+      // a hot reloaded variant needs what a new one gets, and a failed one is usable again
+      shader->onReload = [this, features](Shader& reloaded) {
+        Variant& v = variants[features];
+        v.ready = true;
+        v.failed = false;
+        current = reloaded.ID;
+        if (onLink)
+          onLink(reloaded);
+        if (frameUniforms)
+          frameUniforms(reloaded);
+      };
+    }
+
+    // Program of a feature key once it is linked, null while the driver is compiling it
+    // and when it failed to compile or link (the base draws its meshes instead)
+    Shader* Get(unsigned int features)
+    {
+      auto it = variants.find(features);
+      if (it == variants.end())
+      {
+        Prepare(features);
+        it = variants.find(features);
+      }
+      Variant& v = it->second;
+      if (v.failed)
+        return nullptr;
+      if (!v.ready)
+      {
+        if (!v.shader->Ready())
+        {
+          if (v.shader->Failed())
+          {
+            v.failed = true;
+            std::cout << "Permutation " << features << " of " << fragmentPath << " failed, drawing with the base" << std::endl;
+          }
+          return nullptr;
+        }
+        v.ready = true;
+        v.shader->use();
+        current = v.shader->ID;
+        if (onLink)
+          onLink(*v.shader);
+        if (frameUniforms)
+          frameUniforms(*v.shader);
+      }
+      return v.shader;
+    }
+
+    // Per frame uniforms: fn runs on the base and every linked variant now, and on
+    // variants linked until the next call. Call before drawing, it leaves the base in use.
+    void ForEach(const std::function<void(Shader&)>& fn)
+    {
+      frameUniforms = fn;
+      for (auto& v : variants)
+      {
+        if (!v.second.ready)
+          continue;
+        v.second.shader->use();
+        fn(*v.second.shader);
+      }
+      base->use();
+      fn(*base);
+      current = base->ID;
+    }
+
+    // Put the program for a mesh in use, the base while its variant compiles
+    const Shader& Select(unsigned int meshFeatures)
+    {
+      Shader* shader = enabled ? Get(meshFeatures | sceneFeatures) : base;
+      if (!shader)
+        shader = base;
+      if (shader->ID != current)
+      {
+        shader->use();
+        current = shader->ID;
+      }
+      return *shader;
+    }
+
+    unsigned int Count() const { return variants.size(); }
+
+    unsigned int Compiling() const
+    {
+      unsigned int n = 0;
+      for (auto& v : variants)
+        n += !v.second.ready && !v.second.failed;
+      return n;
+    }
+
+  private:
+    struct Variant
+    {
+      Shader* shader = nullptr;
+      bool ready = false;  // linked, onLink and the frame uniforms applied
+      bool failed = false; // did not link, the base stands in for it
+    };
+
+    Shader* base;
+    std::string vertexPath, fragmentPath;
+    std::function<void(Shader&)> onLink, frameUniforms;
+    std::unordered_map<unsigned int, Variant> variants;
+    unsigned int current = 0;
+};
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef SHADOW_MAP_H
 #define SHADOW_MAP_H
 
+#include "GLState.h"
 #include "Shader.h"
 #include "Model.h"
 
@@ -32,7 +33,7 @@ class ShadowMap
       glGenFramebuffers(1, &depthMapFBO);
       // create depth cubemap texture
       glGenTextures(1, &depthCubemap);
-      glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
+      glState().BindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
       for (unsigned int i = 0; i < 6; ++i)
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
 
@@ -43,7 +44,7 @@ class ShadowMap
       glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
       // attach depth texture as FBO's depth buffer
-      glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+      glState().BindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
       glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubemap, 0);
       glDrawBuffer(GL_NONE);
       glReadBuffer(GL_NONE);
@@ -51,7 +52,14 @@ class ShadowMap
       if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
 
-      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+      // Last, the program had the framebuffer setup to compile in; again after reloads
+      shadowDepthShader->onReload = [this](Shader& s) {
+        shadowMatrices = s.Get<glm::mat4>("shadowMatrices");
+        modelUniform = s.Get<glm::mat4>("model");
+      };
+      shadowDepthShader->onReload(*shadowDepthShader);
     }
 
     void ComputeShadowMap(Model& model, glm::mat4 modelMatrix, glm::vec3 lightPos)
@@ -62,34 +70,35 @@ class ShadowMap
       // 0. create depth cubemap transformation matrices
       // -----------------------------------------------
       glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), (float)SHADOW_WIDTH / (float)SHADOW_HEIGHT, near_plane, far_plane);
-      std::vector<glm::mat4> shadowTransforms;
-      shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-      shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-      shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
-      shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)));
-      shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-      shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
+      glm::mat4 shadowTransforms[6] = {
+        shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+        shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+        shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
+        shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)),
+        shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+        shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f))
+      };
 
       // 1. render scene to depth cubemap
       // --------------------------------
-      glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-      glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+      glState().Viewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+      glState().BindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
       glClear(GL_DEPTH_BUFFER_BIT);
       shadowDepthShader->use();
-      for (unsigned int i = 0; i < 6; ++i)
-        shadowDepthShader->setMat4("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
-      shadowDepthShader->setMat4("model", modelMatrix);
-      shadowDepthShader->setFloat("far_plane", far_plane);
-      shadowDepthShader->setVec3("lightPos", lightPos);
-      model.Draw(*shadowDepthShader);
-      glBindFramebuffer(GL_FRAMEBUFFER, 0);
-      glViewport(0, 0, windowWidth, windowHeight);
+      shadowDepthShader->set(shadowMatrices, shadowTransforms, 6);
+      shadowDepthShader->set(modelUniform, modelMatrix);
+      uniformBlocks().SetLightPosition(lightPos, far_plane);
+      // Depth only, the whole model in one call
+      queue.Begin(lightPos, modelMatrix, far_plane);
+      model.Submit(queue);
+      queue.ExecuteGeometry();
+      glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
+      glState().Viewport(0, 0, windowWidth, windowHeight);
     }
 
     void Bind()
     {
-      glActiveTexture(GL_TEXTURE4);
-      glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
+      glState().BindTexture(4, GL_TEXTURE_CUBE_MAP, depthCubemap);
     }
 
   private:
@@ -97,6 +106,8 @@ class ShadowMap
 
     Shader* shadowDepthShader;
     Shader* debugShadowMapShader;
+    Uniform<glm::mat4> shadowMatrices, modelUniform;
+    RenderQueue queue;
 
     unsigned int depthMapFBO;
     unsigned int depthCubemap;
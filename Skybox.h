@@ -3,6 +3,9 @@
 
 #include <vector>
 #include <iostream>
+#include <memory>
+#include <future>
+#include <chrono>
 
 #include <glad/glad.h>
 
@@ -11,7 +14,13 @@
 #include "dep/glm/gtc/type_ptr.hpp"
 #include "dep/stb_image/stb_image.h"
 
+#include "GLState.h"
 #include "Shader.h"
+#include "DDS.h"
+#include "MipChain.h"
+#include "ThreadPool.h"
+#include "CubemapFaces.h"
+#include "ResourceManager.h"
 
 class Skybox
 {
@@ -63,45 +72,45 @@ class Skybox
         1.0f, -1.0f,  1.0f
       };
 
-      // Create cubemap
-      std::vector<std::string> faces =
-      {
-        "res/skyboxes/hw_sahara/sahara_ft.tga",
-        "res/skyboxes/hw_sahara/sahara_bk.tga",
-        "res/skyboxes/hw_sahara/sahara_up.tga",
-        "res/skyboxes/hw_sahara/sahara_dn.tga",
-        "res/skyboxes/hw_sahara/sahara_rt.tga",
-        "res/skyboxes/hw_sahara/sahara_lf.tga",
-      };
-      cubeTex = loadCubemap(faces);  
+      // Create cubemap, shared by every skybox of the same faces
+      cubeTex = loadCubemap("res/skyboxes/hw_sahara/sahara");
 
       // Skybox VAO
       glGenVertexArrays(1, &skyboxVAO);
       glGenBuffers(1, &skyboxVBO);
-      glBindVertexArray(skyboxVAO);
+      glState().BindVertexArray(skyboxVAO);
       glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
       glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
       glEnableVertexAttribArray(0);
       glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+      resources().Add(RESOURCE_BUFFER, skyboxVBO, sizeof(skyboxVertices), "skybox vertices");
 
       // Create shader
       skyboxShader = new Shader("res/shaders/cubemap/cubemap.vs", "res/shaders/cubemap/cubemap.fs");
 
     }
 
+    ~Skybox()
+    {
+      glState().ForgetVertexArray(skyboxVAO);
+      glDeleteVertexArrays(1, &skyboxVAO);
+      resources().Release(RESOURCE_BUFFER, skyboxVBO);
+      resources().Release(RESOURCE_TEXTURE, cubeTex);
+    }
+
     void Draw(glm::mat4& projection, glm::mat4& view) {
-      glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+      glState().DepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
       skyboxShader->use();
       glm::mat3 viewNoTrans = glm::mat4(glm::mat3(view)); // remove translation from the view matrix
       skyboxShader->setMat4("view", viewNoTrans);
       skyboxShader->setMat4("projection", projection);
       // Skybox cube
-      glBindVertexArray(skyboxVAO);
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_CUBE_MAP, cubeTex);
+      glState().BindVertexArray(skyboxVAO);
+      glState().ActiveTexture(GL_TEXTURE0);
+      glState().BindTexture(GL_TEXTURE_CUBE_MAP, cubeTex);
       glDrawArrays(GL_TRIANGLES, 0, 36);
-      glBindVertexArray(0);
-      glDepthFunc(GL_LESS); // set depth function back to default
+      glState().BindVertexArray(0);
+      glState().DepthFunc(GL_LESS); // set depth function back to default
 
     }
 
@@ -114,35 +123,85 @@ class Skybox
     // Cubemap
     unsigned int cubeTex;
 
-    unsigned int loadCubemap(std::vector<std::string> faces)
+    // The cooked base.dds (BC1 with mips, see cookCubemap) when there is one, otherwise
+    // the six base_*.tga faces decoded and mipmapped in parallel on the worker pool; 0
+    // when a face is missing
+    unsigned int loadCubemap(const std::string& base)
     {
+      if (unsigned int cached = resources().Acquire(RESOURCE_TEXTURE, base))
+        return cached;
+
+      auto start = std::chrono::high_resolution_clock::now();
       unsigned int textureID;
       glGenTextures(1, &textureID);
-      glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+      glState().BindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+      glState().Enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
-      int width, height, nrChannels;
-      for (unsigned int i = 0; i < faces.size(); i++)
+      size_t bytes = 0;
+      const char* format = "RGBA8";
+      DDSImage dds;
+      if (preferCompressedTextures && readDDS(base + ".dds", dds) && dds.faces == 6 && ddsSupported(dds))
+      {
+        bytes = uploadDDS(dds, GL_TEXTURE_CUBE_MAP);
+        format = dds.formatName;
+      }
+      else
       {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
+        std::vector<std::string> faces = cubemapFaces(base);
+        std::vector<std::future<std::vector<MipImage>>> decoded;
+        for (const std::string& face : faces)
+          decoded.push_back(workerPool().Submit([face] {
+            std::vector<MipImage> chain;
+            MipImage img;
+            int n;
+            unsigned char* data = stbi_load(face.c_str(), &img.width, &img.height, &n, 4);
+            if (!data)
+              return chain;
+            img.rgba.assign(data, data + img.width * img.height * 4);
+            stbi_image_free(data);
+            buildMipChain(img, MIP_SRGB, chain);
+            return chain;
+          }));
+
+        unsigned int levels = 0;
+        bool complete = true;
+        for (unsigned int i = 0; i < decoded.size(); i++)
         {
-          glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-              0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data
-              );
-          stbi_image_free(data);
+          std::vector<MipImage> chain = decoded[i].get();
+          if (chain.empty())
+          {
+            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+            complete = false;
+            continue;
+          }
+          for (unsigned int l = 0; l < chain.size(); l++)
+          {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, l, GL_RGBA8, chain[l].width, chain[l].height, 0,
+                GL_RGBA, GL_UNSIGNED_BYTE, chain[l].rgba.data());
+            bytes += chain[l].rgba.size();
+          }
+          levels = chain.size();
         }
-        else
+
+        // Not cached, a later skybox tries again
+        if (!complete)
         {
-          std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-          stbi_image_free(data);
+          glState().ForgetTexture(textureID);
+          glDeleteTextures(1, &textureID);
+          return 0;
         }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels ? levels - 1 : 0);
       }
-      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
       glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
       glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
       glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
       glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
+      resources().Add(RESOURCE_TEXTURE, textureID, bytes, base, true);
+      std::cout << "Skybox " << base << ": " << format << ", " << bytes / 1024 << " KB in "
+        << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
       return textureID;
     }
 };
@@ -4,6 +4,14 @@
 #include "Scene.h"
 #include "Model.h"
 #include "Skybox.h"
+#include "StreamedModel.h"
+#include "HLOD.h"
+#include "ShaderVariants.h"
+#include "GpuTimer.h"
+
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
 
 class SponzaScene : public Scene
 {
@@ -11,9 +19,30 @@ class SponzaScene : public Scene
     SponzaScene(GLFWwindow* window, unsigned int width, unsigned int height)
       : Scene(window, width, height)
     {
-      sponza = new Model("res/models/sponza/sponza.obj");
       model = glm::mat4();
       model = glm::scale(model, glm::vec3(0.05f));
+
+      // Diffuse maps are paged in from the virtual texture when it has been cooked
+      // (cooker --vt), meshes look their region up as they are created
+      if (virtualTexture().Open("res/models/sponza/sponza.vt"))
+        feedbackShader = new Shader("res/shaders/ubershader.vs", "res/shaders/vt/feedback.fs");
+
+      // Stream the chunked version when it has been cooked (cooker --chunk)
+      if (std::ifstream("res/models/sponza/sponza.chunks").good())
+      {
+        streamed = new StreamedModel("res/models/sponza/sponza.chunks");
+        streamed->SetModelMatrix(model);
+        sponza = streamed;
+      }
+      else
+        sponza = new Model("res/models/sponza/sponza.obj");
+
+      // Far clusters switch to merged proxies (cooker --hlod)
+      if (!streamed && std::ifstream("res/models/sponza/sponza.hlod").good())
+      {
+        hlod = new HLOD("res/models/sponza/sponza.hlod", *sponza);
+        proxyShader = new Shader("res/shaders/hlod/proxy.vs", "res/shaders/hlod/proxy.fs");
+      }
       //sponza = new Model("res/models/crypt/crypt.obj");
       skybox = new Skybox();
 
@@ -24,27 +53,75 @@ class SponzaScene : public Scene
       m_LightPos = glm::vec3(30.0f, 35.0f, 0.0f);
 
       m_ShadowMap->ComputeShadowMap(*sponza, model, m_LightPos);
+
+      CreateVariants();
     }
 
     void Draw()
     {
       Scene::Draw();
       //m_LightPos = camera.Position;
+
+      // The shadow cubemap is baked from resident cells only, again as they change (at
+      // most every few frames while streaming)
+      if (streamed)
+        shadowsStale |= streamed->Update(camera.Position) > 0;
+      framesSinceShadows++;
+      if (shadowsStale && framesSinceShadows >= SHADOW_REBAKE_FRAMES)
+      {
+        m_ShadowMap->ComputeShadowMap(*sponza, model, m_LightPos);
+        shadowsStale = false;
+        framesSinceShadows = 0;
+      }
+
+      // Textures arrive over the first frames (see TextureLoader)
+      if (!texturesReported && textureLoader().Pending() == 0)
+      {
+        printTextureReport();
+        texturesReported = true;
+      }
       
-      m_UberShader->use();
-      // set lighting uniforms
-      m_UberShader->setFloat("far_plane", m_ShadowMap->far_plane);
       m_ShadowMap->Bind();
 
       if (!debugShadows)
       {
+        // Near clusters or the whole model, sorted once for the feedback and main passes
+        bool clusters = hlod && hlodEnabled;
+        if (clusters)
+          hlod->Update(camera.Position, model);
+        m_RenderQueue.Begin(camera.Position, model);
+        if (clusters)
+          hlod->Submit(m_RenderQueue);
+        else
+          sponza->Submit(m_RenderQueue);
+
+        if (feedbackShader)
+          DrawFeedback();
+
         SetShaderParams(shaderParams);
-        m_UberShader->setMat4("model", model);
-        m_UberShader->setBool("hasShadows", shadowsEnabled);
-        m_UberShader->setFloat("bias", bias);
-        m_UberShader->setFloat("time", glfwGetTime());
+        uberVariants->sceneFeatures = shadowsEnabled ? (m_SoftShadows ? FEATURE_SHADOWS | FEATURE_SOFT_SHADOWS : FEATURE_SHADOWS) : 0;
+        uberVariants->ForEach([this](Shader& shader) {
+          if (feedbackShader)
+            virtualTexture().Bind(shader);
+          const FrameUniforms& u = frameUniforms(shader);
+          shader.set(u.model, model);
+          if (u.shadowSwitches)
+          {
+            shader.set(u.softShadows, m_SoftShadows);
+            shader.set(u.hasShadows, shadowsEnabled);
+          }
+          shader.set(u.bias, bias);
+          shader.set(u.time, (float)glfwGetTime());
+        });
+        textureStreamer().SetModelMatrix(model);
 
-        sponza->Draw(*m_UberShader);
+        // Timed apart for dynamic branches and permutations
+        GpuTimer& timer = mainPassTimers[uberVariants->enabled];
+        timer.Begin();
+        m_RenderQueue.Execute(*m_UberShader);
+        timer.End();
+        if (clusters)
+          DrawProxies();
         skybox->Draw(m_Projection, m_View);
       }
 
@@ -53,14 +130,102 @@ class SponzaScene : public Scene
 
   private:
     Model* sponza;
+    StreamedModel* streamed = nullptr;
+    HLOD* hlod = nullptr;
+    Shader* proxyShader = nullptr;
+    Shader* feedbackShader = nullptr;
+    ShaderVariants* uberVariants = nullptr;
+    GpuTimer mainPassTimers[2]; // dynamic branches, permutations
+    bool hlodEnabled = true;
     Skybox* skybox;
     ShaderParams shaderParams;
     bool shadowsEnabled = true;
     bool debugShadows = false;
+    bool texturesReported = false;
     glm::mat4 model;
 
     // Shadow map
     float bias = 0.05;
+    static const unsigned int SHADOW_REBAKE_FRAMES = 10;
+    bool shadowsStale = false;
+    unsigned int framesSinceShadows = 0;
+
+    // Per frame uniforms of the ubershader and its permutations, resolved once per
+    // program. Permutations have the shadow switches compiled in (see
+    // shaderFeatureDefines), only the base takes them as uniforms.
+    struct FrameUniforms
+    {
+      Uniform<glm::mat4> model;
+      Uniform<bool> softShadows, hasShadows;
+      Uniform<float> bias, time;
+      bool shadowSwitches = false;
+    };
+    std::unordered_map<unsigned int, FrameUniforms> frameHandles; // by program serial
+
+    const FrameUniforms& frameUniforms(const Shader& shader)
+    {
+      auto it = frameHandles.find(shader.Serial());
+      if (it != frameHandles.end())
+        return it->second;
+
+      FrameUniforms& u = frameHandles[shader.Serial()];
+      u.model = shader.Get<glm::mat4>("model");
+      u.softShadows = shader.Get<bool>("softShadows");
+      u.hasShadows = shader.Get<bool>("hasShadows");
+      u.bias = shader.Get<float>("bias");
+      u.time = shader.Get<float>("time");
+      u.shadowSwitches = u.softShadows.location >= 0 || u.hasShadows.location >= 0;
+      return u;
+    }
+
+    // Ubershader permutations, submitted up front for the materials of the model in every
+    // shadow mode (streamed cells compile theirs as they arrive), meshes draw with the
+    // ubershader until theirs is linked
+    void CreateVariants()
+    {
+      uberVariants = new ShaderVariants(*m_UberShader, "res/shaders/ubershader.vs", "res/shaders/ubershader.fs", SetSamplerUnits);
+
+      std::vector<unsigned int> features;
+      for (const Mesh& mesh : sponza->Meshes())
+        if (std::find(features.begin(), features.end(), mesh.Features()) == features.end())
+          features.push_back(mesh.Features());
+      for (unsigned int f : features)
+        for (unsigned int shadows : { 0u, (unsigned int)FEATURE_SHADOWS, (unsigned int)(FEATURE_SHADOWS | FEATURE_SOFT_SHADOWS) })
+          uberVariants->Prepare(f | shadows);
+      std::cout << "Compiling " << uberVariants->Count() << " ubershader permutations for "
+        << features.size() << " material feature sets" << std::endl;
+    }
+
+    void DrawProxies()
+    {
+      proxyShader->use();
+      proxyShader->setMat4("projection", m_Projection);
+      proxyShader->setMat4("view", m_View);
+      proxyShader->setMat4("model", model);
+      proxyShader->setVec3("light.position", m_LightPos);
+      proxyShader->setVec3("light.ambient", glm::vec3(shaderParams.la));
+      proxyShader->setVec3("light.diffuse", glm::vec3(shaderParams.ld));
+      hlod->DrawProxies(*proxyShader);
+    }
+
+    // Pages and mips the view needs, read back by VirtualTexture a few frames later
+    void DrawFeedback()
+    {
+      VirtualTexture& vt = virtualTexture();
+      vt.BeginFeedback(s_WindowWidth, s_WindowHeight);
+
+      feedbackShader->use();
+      feedbackShader->setMat4("model", model);
+      feedbackShader->setInt("diffuseMap", 0);
+      feedbackShader->setInt("maskMap", 3);
+      feedbackShader->setInt("materialTable", MATERIAL_TABLE_UNIT);
+      feedbackShader->setFloat("vtMipBias", vt.FeedbackMipBias());
+      vt.Bind(*feedbackShader);
+
+      m_RenderQueue.Execute(*feedbackShader);
+
+      vt.EndFeedback(s_WindowWidth, s_WindowHeight);
+    }
 
     // Imgui
     void DrawGUI()
@@ -79,9 +244,21 @@ class SponzaScene : public Scene
       if (ImGui::Button("Debug Shadows"))
         debugShadows = !debugShadows;
 
-      if (ImGui::Button("Compile Shader"))
+      // Shaders also reload on their own when a source file is saved
+      if (ImGui::Button("Reload Shaders"))
+        Shader::ReloadAll();
+
+      if (ImGui::Button("Texture Report"))
+        printTextureReport();
+
+      // Counts every uniform set, wasted ones printed with the report
+      if (ImGui::Checkbox("Uniform Instrumentation", &uniformStats().enabled))
+        uniformStats().Reset();
+      if (uniformStats().enabled)
       {
-        m_UberShader = new Shader("res/shaders/ubershader.vs", "res/shaders/ubershader.fs");
+        ImGui::SameLine();
+        if (ImGui::Button("Uniform Report"))
+          uniformStats().Print();
       }
 
       if (ImGui::Button("Toggle Shadows"))
@@ -99,11 +276,72 @@ class SponzaScene : public Scene
       ImGui::Text("Light Pos = %.3f %.3f %.3f", m_LightPos.x, m_LightPos.y, m_LightPos.z);
       ImGui::Text("Camera Pos = %.3f %.3f %.3f", camera.Position.x, camera.Position.y, camera.Position.z);
 
+      if (hlod)
+      {
+        if (ImGui::Button("Toggle HLOD"))
+          hlodEnabled = !hlodEnabled;
+        ImGui::SliderFloat("HLOD Distance", &hlod->switchDistance, 0.0f, 200.0f);
+        if (hlodEnabled)
+          ImGui::Text("HLOD: %u/%u proxies, %u draws, %u triangles", hlod->proxies, hlod->ClusterCount(), hlod->drawCalls, hlod->triangles);
+      }
+
+      if (streamed)
+        ImGui::Text("Streaming: %u/%u cells, %.1f MB, %u loading", streamed->ResidentCells(), streamed->CellCount(),
+            streamed->ResidentBytes() / (1024.0f * 1024.0f), streamed->InFlight());
+
+      if (textureLoader().Pending())
+        ImGui::Text("Textures: %u loading, %.1f MB uploaded last frame", textureLoader().Pending(),
+            uploadRing().UploadedLastFrame() / (1024.0f * 1024.0f));
+
+      ImGui::Text("Texture arrays: %u arrays, %u layers, %u binds last frame", textureArrays().Count(),
+          textureArrays().Layers(), textureArrays().BindsLastFrame());
+
+      if (feedbackShader)
+        ImGui::Text("Virtual texture: %u/%u pages resident, %u missing, %u loading, %u requests",
+            virtualTexture().ResidentPages(), virtualTexture().Capacity(), virtualTexture().Missing(),
+            virtualTexture().InFlight(), virtualTexture().Requests());
+
+      TextureStreamer& ts = textureStreamer();
+      if (ts.Count())
+      {
+        ImGui::Checkbox("Texture Streaming", &ts.enabled);
+        float budgetMB = ts.budgetBytes / (1024.0f * 1024.0f);
+        if (ImGui::SliderFloat("Texture Budget (MB)", &budgetMB, 4.0f, 256.0f))
+          ts.budgetBytes = (size_t)(budgetMB * 1024.0f * 1024.0f);
+        ImGui::SliderFloat("Texture LOD Bias", &ts.lodBias, -2.0f, 4.0f);
+        ImGui::Text("Texture mips: %.1f/%.1f MB resident (%.1f MB wanted), %u loading, %u evictions",
+            ts.ResidentBytes() / (1024.0f * 1024.0f), budgetMB, ts.WantedBytes() / (1024.0f * 1024.0f), ts.InFlight(), ts.Evictions());
+      }
+
+      ImGui::Checkbox("Ubershader Permutations", &uberVariants->enabled);
+      ImGui::Text("Main pass GPU: %.3f ms dynamic branches, %.3f ms permutations (%u, %u compiling)",
+          mainPassTimers[0].Ms(), mainPassTimers[1].Ms(), uberVariants->Count(), uberVariants->Compiling());
+      const ProgramCache::Stats& cache = programCache().GetStats();
+      ImGui::Text("Program binaries: %u loaded, %u compiled, %u rejected by the driver%s",
+          cache.hits, cache.misses + cache.rejected, cache.rejected, programCache().Supported() ? "" : " (unsupported)");
+
+      ImGui::Checkbox("Sort Draws", &m_RenderQueue.enabled);
+      ImGui::SameLine();
+      ImGui::Checkbox("Batch Draws", &m_RenderQueue.batching);
+      ImGui::Text("Render queue: %u draws, %.3f ms sort, %.3f ms submit", m_RenderQueue.Draws(),
+          m_RenderQueue.SortMs(), m_RenderQueue.SubmitMs());
+
+      GeometryArena& arena = meshArena();
+      ImGui::Checkbox("Multi-Draw Indirect", &indirectDraws);
+      ImGui::Text("Geometry arena: %u meshes, %.1f/%.1f MB, %u multi-draws of %u meshes%s", arena.Ranges(),
+          (arena.VertexBytes() + arena.IndexBytes()) / (1024.0f * 1024.0f), arena.CapacityBytes() / (1024.0f * 1024.0f),
+          arena.MultiDrawsLastFrame(), arena.DrawsLastFrame(), glExtensionFunctions().multiDrawElementsIndirect ? "" : " (base vertex)");
+      ImGui::Text("Material table: %u entries%s", materialTable().Count(),
+          arena.MultiDrawIds() ? "" : ", one draw per mesh (no indirect draws with base instance)");
+
       ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 
 
       ImGui::End();
 
+      DrawMemoryPanel();
+      DrawGLStatePanel();
+
       ImGui::Render();
       ImGui_ImplGlfwGL3_RenderDrawData(ImGui::GetDrawData());
     }
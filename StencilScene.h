@@ -1,6 +1,7 @@
 #ifndef STENCIL_SCENE_H
 #define STENCIL_SCENE_H
 
+#include "GLState.h"
 #include "Scene.h"
 #include "Shader.h"
 #include "Model.h"
@@ -18,8 +19,8 @@ class StencilScene : public Scene
       lightPos = glm::vec3(1.2f, 1.0f, 2.0f);
 
       // configure global opengl state
-      glEnable(GL_DEPTH_TEST);
-      glEnable(GL_STENCIL_TEST);
+      glState().Enable(GL_DEPTH_TEST);
+      glState().Enable(GL_STENCIL_TEST);
 
       // build and compile our shader program
       modelShader = new Shader("res/shaders/basic/basic.vs", "res/shaders/basic/basic.fs");
@@ -51,8 +52,7 @@ class StencilScene : public Scene
 
       // also draw the lamp object
       lampShader->use();
-      lampShader->setMat4("projection", projection);
-      lampShader->setMat4("view", view);
+      uniformBlocks().SetCamera(projection, view, camera.Position); // lamp.vs reads the Camera block
       glm::mat4 model = glm::mat4();
       model = glm::translate(model, lightPos);
       model = glm::scale(model, glm::vec3(0.2f)); // a smaller cube
@@ -65,9 +65,9 @@ class StencilScene : public Scene
     void drawWithOutline()
     {
       // Set stencil buffer to draw base model
-      glStencilFunc(GL_ALWAYS, 1, 0xFF);
-      glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-      glStencilMask(0xFF);
+      glState().StencilFunc(GL_ALWAYS, 1, 0xFF);
+      glState().StencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+      glState().StencilMask(0xFF);
 
       // Set shader uniforms
       modelShader->use();
@@ -90,9 +90,9 @@ class StencilScene : public Scene
       character->Draw(*modelShader);
 
       // OUTLINE
-      glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-      glStencilMask(0x00);
-      glDisable(GL_DEPTH_TEST);
+      glState().StencilFunc(GL_NOTEQUAL, 1, 0xFF);
+      glState().StencilMask(0x00);
+      glState().Disable(GL_DEPTH_TEST);
 
       float scale = 1.02f;
       model = glm::mat4();
@@ -107,8 +107,8 @@ class StencilScene : public Scene
 
       outline->Draw(*outlineShader);
 
-      glStencilMask(0xFF);
-      glEnable(GL_DEPTH_TEST);
+      glState().StencilMask(0xFF);
+      glState().Enable(GL_DEPTH_TEST);
 
     }
 
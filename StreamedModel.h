@@ -0,0 +1,216 @@
+#ifndef STREAMED_MODEL_H
+#define STREAMED_MODEL_H
+
+#include <string>
+#include <vector>
+#include <future>
+#include <chrono>
+#include <algorithm>
+
+#include "Model.h"
+#include "ChunkedModel.h"
+#include "ThreadPool.h"
+
+// Out-of-core model: cells of a .chunks file (see cooker --chunk) are read on worker
+// threads as the camera gets close and uploaded on the render thread, a few per frame.
+// When resident geometry exceeds the budget the farthest cells are dropped.
+class StreamedModel : public Model
+{
+  public:
+    float loadDistance = 60.0f;          // cells closer than this are requested
+    float unloadDistance = 80.0f;        // cells farther than this are dropped
+    size_t budgetBytes = 256 << 20;      // resident vertex/index memory
+    unsigned int maxUploadsPerFrame = 2; // keeps frame time steady while streaming
+    unsigned int maxInFlight = 4;
+
+    StreamedModel(const char* chunksPath) : path(chunksPath)
+    {
+      if (!readChunkedModelHeader(path, header))
+        std::cout << "Cannot open chunked model " << path << std::endl;
+      cells.resize(header.cells.size());
+    }
+
+    // Resident cells give back their arena ranges and textures
+    ~StreamedModel()
+    {
+      for (Cell& c : cells)
+        if (c.state == LOADING)
+          c.pending.wait();
+        else if (c.state == RESIDENT)
+          unload(c);
+    }
+
+    // Scale applied when the model is drawn, distances are computed in world space
+    void SetModelMatrix(const glm::mat4& m) { modelMatrix = m; }
+
+    // Call once per frame before drawing; returns how many cells were uploaded or
+    // dropped, the resident geometry changed when it is not 0
+    unsigned int Update(const glm::vec3& cameraPos)
+    {
+      for (unsigned int i = 0; i < cells.size(); i++)
+        cells[i].distance = distanceTo(i, cameraPos);
+
+      // Upload finished reads, nearest first
+      unsigned int uploads = 0;
+      for (unsigned int i : byDistance())
+      {
+        Cell& c = cells[i];
+        if (c.state != LOADING || c.pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+          continue;
+        if (uploads >= maxUploadsPerFrame)
+          break;
+
+        std::vector<MeshData> data = c.pending.get();
+        inFlight--;
+        if (c.distance > unloadDistance)
+        {
+          c.state = UNLOADED;
+          continue;
+        }
+        upload(c, data);
+        uploads++;
+      }
+
+      // Drop cells out of range, then the farthest ones until within budget
+      unsigned int unloads = 0;
+      std::vector<unsigned int> order = byDistance();
+      for (auto it = order.rbegin(); it != order.rend(); it++)
+      {
+        Cell& c = cells[*it];
+        if (c.state == RESIDENT && (c.distance > unloadDistance || residentBytes > budgetBytes))
+        {
+          unload(c);
+          unloads++;
+        }
+      }
+
+      // Request the nearest missing cells that fit in the budget
+      size_t projected = residentBytes;
+      for (unsigned int i : order)
+      {
+        Cell& c = cells[i];
+        if (c.distance > loadDistance || inFlight >= maxInFlight)
+          break;
+        if (c.state != UNLOADED)
+          continue;
+        if (projected + header.cells[i].size > budgetBytes)
+          break;
+        projected += header.cells[i].size;
+        request(i);
+      }
+      return uploads + unloads;
+    }
+
+    void Draw(const Shader& shader)
+    {
+      for (Cell& c : cells)
+        if (c.state == RESIDENT)
+          for (Mesh& m : c.meshes)
+            m.Draw(shader);
+    }
+
+    void Submit(RenderQueue& queue)
+    {
+      for (Cell& c : cells)
+        if (c.state == RESIDENT)
+          for (Mesh& m : c.meshes)
+            queue.Submit(m);
+    }
+
+    unsigned int CellCount() const { return cells.size(); }
+    unsigned int ResidentCells() const { return residentCells; }
+    unsigned int InFlight() const { return inFlight; }
+    size_t ResidentBytes() const { return residentBytes; }
+
+  private:
+    enum CellState
+    {
+      UNLOADED,
+      LOADING,
+      RESIDENT
+    };
+
+    struct Cell
+    {
+      CellState state = UNLOADED;
+      float distance = 0.0f;
+      size_t bytes = 0;
+      std::vector<Mesh> meshes;
+      std::shared_future<std::vector<MeshData>> pending;
+    };
+
+    std::string path;
+    ChunkedModelHeader header;
+    std::vector<Cell> cells;
+    glm::mat4 modelMatrix;
+
+    size_t residentBytes = 0;
+    unsigned int residentCells = 0;
+    unsigned int inFlight = 0;
+
+    float distanceTo(unsigned int i, const glm::vec3& p) const
+    {
+      // Conservative: transform the cell box corners and use the enclosing box
+      glm::vec3 lo(INFINITY), hi(-INFINITY);
+      for (unsigned int k = 0; k < 8; k++)
+      {
+        glm::vec3 c((k & 1) ? header.cells[i].max.x : header.cells[i].min.x,
+                    (k & 2) ? header.cells[i].max.y : header.cells[i].min.y,
+                    (k & 4) ? header.cells[i].max.z : header.cells[i].min.z);
+        glm::vec3 w = glm::vec3(modelMatrix * glm::vec4(c, 1.0f));
+        lo = glm::min(lo, w);
+        hi = glm::max(hi, w);
+      }
+      return glm::length(glm::max(glm::max(lo - p, p - hi), glm::vec3(0.0f)));
+    }
+
+    std::vector<unsigned int> byDistance() const
+    {
+      std::vector<unsigned int> order(cells.size());
+      for (unsigned int i = 0; i < order.size(); i++)
+        order[i] = i;
+      std::sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b) { return cells[a].distance < cells[b].distance; });
+      return order;
+    }
+
+    void request(unsigned int i)
+    {
+      std::string file = path;
+      const ChunkedModelHeader* h = &header;
+      cells[i].state = LOADING;
+      cells[i].pending = workerPool().Submit([file, h, i] {
+        std::vector<MeshData> data;
+        if (!readChunkCell(file, *h, i, data))
+          std::cout << "Cannot read cell " << i << " of " << file << std::endl;
+        return data;
+      }).share();
+      inFlight++;
+    }
+
+    void upload(Cell& c, std::vector<MeshData>& data)
+    {
+      c.bytes = 0;
+      for (MeshData& d : data)
+      {
+        c.bytes += d.vertices.size() * sizeof(Vertex) + d.indices.size() * sizeof(unsigned int);
+        c.meshes.push_back(Mesh(d.vertices, d.indices, d.material));
+        // The GPU copy is all we need, don't keep a second one around
+        std::vector<Vertex>().swap(c.meshes.back().vertices);
+      }
+      textureLoader().LoadArrays();
+      c.state = RESIDENT;
+      residentBytes += c.bytes;
+      residentCells++;
+    }
+
+    void unload(Cell& c)
+    {
+      for (Mesh& m : c.meshes)
+        m.Release();
+      c.meshes.clear();
+      c.state = UNLOADED;
+      residentBytes -= c.bytes;
+      residentCells--;
+    }
+};
+#endif
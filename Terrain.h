@@ -1,16 +1,78 @@
 #ifndef TERRAIN_H
 #define TERRAIN_H
 
+#include "GLState.h"
 #include "Mesh.h"
+#include "ThreadPool.h"
 
 #include <vector>
+#include <future>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Normals of heightmap rows [y0, y1) by central differences, into RGBA8 texels with
+// the normal in rgb and the height byte in alpha. heights are in [-1, 1], scaleX and
+// scaleZ turn a height difference between neighbours into a slope.
+static void bakeTerrainRows(const std::vector<float>& heights, const std::vector<uint8_t>& bytes, int width, int height,
+    float scaleX, float scaleZ, int y0, int y1, uint8_t* out)
+{
+  for (int y = y0; y < y1; y++)
+  {
+    const float* row = &heights[(size_t)y * width];
+    const float* up = &heights[(size_t)std::max(y - 1, 0) * width];
+    const float* down = &heights[(size_t)std::min(y + 1, height - 1) * width];
+    uint8_t* dst = out + (size_t)y * width * 4;
+
+    auto pixel = [&](int x) {
+      float nx = (row[std::max(x - 1, 0)] - row[std::min(x + 1, width - 1)]) * scaleX;
+      float nz = (up[x] - down[x]) * scaleZ;
+      float inv = 1.0f / std::sqrt(nx * nx + 1.0f + nz * nz);
+      dst[x * 4] = (uint8_t)(nx * inv * 127.5f + 127.5f);
+      dst[x * 4 + 1] = (uint8_t)(inv * 127.5f + 127.5f);
+      dst[x * 4 + 2] = (uint8_t)(nz * inv * 127.5f + 127.5f);
+      dst[x * 4 + 3] = bytes[(size_t)y * width + x];
+    };
+
+    int x = 0;
+#ifdef __SSE2__
+    // Interior texels four at a time, the borders clamp
+    pixel(x++);
+    const __m128 sx = _mm_set1_ps(scaleX), sz = _mm_set1_ps(scaleZ), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(127.5f);
+    for (; x + 4 < width; x += 4)
+    {
+      __m128 nx = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row + x - 1), _mm_loadu_ps(row + x + 1)), sx);
+      __m128 nz = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(up + x), _mm_loadu_ps(down + x)), sz);
+      __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(nz, nz)), one)));
+      __m128i r = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(nx, inv), half), half));
+      __m128i g = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(inv, half), half));
+      __m128i b = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(nz, inv), half), half));
+      __m128i a = _mm_setr_epi32(bytes[(size_t)y * width + x], bytes[(size_t)y * width + x + 1],
+          bytes[(size_t)y * width + x + 2], bytes[(size_t)y * width + x + 3]);
+
+      // Interleave into r g b a bytes
+      __m128i rg = _mm_or_si128(r, _mm_slli_epi32(g, 8));
+      __m128i ba = _mm_or_si128(_mm_slli_epi32(b, 16), _mm_slli_epi32(a, 24));
+      _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_or_si128(rg, ba));
+    }
+#endif
+    for (; x < width; x++)
+      pixel(x);
+  }
+}
+
+// Heightmap terrain. Heights and normals are baked into one RGBA8 texture (normal in
+// rgb, height in alpha) when the elevation changes, so the vertex shader makes a
+// single fetch per vertex.
 class Terrain
 {
   public:
     Terrain(const char* heightmapPath, const char* grassPath, const char* snowPath, const char* dirtPath)
     {
-      heightmap = loadTexture(heightmapPath);
       grass = loadTexture(grassPath);
       snow = loadTexture(snowPath);
       dirt = loadTexture(dirtPath);
@@ -18,22 +80,65 @@ class Terrain
       setupMesh();
     }
 
+    ~Terrain()
+    {
+      glState().ForgetVertexArray(VAO);
+      glDeleteVertexArrays(1, &VAO);
+      resources().Release(RESOURCE_BUFFER, VBO);
+      resources().Release(RESOURCE_BUFFER, EBO);
+      for (unsigned int texture : { terrainMap, grass, snow, dirt })
+        resources().Release(RESOURCE_TEXTURE, texture);
+    }
+
+    // Rebake the normals for a new elevation (the vertex shader scales heights by it)
+    void SetElevation(float elevation)
+    {
+      if (elevation == bakedElevation || heights.empty())
+        return;
+      bakedElevation = elevation;
+
+      auto start = std::chrono::high_resolution_clock::now();
+      std::vector<uint8_t> texels((size_t)mapWidth * mapHeight * 4);
+
+      // Bands of rows on the worker pool; slopes are in world units, the terrain
+      // spans [0, 1] on x and z
+      float scaleX = 0.5f * elevation * mapWidth, scaleZ = 0.5f * elevation * mapHeight;
+      int band = std::max(16, mapHeight / 16);
+      std::vector<std::future<void>> bands;
+      for (int y = 0; y < mapHeight; y += band)
+      {
+        int y1 = std::min(y + band, mapHeight);
+        uint8_t* out = texels.data();
+        bands.push_back(workerPool().Submit([this, scaleX, scaleZ, y, y1, out] {
+          bakeTerrainRows(heights, heightBytes, mapWidth, mapHeight, scaleX, scaleZ, y, y1, out);
+        }));
+      }
+      for (auto& f : bands)
+        f.get();
+
+      glState().BindTexture(GL_TEXTURE_2D, terrainMap);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, mapWidth, mapHeight, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+      bakeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    double BakeMs() const { return bakeMs; }
+
     void Draw()
     {
       // Bind textures
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, heightmap);
-      glActiveTexture(GL_TEXTURE1);
-      glBindTexture(GL_TEXTURE_2D, grass);
-      glActiveTexture(GL_TEXTURE2);
-      glBindTexture(GL_TEXTURE_2D, snow);
-      glActiveTexture(GL_TEXTURE3);
-      glBindTexture(GL_TEXTURE_2D, dirt);
+      glState().ActiveTexture(GL_TEXTURE0);
+      glState().BindTexture(GL_TEXTURE_2D, terrainMap);
+      glState().ActiveTexture(GL_TEXTURE1);
+      glState().BindTexture(GL_TEXTURE_2D, grass);
+      glState().ActiveTexture(GL_TEXTURE2);
+      glState().BindTexture(GL_TEXTURE_2D, snow);
+      glState().ActiveTexture(GL_TEXTURE3);
+      glState().BindTexture(GL_TEXTURE_2D, dirt);
 
       // Draw mesh
-      glBindVertexArray(VAO);
+      glState().BindVertexArray(VAO);
       glDrawElements(GL_TRIANGLE_STRIP, indices.size(), GL_UNSIGNED_INT, 0);
-      glBindVertexArray(0); 
+      glState().BindVertexArray(0); 
     }
 
   private:
@@ -42,7 +147,14 @@ class Terrain
     Material material;
 
     unsigned int VAO, VBO, EBO;
-    unsigned int heightmap, grass, snow, dirt;
+    unsigned int terrainMap = 0, grass, snow, dirt;
+
+    // Heightmap on the CPU for baking, in [-1, 1] and as read
+    std::vector<float> heights;
+    std::vector<uint8_t> heightBytes;
+    int mapWidth = 0, mapHeight = 0;
+    float bakedElevation = -1.0f;
+    double bakeMs = 0.0;
 
     void setupMesh()
     {
@@ -51,7 +163,7 @@ class Terrain
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        glState().BindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
@@ -59,6 +171,9 @@ class Terrain
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
+        resources().Add(RESOURCE_BUFFER, VBO, vertices.size() * sizeof(Vertex), "terrain vertices");
+        resources().Add(RESOURCE_BUFFER, EBO, indices.size() * sizeof(unsigned int), "terrain indices");
+
         // set the vertex attribute pointers
         // vertex Positions
         glEnableVertexAttribArray(0);
@@ -76,14 +191,36 @@ class Terrain
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
 
-        glBindVertexArray(0);
+        glState().BindVertexArray(0);
     }
 
     void setupTerrain(const char* heightmapPath)
     {
       // Heightmap data
-      int width, height, nrComponents;
-      unsigned char *data = stbi_load(heightmapPath, &width, &height, &nrComponents, 0);
+      int width = 0, height = 0, nrComponents;
+      unsigned char *data = stbi_load(heightmapPath, &width, &height, &nrComponents, 1);
+      if (data)
+      {
+        heightBytes.assign(data, data + width * height);
+        heights.resize(heightBytes.size());
+        for (size_t i = 0; i < heights.size(); i++)
+          heights[i] = heightBytes[i] / 255.0f * 2.0f - 1.0f;
+        stbi_image_free(data);
+      }
+      else
+        std::cout << "Heightmap failed to load at path: " << heightmapPath << std::endl;
+      mapWidth = width;
+      mapHeight = height;
+
+      // Baked by SetElevation, vertices fetch their texel exactly
+      glGenTextures(1, &terrainMap);
+      glState().BindTexture(GL_TEXTURE_2D, terrainMap);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      resources().Add(RESOURCE_TEXTURE, terrainMap, (size_t)width * height * 4, std::string(heightmapPath) + " (baked)");
 
       vertices = std::vector<Vertex>(width * height);
       for (unsigned int z = 0; z < height; z++)
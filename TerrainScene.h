@@ -1,6 +1,7 @@
 #ifndef TERRAIN_SCENE_H
 #define TERRAIN_SCENE_H
 
+#include "GLState.h"
 #include "Scene.h"
 #include "Mesh.h"
 #include "Model.h"
@@ -25,7 +26,7 @@ class TerrainScene : Scene
       // Generate skybox
       skybox = new Skybox();
 
-      glEnable(GL_DEPTH_TEST);
+      glState().Enable(GL_DEPTH_TEST);
     }
 
     void Draw()
@@ -42,8 +43,8 @@ class TerrainScene : Scene
       terrainShader->use();
       glm::mat4 model;
 
-      // Textures: 0->heightmap | 1->grass | 2->snow | 3->dirt
-      terrainShader->setInt("heightmap", 0);
+      // Textures: 0->baked heights and normals | 1->grass | 2->snow | 3->dirt
+      terrainShader->setInt("terrainMap", 0);
       terrainShader->setInt("grass", 1);
       terrainShader->setInt("snow", 2);
       terrainShader->setInt("dirt", 3);
@@ -55,6 +56,7 @@ class TerrainScene : Scene
 
       // Debug
       terrainShader->setFloat("elevation", elevation);
+      terrain->SetElevation(elevation);
 
       lightPos.x = sin(glfwGetTime()) * 10;
       lightPos.z = cos(glfwGetTime()) * 10;
@@ -91,8 +93,7 @@ class TerrainScene : Scene
     void DrawLamp()
     {
       lampShader->use();
-      lampShader->setMat4("projection", projection);
-      lampShader->setMat4("view", view);
+      uniformBlocks().SetCamera(projection, view, camera.Position); // lamp.vs reads the Camera block
       glm::mat4 model = glm::mat4();
       model = glm::translate(model, lightPos);
       model = glm::scale(model, glm::vec3(0.2f)); // a smaller cube
@@ -108,6 +109,7 @@ class TerrainScene : Scene
 
       ImGui::Text("Terrain parameters");
       ImGui::SliderFloat("Elevation", &elevation, 0.01f, 1.0f);
+      ImGui::Text("Normal bake %.2f ms", terrain->BakeMs());
 
       ImGui::Text("Light Pos = %.3f %.3f %.3f", lightPos.x, lightPos.y, lightPos.z);
 
@@ -0,0 +1,379 @@
+#ifndef TEXTURE_ARRAYS_H
+#define TEXTURE_ARRAYS_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include <glad/glad.h>
+
+#include "dep/stb_image/stb_image.h"
+
+#include "GLState.h"
+#include "DDS.h"
+#include "BCEncoder.h"
+#include "MipChain.h"
+#include "ChannelPack.h"
+#include "TextureStreamer.h"
+#include "ResourceManager.h"
+
+// Where a material texture lives: a layer of a GL_TEXTURE_2D_ARRAY. array stays 0 until
+// the arrays are built, and when the file cannot be read.
+struct TextureLayer
+{
+  unsigned int array = 0;
+  int layer = -1;
+};
+
+// Packs material textures into GL_TEXTURE_2D_ARRAYs, one per size and format (block
+// format and mip count for .dds, RGBA8 otherwise), so consecutive meshes mostly draw
+// without rebinding and pick their image with a layer index. Textures are added as
+// meshes are created and grouped when the arrays are built (TextureLoader::LoadArrays);
+// later additions go to new arrays, an array cannot grow without a copy. Every layer
+// shows a neutral texel until its own data is uploaded, and the array exposes a mip
+// level once all of its layers have it.
+class TextureArrays
+{
+  public:
+    // A layer for the loader to fill
+    struct Job
+    {
+      std::string path;
+      MipFilter filter;
+      unsigned int array, layer;
+      unsigned int streamSize; // largest mip to load now, 0 for all
+    };
+
+    // Layer of path, valid once the arrays are built, with a new reference to give back
+    // with Release
+    const TextureLayer* Add(const std::string& path, MipFilter filter)
+    {
+      auto it = byPath.find(path);
+      if (it != byPath.end())
+      {
+        refs[it->second]++;
+        return &layers[it->second];
+      }
+
+      unsigned int slot = layers.size();
+      byPath[path] = slot;
+      layers.push_back(TextureLayer());
+      refs.push_back(1);
+      slots[&layers.back()] = slot;
+      pending.push_back({ path, filter, slot });
+      return &layers.back();
+    }
+
+    // The last reference to a layer frees it (a later Add of its file gets a new one),
+    // the last layer in use of an array deletes the array once nothing loads into it
+    void Release(const TextureLayer* layer)
+    {
+      auto it = slots.find(layer);
+      if (it == slots.end() || --refs[it->second] > 0)
+        return;
+
+      unsigned int slot = it->second;
+      slots.erase(it);
+      for (auto p = byPath.begin(); p != byPath.end(); ++p)
+        if (p->second == slot)
+        {
+          byPath.erase(p);
+          break;
+        }
+      pending.erase(std::remove_if(pending.begin(), pending.end(), [slot](const Request& r) { return r.slot == slot; }), pending.end());
+
+      auto a = arrays.find(layer->array);
+      if (a != arrays.end() && --a->second.used == 0)
+      {
+        a->second.released = true;
+        if (a->second.remaining == 0)
+          destroy(a);
+      }
+    }
+
+    bool Pending() const { return !pending.empty(); }
+
+    // Create the arrays of the textures added since the last call
+    void Build(std::vector<Job>& jobs)
+    {
+      if (pending.empty())
+        return;
+
+      bool s3tc = hasGLExtension("GL_EXT_texture_compression_s3tc");
+      unsigned int streamSize = textureStreamer().enabled ? textureStreamer().startSize : 0;
+      GLint maxLayers = 256;
+      glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+      std::map<Key, std::vector<Request>> groups;
+      std::map<Key, DDSImage> infos;
+      for (const Request& r : pending)
+      {
+        DDSImage info;
+        if (!probe(r.path, s3tc, info))
+        {
+          std::cout << "Texture failed to load at path: " << r.path << std::endl;
+          continue;
+        }
+        Key key = { info.width, info.height, info.format, info.levels };
+        groups[key].push_back(r);
+        infos[key] = info;
+      }
+      pending.clear();
+
+      for (auto& g : groups)
+        for (unsigned int i = 0; i < g.second.size(); i += maxLayers)
+        {
+          unsigned int count = std::min((unsigned int)maxLayers, (unsigned int)g.second.size() - i);
+          bool compressed = infos[g.first].blockBytes > 0;
+          unsigned int array = create(infos[g.first], count, compressed ? streamSize : 0);
+          for (unsigned int l = 0; l < count; l++)
+          {
+            const Request& r = g.second[i + l];
+            layers[r.slot].array = array;
+            layers[r.slot].layer = l;
+            arrays[array].used++;
+            jobs.push_back({ r.path, r.filter, array, l, compressed ? streamSize : 0 });
+          }
+        }
+    }
+
+    // Whether a decoded image fits the array it was packed into
+    bool Accepts(unsigned int array, GLenum format, unsigned int width, unsigned int height, unsigned int levels) const
+    {
+      auto it = arrays.find(array);
+      return it != arrays.end() && it->second.info.format == format && it->second.info.width == width
+        && it->second.info.height == height && it->second.info.levels == levels;
+    }
+
+    // Loader, with the array bound: level of layer uploaded
+    void LevelUploaded(unsigned int array, unsigned int layer, unsigned int level)
+    {
+      Array& a = arrays[array];
+      a.finest[layer] = std::min(a.finest[layer], level);
+      updateBaseLevel(a);
+    }
+
+    // Loader: every level of layer uploaded, or the layer failed to load. Fully loaded
+    // .dds arrays go on to the streamer.
+    void LayerLoaded(unsigned int array, unsigned int layer, bool ok, const std::string& path, size_t dataOffset)
+    {
+      Array& a = arrays[array];
+      if (!ok)
+      {
+        glState().BindTexture(GL_TEXTURE_2D_ARRAY, array);
+        for (unsigned int l = a.first; l < a.info.levels; l++)
+          fillNeutral(a, l, layer, 1);
+        a.finest[layer] = a.first;
+        a.failed = true;
+        updateBaseLevel(a);
+      }
+      a.paths[layer] = path;
+      a.dataOffsets[layer] = dataOffset;
+
+      if (--a.remaining == 0 && a.released)
+      {
+        destroy(arrays.find(array));
+        return;
+      }
+      if (a.remaining == 0 && !a.failed && a.info.blockBytes > 0 && a.first > 0)
+        textureStreamer().Register(array, GL_TEXTURE_2D_ARRAY, a.paths, a.dataOffsets, a.info, a.first);
+    }
+
+    // Bind array on texture unit (0-3) unless it already is (see GLState, which also
+    // sees the binds of uploads and streaming)
+    void Bind(unsigned int unit, unsigned int array)
+    {
+      if (glState().BindTexture(unit, GL_TEXTURE_2D_ARRAY, array))
+        binds++;
+    }
+
+    // Render thread, before drawing
+    void BeginFrame()
+    {
+      bindsLastFrame = binds;
+      binds = 0;
+    }
+
+    unsigned int Count() const { return arrays.size(); }
+    unsigned int Layers() const { return layers.size(); }
+    unsigned int BindsLastFrame() const { return bindsLastFrame; }
+
+  private:
+    struct Request
+    {
+      std::string path;
+      MipFilter filter;
+      unsigned int slot;
+    };
+
+    struct Key
+    {
+      unsigned int width, height;
+      GLenum format;
+      unsigned int levels;
+
+      bool operator<(const Key& o) const
+      {
+        if (format != o.format) return format < o.format;
+        if (width != o.width) return width < o.width;
+        if (height != o.height) return height < o.height;
+        return levels < o.levels;
+      }
+    };
+
+    struct Array
+    {
+      DDSImage info;                  // size and format of every layer, blockBytes 0 for RGBA8
+      unsigned int layers = 0;
+      unsigned int first = 0;         // finest level allocated, finer ones are streamed
+      unsigned int base = 0;          // GL_TEXTURE_BASE_LEVEL
+      std::vector<unsigned int> finest; // finest level uploaded per layer
+      std::vector<std::string> paths; // file each layer was read from
+      std::vector<size_t> dataOffsets;
+      unsigned int remaining = 0;     // layers still loading
+      unsigned int used = 0;          // layers with references
+      bool failed = false;
+      bool released = false;          // no layer in use, deleted when loaded
+    };
+
+    std::deque<TextureLayer> layers; // stable addresses for the meshes
+    std::deque<unsigned int> refs;   // per layer
+    std::unordered_map<const TextureLayer*, unsigned int> slots;
+    std::unordered_map<std::string, unsigned int> byPath;
+    std::vector<Request> pending;
+    std::unordered_map<unsigned int, Array> arrays;
+
+    unsigned int binds = 0, bindsLastFrame = 0;
+
+    void destroy(std::unordered_map<unsigned int, Array>::iterator a)
+    {
+      textureStreamer().Unregister(a->first);
+      resources().Release(RESOURCE_TEXTURE, a->first);
+      arrays.erase(a);
+    }
+
+    // Size and format the loader will produce for path (see TextureLoader::decode)
+    static bool probe(const std::string& path, bool s3tc, DDSImage& info)
+    {
+      size_t dataOffset;
+      if (preferCompressedTextures && readDDSHeader(ddsPath(path), info, dataOffset) && info.faces == 1
+          && (s3tc || info.format == GL_COMPRESSED_RED_RGTC1 || info.format == GL_COMPRESSED_RG_RGTC2))
+        return true;
+
+      // Packed images come out the size of their diffuse map
+      int width, height, components;
+      std::string image = path, alphaPath;
+      if (isPackedTexturePath(path))
+        splitPackedTexturePath(path, image, alphaPath);
+      if (!stbi_info(image.c_str(), &width, &height, &components))
+        return false;
+      info = DDSImage();
+      info.format = GL_RGBA;
+      info.formatName = "RGBA8";
+      info.width = width;
+      info.height = height;
+      info.levels = 1 + (unsigned int)std::floor(std::log2((float)std::max(width, height)));
+      return true;
+    }
+
+    unsigned int create(const DDSImage& info, unsigned int count, unsigned int streamSize)
+    {
+      unsigned int texture;
+      glGenTextures(1, &texture);
+      Array& a = arrays[texture];
+      a.info = info;
+      a.layers = count;
+      while (streamSize > 0 && a.first + 1 < info.levels && std::max(info.width >> a.first, info.height >> a.first) > streamSize)
+        a.first++;
+
+      glState().BindTexture(GL_TEXTURE_2D_ARRAY, texture);
+      size_t bytes = 0;
+      for (unsigned int l = a.first; l < info.levels; l++)
+      {
+        unsigned int w = std::max(1u, info.width >> l), h = std::max(1u, info.height >> l);
+        if (info.blockBytes)
+          glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, l, info.format, w, h, count, 0, ddsLevelSize(info, l) * count, NULL);
+        else
+          glTexImage3D(GL_TEXTURE_2D_ARRAY, l, GL_RGBA8, w, h, count, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        bytes += (size_t)(info.blockBytes ? ddsLevelSize(info, l) : w * h * 4) * count;
+      }
+      resources().Add(RESOURCE_TEXTURE, texture, bytes, "array " + std::to_string(info.width) + "x"
+          + std::to_string(info.height) + " " + info.formatName + " x" + std::to_string(count));
+      fillNeutral(a, info.levels - 1, 0, count);
+
+      a.base = info.levels - 1;
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, a.base);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, info.levels - 1);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+      a.finest.assign(count, a.base);
+      a.paths.resize(count);
+      a.dataOffsets.resize(count);
+      a.remaining = count;
+      return texture;
+    }
+
+    // Mid gray color, flat normal, opaque mask in level of layers [first, first + count),
+    // the array is bound
+    static void fillNeutral(const Array& a, unsigned int level, unsigned int first, unsigned int count)
+    {
+      unsigned int w = std::max(1u, a.info.width >> level), h = std::max(1u, a.info.height >> level);
+      uint8_t rgba[64];
+      for (unsigned int i = 0; i < 16; i++)
+      {
+        rgba[i * 4] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = 128;
+        rgba[i * 4 + 3] = 255;
+      }
+
+      std::vector<uint8_t> data;
+      if (a.info.blockBytes)
+      {
+        uint8_t block[16];
+        switch (a.info.format)
+        {
+          case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT: memset(block, 0xff, 8); encodeBC1Block(rgba, block + 8); break;
+          case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: encodeBC3Block(rgba, block); break;
+          case GL_COMPRESSED_RED_RGTC1: encodeBC4Block(rgba, 0, block); break;
+          case GL_COMPRESSED_RG_RGTC2: encodeBC5Block(rgba, block); break;
+          default: encodeBC1Block(rgba, block); break;
+        }
+        unsigned int blocks = ddsLevelSize(a.info, level) / a.info.blockBytes * count;
+        for (unsigned int b = 0; b < blocks; b++)
+          data.insert(data.end(), block, block + a.info.blockBytes);
+        glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, first, w, h, count, a.info.format, data.size(), data.data());
+      }
+      else
+      {
+        for (unsigned int p = 0; p < w * h * count; p++)
+          data.insert(data.end(), rgba, rgba + 4);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, first, w, h, count, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+      }
+    }
+
+    // A level is shown once every layer has it, the array is bound
+    static void updateBaseLevel(Array& a)
+    {
+      unsigned int base = *std::max_element(a.finest.begin(), a.finest.end());
+      if (base != a.base)
+      {
+        a.base = base;
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, base);
+      }
+    }
+};
+
+inline TextureArrays& textureArrays()
+{
+  static TextureArrays arrays;
+  return arrays;
+}
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef TEXTURE_COOKER_H
+#define TEXTURE_COOKER_H
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+
+#include "DDS.h"
+#include "BCEncoder.h"
+#include "MipChain.h"
+#include "ChannelPack.h"
+#include "TextureStats.h"
+#include "CubemapFaces.h"
+#include "dep/stb_image/stb_image.h"
+
+// Offline texture compression: an image is encoded with its whole mip chain into a
+// .dds next to it, which loadTexture then prefers over the source. The block format
+// follows how the shaders sample the texture:
+//   color    BC1, or BC3 when the alpha channel is used
+//   specular BC1
+//   normal   BC5 (X, Y), Z is rebuilt in the shader
+//   mask     BC4 (R)
+// Mips are filtered in linear space for color maps and renormalized for normal maps
+// (see MipChain.h).
+const unsigned int TEXTURE_COOK_VERSION = 2;
+
+// "normal" for normal maps (map_bump or *_normal / *_ddn names), "mask" for map_d,
+// "specular" for map_Ks, "color" otherwise
+static std::string textureUsage(const std::string& path, const std::string& mtlKey)
+{
+  std::string name = path.substr(path.find_last_of("\\/") + 1);
+  if (mtlKey == "map_bump" || name.find("_normal") != std::string::npos || name.find("_ddn") != std::string::npos)
+    return "normal";
+  if (mtlKey == "map_d")
+    return "mask";
+  if (mtlKey == "map_Ks" || name.find("_spec") != std::string::npos)
+    return "specular";
+  return "color";
+}
+
+static MipFilter textureMipFilter(const std::string& usage)
+{
+  if (usage == "color")
+    return MIP_SRGB;
+  if (usage == "normal")
+    return MIP_NORMAL;
+  return MIP_LINEAR;
+}
+
+// Gather the 4x4 block at (bx, by), clamping at the image edges
+static void fetchBlock(const MipImage& img, int bx, int by, uint8_t block[64])
+{
+  for (int y = 0; y < 4; y++)
+    for (int x = 0; x < 4; x++)
+    {
+      int sx = std::min(bx * 4 + x, img.width - 1), sy = std::min(by * 4 + y, img.height - 1);
+      memcpy(&block[(y * 4 + x) * 4], &img.rgba[(sy * img.width + sx) * 4], 4);
+    }
+}
+
+static void encodeLevel(const MipImage& img, GLenum format, std::vector<uint8_t>& out)
+{
+  int bw = (img.width + 3) / 4, bh = (img.height + 3) / 4;
+  uint8_t block[64];
+  for (int by = 0; by < bh; by++)
+    for (int bx = 0; bx < bw; bx++)
+    {
+      fetchBlock(img, bx, by, block);
+      size_t offset = out.size();
+      switch (format)
+      {
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+          out.resize(offset + 8);
+          encodeBC1Block(block, &out[offset]);
+          break;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+          out.resize(offset + 16);
+          encodeBC3Block(block, &out[offset]);
+          break;
+        case GL_COMPRESSED_RED_RGTC1:
+          out.resize(offset + 8);
+          encodeBC4Block(block, 0, &out[offset]);
+          break;
+        case GL_COMPRESSED_RG_RGTC2:
+          out.resize(offset + 16);
+          encodeBC5Block(block, &out[offset]);
+          break;
+      }
+    }
+}
+
+// PSNR of the first level over the channels the format keeps
+static double levelPSNR(const MipImage& img, const DDSImage& dds)
+{
+  unsigned int channels[4];
+  unsigned int count = 0;
+  switch (dds.format)
+  {
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: channels[count++] = 3; // fallthrough
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: channels[count++] = 0; channels[count++] = 1; channels[count++] = 2; break;
+    case GL_COMPRESSED_RG_RGTC2: channels[count++] = 1; // fallthrough
+    case GL_COMPRESSED_RED_RGTC1: channels[count++] = 0; break;
+  }
+
+  int bw = (img.width + 3) / 4, bh = (img.height + 3) / 4;
+  double sum = 0.0;
+  uint8_t block[64], decoded[64];
+  const uint8_t* in = dds.data.data();
+  for (int by = 0; by < bh; by++)
+    for (int bx = 0; bx < bw; bx++)
+    {
+      fetchBlock(img, bx, by, block);
+      switch (dds.format)
+      {
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: decodeBC1Block(in, decoded); break;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: decodeBC4Block(in, 3, decoded); decodeBC1Block(in + 8, decoded); break;
+        case GL_COMPRESSED_RED_RGTC1: decodeBC4Block(in, 0, decoded); break;
+        case GL_COMPRESSED_RG_RGTC2: decodeBC4Block(in, 0, decoded); decodeBC4Block(in + 8, 1, decoded); break;
+      }
+      in += dds.blockBytes;
+
+      for (int y = 0; y < 4 && by * 4 + y < img.height; y++)
+        for (int x = 0; x < 4 && bx * 4 + x < img.width; x++)
+          for (unsigned int c = 0; c < count; c++)
+          {
+            double d = (double)block[(y * 4 + x) * 4 + channels[c]] - decoded[(y * 4 + x) * 4 + channels[c]];
+            sum += d * d;
+          }
+    }
+
+  double mse = sum / ((double)img.width * img.height * count);
+  return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+// Encode src (and its mip chain) into dst, report gets a one line summary
+static bool cookTexture(const std::string& src, const std::string& dst, const std::string& usage, std::string& report)
+{
+  MipImage img;
+  int n;
+  unsigned char* data = stbi_load(src.c_str(), &img.width, &img.height, &n, 4);
+  if (!data)
+  {
+    std::cerr << "Cannot load " << src << std::endl;
+    return false;
+  }
+  img.rgba.assign(data, data + img.width * img.height * 4);
+  stbi_image_free(data);
+
+  DDSImage dds;
+  dds.width = img.width;
+  dds.height = img.height;
+  if (usage == "normal")
+    ddsFormat(DDS_FOURCC('A', 'T', 'I', '2'), 0, dds);
+  else if (usage == "mask")
+    ddsFormat(DDS_FOURCC('A', 'T', 'I', '1'), 0, dds);
+  else
+  {
+    bool alpha = false;
+    for (size_t i = 3; i < img.rgba.size() && !alpha; i += 4)
+      alpha = img.rgba[i] < 255;
+    ddsFormat(alpha ? DDS_FOURCC('D', 'X', 'T', '5') : DDS_FOURCC('D', 'X', 'T', '1'), 0, dds);
+  }
+
+  std::vector<MipImage> chain;
+  buildMipChain(img, textureMipFilter(usage), chain);
+  dds.levels = chain.size();
+  for (const MipImage& level : chain)
+    encodeLevel(level, dds.format, dds.data);
+
+  if (!writeDDS(dst, dds))
+    return false;
+
+  char line[128];
+  snprintf(line, sizeof(line), "%s %dx%d %u mips, %.1fx smaller, PSNR %.2f dB",
+      dds.formatName, img.width, img.height, dds.levels,
+      (double)rgba8MipChainBytes(img.width, img.height) / dds.data.size(), levelPSNR(img, dds));
+  report = line;
+  return true;
+}
+
+const unsigned int CUBEMAP_COOK_VERSION = 1;
+
+// The six faces of a skybox as one BC1 cubemap .dds with mips, faces one after the other
+static bool cookCubemap(const std::vector<std::string>& faces, const std::string& dst, std::string& report)
+{
+  DDSImage dds;
+  ddsFormat(DDS_FOURCC('D', 'X', 'T', '1'), 0, dds);
+  dds.faces = 6;
+  double psnr = 0.0;
+  for (const std::string& face : faces)
+  {
+    MipImage img;
+    int n;
+    unsigned char* data = stbi_load(face.c_str(), &img.width, &img.height, &n, 4);
+    if (!data)
+    {
+      std::cerr << "Cannot load " << face << std::endl;
+      return false;
+    }
+    img.rgba.assign(data, data + img.width * img.height * 4);
+    stbi_image_free(data);
+
+    if (dds.width == 0)
+    {
+      dds.width = img.width;
+      dds.height = img.height;
+    }
+    if (img.width != (int)dds.width || img.height != (int)dds.height || img.width != img.height)
+    {
+      std::cerr << "Cubemap faces must be square and of the same size: " << face << std::endl;
+      return false;
+    }
+
+    std::vector<MipImage> chain;
+    buildMipChain(img, MIP_SRGB, chain);
+    dds.levels = chain.size();
+
+    DDSImage faceDDS = dds;
+    faceDDS.faces = 1;
+    faceDDS.data.clear();
+    for (const MipImage& level : chain)
+      encodeLevel(level, dds.format, faceDDS.data);
+    psnr += levelPSNR(img, faceDDS) / faces.size();
+    dds.data.insert(dds.data.end(), faceDDS.data.begin(), faceDDS.data.end());
+  }
+
+  if (!writeDDS(dst, dds))
+    return false;
+
+  char line[128];
+  snprintf(line, sizeof(line), "BC1 cubemap %ux%u %u mips, %.1fx smaller, PSNR %.2f dB", dds.width, dds.height, dds.levels,
+      6.0 * rgba8MipChainBytes(dds.width, dds.height) / dds.data.size(), psnr);
+  report = line;
+  return true;
+}
+
+// Diffuse map with a mask or specular map in its alpha (see ChannelPack.h), always BC3
+const unsigned int PACKED_COOK_VERSION = 1;
+
+static bool cookPackedTexture(const std::string& packedPath, const std::string& dst, std::string& report)
+{
+  MipImage img;
+  if (!loadPackedImage(packedPath, img))
+    return false;
+
+  DDSImage dds;
+  dds.width = img.width;
+  dds.height = img.height;
+  ddsFormat(DDS_FOURCC('D', 'X', 'T', '5'), 0, dds);
+
+  std::vector<MipImage> chain;
+  buildMipChain(img, MIP_SRGB, chain);
+  dds.levels = chain.size();
+  for (const MipImage& level : chain)
+    encodeLevel(level, dds.format, dds.data);
+
+  if (!writeDDS(dst, dds))
+    return false;
+
+  char line[128];
+  snprintf(line, sizeof(line), "%s packed %dx%d %u mips, %.1fx smaller, PSNR %.2f dB",
+      dds.formatName, img.width, img.height, dds.levels,
+      (double)rgba8MipChainBytes(img.width, img.height) / dds.data.size(), levelPSNR(img, dds));
+  report = line;
+  return true;
+}
+
+#endif
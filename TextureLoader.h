@@ -0,0 +1,383 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <future>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include <glad/glad.h>
+
+#include "dep/stb_image/stb_image.h"
+
+#include "GLState.h"
+#include "DDS.h"
+#include "ThreadPool.h"
+#include "TextureStats.h"
+#include "MipChain.h"
+#include "ChannelPack.h"
+#include "UploadRing.h"
+#include "TextureStreamer.h"
+#include "TextureArrays.h"
+#include "ResourceManager.h"
+
+// Decode textures on the worker pool and upload them from the render loop
+static bool asyncTextureLoading = true;
+
+// Build mip chains of uncompressed images on the worker pool (see MipChain.h) instead
+// of calling glGenerateMipmap after the upload
+static bool workerMipmaps = true;
+
+// Asynchronous texture loading: files are read and decoded on the worker pool, then
+// uploaded through the upload ring within its per-frame budget (Update). Single
+// textures (Load) get their name right away, holding a 1x1 neutral texel until the data
+// lands, so they can be bound at any time; material textures are loaded as layers of
+// the texture arrays (LoadArrays), where streaming arrays only get their small mips.
+// Mip levels are uploaded smallest first and become visible as they arrive
+// (GL_TEXTURE_BASE_LEVEL). Time spent on the render thread and on the GPU is reported
+// once the queue drains.
+class TextureLoader
+{
+  public:
+    // Texture name for path, filled in by later Update calls
+    unsigned int Load(const std::string& path, MipFilter filter = MIP_SRGB)
+    {
+      Request r;
+      glGenTextures(1, &r.texture);
+      r.path = path;
+      r.start = std::chrono::high_resolution_clock::now();
+
+      // Neutral until loaded: mid gray color, flat normal, opaque mask
+      const unsigned char texel[4] = { 128, 128, 128, 255 };
+      glState().BindTexture(GL_TEXTURE_2D, r.texture);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+      bool s3tc = hasGLExtension("GL_EXT_texture_compression_s3tc");
+      bool mips = workerMipmaps;
+      r.decoded = workerPool().Submit([path, s3tc, mips, filter] { return decode(path, s3tc, mips, filter, 0); }).share();
+      push(r);
+      return r.texture;
+    }
+
+    // Create the arrays of the textures added to textureArrays() since the last call and
+    // load their layers. Without asyncTextureLoading this waits until they are uploaded.
+    void LoadArrays()
+    {
+      std::vector<TextureArrays::Job> jobs;
+      textureArrays().Build(jobs);
+
+      bool s3tc = hasGLExtension("GL_EXT_texture_compression_s3tc");
+      for (const TextureArrays::Job& job : jobs)
+      {
+        Request r;
+        r.texture = job.array;
+        r.array = true;
+        r.layer = job.layer;
+        r.path = job.path;
+        r.start = std::chrono::high_resolution_clock::now();
+        std::string path = job.path;
+        MipFilter filter = job.filter;
+        unsigned int streamSize = job.streamSize;
+        r.decoded = workerPool().Submit([path, s3tc, filter, streamSize] { return decode(path, s3tc, true, filter, streamSize); }).share();
+        push(r);
+      }
+
+      while (!asyncTextureLoading && !requests.empty())
+      {
+        requests.front().decoded.wait();
+        uploadRing().BeginFrame();
+        Update();
+      }
+    }
+
+    // Render thread, once per frame: collect decoded images and upload within budget
+    void Update()
+    {
+      collectTimers();
+      if (requests.empty())
+      {
+        if (reportPending && timers.empty())
+        {
+          std::cout << "Textures loaded in " << loadMs << " ms (" << renderThreadMs << " ms on the render thread, "
+            << gpuMs << " ms on the GPU, " << (workerMipmaps ? "worker" : "glGenerateMipmap") << " mips)" << std::endl;
+          reportPending = false;
+        }
+        return;
+      }
+
+      auto cpuStart = std::chrono::high_resolution_clock::now();
+      unsigned int timer;
+      glGenQueries(1, &timer);
+      glBeginQuery(GL_TIME_ELAPSED, timer);
+
+      while (!requests.empty())
+      {
+        Request& r = requests.front();
+        if (r.decoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+          break;
+
+        const Decoded& d = *r.decoded.get();
+        if (!d.ok)
+        {
+          std::cout << "Texture failed to load at path: " << r.path << std::endl;
+          finish(r, d);
+          continue;
+        }
+        if (r.array && !textureArrays().Accepts(r.texture, d.internalFormat, d.width, d.height, d.mipLevels))
+        {
+          std::cout << "Texture " << d.path << " does not match its array" << std::endl;
+          finish(r, d, false);
+          continue;
+        }
+
+        // Smallest level first
+        while (r.nextLevel < d.levels.size())
+        {
+          const Level& level = d.levels[d.levels.size() - 1 - r.nextLevel];
+          if (!upload(r, d, level))
+            break;
+          r.nextLevel++;
+        }
+
+        if (r.nextLevel < d.levels.size())
+          break;
+        finish(r, d);
+      }
+
+      glEndQuery(GL_TIME_ELAPSED);
+      timers.push_back(timer);
+
+      auto now = std::chrono::high_resolution_clock::now();
+      renderThreadMs += std::chrono::duration<double, std::milli>(now - cpuStart).count();
+      if (requests.empty())
+      {
+        loadMs = std::chrono::duration<double, std::milli>(now - batchStart).count();
+        reportPending = true;
+      }
+    }
+
+    unsigned int Pending() const { return requests.size(); }
+
+  private:
+    struct Level
+    {
+      unsigned int level, width, height;
+      size_t offset, size;
+    };
+
+    // Worker output: every level to upload, tightly packed in data
+    struct Decoded
+    {
+      bool ok = false;
+      bool compressed = false;
+      std::string path; // file actually read
+      GLenum internalFormat = 0, format = 0;
+      const char* formatName = "";
+      unsigned int width = 0, height = 0, mipLevels = 0;
+      std::vector<Level> levels;
+      std::vector<unsigned char> data;
+
+      size_t dataOffset = 0; // of level 0 in a .dds
+    };
+
+    struct Request
+    {
+      unsigned int texture = 0;
+      std::string path;
+      std::chrono::high_resolution_clock::time_point start;
+      std::shared_future<std::shared_ptr<Decoded>> decoded;
+      unsigned int nextLevel = 0;
+      bool array = false; // texture is a GL_TEXTURE_2D_ARRAY, filling layer
+      unsigned int layer = 0;
+    };
+
+    std::deque<Request> requests;
+
+    // Cost of the current batch
+    std::chrono::high_resolution_clock::time_point batchStart;
+    std::vector<unsigned int> timers; // GL_TIME_ELAPSED queries of the Update calls
+    double loadMs = 0.0, renderThreadMs = 0.0, gpuMs = 0.0;
+    bool reportPending = false;
+
+    void push(const Request& r)
+    {
+      if (requests.empty())
+      {
+        batchStart = r.start;
+        renderThreadMs = gpuMs = 0.0;
+      }
+      requests.push_back(r);
+    }
+
+    void collectTimers()
+    {
+      while (!timers.empty())
+      {
+        GLint available = 0;
+        glGetQueryObjectiv(timers.front(), GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+          break;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(timers.front(), GL_QUERY_RESULT, &ns);
+        gpuMs += ns / 1.0e6;
+        glDeleteQueries(1, &timers.front());
+        timers.erase(timers.begin());
+      }
+    }
+
+    // No GL here, runs on the pool. streamSize > 0 only reads the .dds mips up to that size.
+    static std::shared_ptr<Decoded> decode(const std::string& path, bool s3tc, bool mips, MipFilter filter, unsigned int streamSize)
+    {
+      std::shared_ptr<Decoded> d = std::make_shared<Decoded>();
+
+      DDSImage dds;
+      size_t dataOffset;
+      if (preferCompressedTextures && readDDSHeader(ddsPath(path), dds, dataOffset) && dds.faces == 1
+          && (s3tc || dds.format == GL_COMPRESSED_RED_RGTC1 || dds.format == GL_COMPRESSED_RG_RGTC2))
+      {
+        unsigned int first = 0;
+        if (streamSize > 0)
+          while (first + 1 < dds.levels && std::max(dds.width >> first, dds.height >> first) > streamSize)
+            first++;
+
+        if (readDDSLevels(ddsPath(path), dds, dataOffset, first, dds.levels - 1, d->data))
+        {
+          d->ok = true;
+          d->compressed = true;
+          d->path = ddsPath(path);
+          d->internalFormat = dds.format;
+          d->formatName = dds.formatName;
+          d->width = dds.width;
+          d->height = dds.height;
+          d->mipLevels = dds.levels;
+          size_t offset = 0;
+          for (unsigned int l = first; l < dds.levels; l++)
+          {
+            Level level = { l, std::max(1u, dds.width >> l), std::max(1u, dds.height >> l), offset, ddsLevelSize(dds, l) };
+            d->levels.push_back(level);
+            offset += level.size;
+          }
+          d->dataOffset = dataOffset;
+          return d;
+        }
+      }
+
+      // Packed images are assembled here, always with their mip chain
+      MipImage packed;
+      if (isPackedTexturePath(path))
+      {
+        if (!loadPackedImage(path, packed))
+          return d;
+        mips = true;
+      }
+
+      int width = packed.width, height = packed.height, nrComponents = 4;
+      unsigned char* data = packed.width ? nullptr : stbi_load(path.c_str(), &width, &height, &nrComponents, mips ? 4 : 0);
+      if (!data && !packed.width)
+        return d;
+
+      d->ok = true;
+      d->path = path;
+      d->formatName = "RGBA8";
+      d->width = width;
+      d->height = height;
+      d->mipLevels = 1 + (unsigned int)std::floor(std::log2((float)std::max(width, height)));
+
+      if (mips)
+      {
+        MipImage base = packed;
+        if (data)
+        {
+          base.width = width;
+          base.height = height;
+          base.rgba.assign(data, data + (size_t)width * height * 4);
+          stbi_image_free(data);
+        }
+
+        std::vector<MipImage> chain;
+        buildMipChain(base, filter, chain);
+        d->internalFormat = d->format = GL_RGBA;
+        for (unsigned int l = 0; l < chain.size(); l++)
+        {
+          d->levels.push_back({ l, (unsigned int)chain[l].width, (unsigned int)chain[l].height, d->data.size(), chain[l].rgba.size() });
+          d->data.insert(d->data.end(), chain[l].rgba.begin(), chain[l].rgba.end());
+        }
+        return d;
+      }
+
+      GLenum formats[4] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+      d->internalFormat = d->format = formats[nrComponents - 1];
+      d->data.assign(data, data + (size_t)width * height * nrComponents);
+      d->levels.push_back({ 0, (unsigned int)width, (unsigned int)height, 0, d->data.size() });
+      stbi_image_free(data);
+      return d;
+    }
+
+    // One level through the upload ring, false when it has to wait for the next frame
+    bool upload(const Request& r, const Decoded& d, const Level& level)
+    {
+      if (r.array)
+      {
+        glState().BindTexture(GL_TEXTURE_2D_ARRAY, r.texture);
+        if (!uploadRing().UploadLayer(level.level, r.layer, d.compressed ? d.internalFormat : d.format, d.compressed,
+              level.width, level.height, &d.data[level.offset], level.size))
+          return false;
+        textureArrays().LevelUploaded(r.texture, r.layer, level.level);
+        return true;
+      }
+
+      glState().BindTexture(GL_TEXTURE_2D, r.texture);
+      if (!uploadRing().Upload(level.level, d.internalFormat, d.format, d.compressed, level.width, level.height, &d.data[level.offset], level.size))
+        return false;
+
+      // A single level means the chain is left to the driver
+      if (d.levels.size() == 1 && d.mipLevels > 1)
+        glGenerateMipmap(GL_TEXTURE_2D);
+      else
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level.level);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, d.mipLevels - 1);
+      return true;
+    }
+
+    void finish(Request& r, const Decoded& d, bool used = true)
+    {
+      if (r.array)
+        textureArrays().LayerLoaded(r.texture, r.layer, d.ok && used, d.path, d.dataOffset);
+      else
+        resources().SetBytes(RESOURCE_TEXTURE, r.texture, d.ok ? (d.compressed ? d.data.size() : rgba8MipChainBytes(d.width, d.height)) : 4);
+
+      if (d.ok && used)
+      {
+        TextureRecord record;
+        record.path = d.path;
+        record.format = d.formatName;
+        record.width = d.width;
+        record.height = d.height;
+        record.levels = d.mipLevels;
+        record.bytes = d.compressed ? d.data.size() : rgba8MipChainBytes(d.width, d.height); // resident at load
+        record.uncompressedBytes = rgba8MipChainBytes(d.width, d.height);
+        record.ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - r.start).count();
+        textureRecords().push_back(record);
+      }
+
+      requests.pop_front();
+    }
+};
+
+inline TextureLoader& textureLoader()
+{
+  static TextureLoader loader;
+  return loader;
+}
+
+#endif
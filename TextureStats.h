@@ -0,0 +1,57 @@
+#ifndef TEXTURE_STATS_H
+#define TEXTURE_STATS_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+
+// Per-texture memory/upload bookkeeping, printed as a report after loading a scene
+struct TextureRecord
+{
+  std::string path;
+  std::string format;
+  unsigned int width, height, levels;
+  size_t bytes;             // what the texture takes in VRAM
+  size_t uncompressedBytes; // same texture as RGBA8 with a full mip chain
+  double ms;                // read + decode + upload
+};
+
+inline std::vector<TextureRecord>& textureRecords()
+{
+  static std::vector<TextureRecord> records;
+  return records;
+}
+
+inline size_t rgba8MipChainBytes(unsigned int width, unsigned int height)
+{
+  size_t bytes = 0;
+  while (true)
+  {
+    bytes += (size_t)width * height * 4;
+    if (width == 1 && height == 1)
+      break;
+    width = width > 1 ? width / 2 : 1;
+    height = height > 1 ? height / 2 : 1;
+  }
+  return bytes;
+}
+
+inline void printTextureReport()
+{
+  size_t bytes = 0, uncompressed = 0;
+  double ms = 0.0;
+
+  printf("%-60s %-6s %11s %6s %10s %10s %8s\n", "texture", "format", "size", "levels", "VRAM KB", "RGBA8 KB", "ms");
+  for (const TextureRecord& r : textureRecords())
+  {
+    printf("%-60s %-6s %5ux%-5u %6u %10zu %10zu %8.2f\n", r.path.c_str(), r.format.c_str(), r.width, r.height, r.levels,
+        r.bytes / 1024, r.uncompressedBytes / 1024, r.ms);
+    bytes += r.bytes;
+    uncompressed += r.uncompressedBytes;
+    ms += r.ms;
+  }
+  printf("%zu textures: %.1f MB in VRAM, %.1f MB uncompressed (%.1fx), %.1f ms loading\n", textureRecords().size(),
+      bytes / (1024.0 * 1024.0), uncompressed / (1024.0 * 1024.0), bytes ? (double)uncompressed / bytes : 0.0, ms);
+}
+
+#endif
@@ -0,0 +1,305 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <future>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include "dep/glm/glm.hpp"
+
+#include "GLState.h"
+#include "DDS.h"
+#include "ThreadPool.h"
+#include "UploadRing.h"
+#include "ResourceManager.h"
+
+// Mip residency streaming for .dds textures, single or packed in texture arrays (where
+// a level is streamed for every layer at once). Textures start with only their small
+// mips resident (startSize); every frame meshes report their bounds and texel density
+// (Touch) and the streamer works out the finest level each texture needs on screen.
+// Under budgetBytes the finest levels are raised one at a time, read from the file
+// on the worker pool and uploaded through the upload ring; over budget the texture
+// drawn with the most detail gives up its top level first. Level changes fade through
+// GL_TEXTURE_MIN_LOD so neither new nor evicted mips pop.
+class TextureStreamer
+{
+  public:
+    bool enabled = true;
+    size_t budgetBytes = 32 * 1024 * 1024;
+    unsigned int startSize = 64;      // largest mip loaded up front
+    float fadeTime = 0.3f;            // seconds per mip level
+    float lodBias = 0.0f;             // added to the wanted level, > 0 saves memory
+    unsigned int maxInFlight = 4;     // concurrent level reads
+    unsigned int keepFrames = 120;    // textures not drawn for this long drop to startSize
+
+    // Once per frame, before drawing
+    void SetView(const glm::vec3& cameraPos, float fovY, float screenHeight)
+    {
+      this->cameraPos = cameraPos;
+      pixelsPerUnit = screenHeight / (2.0f * std::tan(fovY * 0.5f));
+      SetModelMatrix(glm::mat4());
+      viewSet = true;
+    }
+
+    // Transform of the meshes drawn next
+    void SetModelMatrix(const glm::mat4& m)
+    {
+      model = m;
+      scale = std::max(std::max(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1]))), glm::length(glm::vec3(m[2])));
+    }
+
+    // Take over a texture (GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY with one file per
+    // layer) whose levels [resident, levels) are uploaded
+    void Register(unsigned int texture, GLenum target, const std::vector<std::string>& paths,
+        const std::vector<size_t>& dataOffsets, const DDSImage& info, unsigned int resident)
+    {
+      Entry& e = entries[texture];
+      e.texture = texture;
+      e.bindTarget = target;
+      e.paths = paths;
+      e.dataOffsets = dataOffsets;
+      e.info = info;
+      e.info.data.clear();
+      e.start = e.resident = e.target = e.wantedLevel = resident;
+      e.lod = resident;
+    }
+
+    // Before texture is deleted; a level still being read is dropped
+    void Unregister(unsigned int texture)
+    {
+      entries.erase(texture);
+    }
+
+    // A mesh using texture is drawn: bounds (model space) and UV units per model unit
+    void Touch(unsigned int texture, const glm::vec3& center, float radius, float uvDensity)
+    {
+      if (!viewSet || uvDensity <= 0.0f)
+        return;
+      auto it = entries.find(texture);
+      if (it == entries.end())
+        return;
+      Entry& e = it->second;
+
+      glm::vec3 c = glm::vec3(model * glm::vec4(center, 1.0f));
+      float distance = std::max(glm::length(c - cameraPos) - radius * scale, 0.1f);
+      float texelsPerUnit = std::max(e.info.width, e.info.height) * uvDensity / scale;
+      float level = std::log2(texelsPerUnit * distance / pixelsPerUnit) + lodBias;
+      e.wanted = std::min(e.wanted, level);
+    }
+
+    // Render thread, once per frame
+    void Update()
+    {
+      auto now = std::chrono::high_resolution_clock::now();
+      float dt = frame ? std::chrono::duration<float>(now - lastUpdate).count() : 0.0f;
+      lastUpdate = now;
+      frame++;
+      if (entries.empty())
+        return;
+
+      // Wanted level of every texture, then trim to the budget
+      wantedBytes = 0;
+      size_t total = 0;
+      for (auto& it : entries)
+      {
+        Entry& e = it.second;
+        if (e.wanted < INFINITY)
+        {
+          e.wantedLevel = (unsigned int)std::min((float)e.start, std::max(0.0f, std::floor(e.wanted)));
+          e.lastTouch = frame;
+        }
+        else if (frame - e.lastTouch > keepFrames)
+          e.wantedLevel = e.start;
+        e.wanted = INFINITY;
+
+        e.target = enabled ? e.wantedLevel : 0;
+        wantedBytes += bytesFrom(e, e.target);
+        total += bytesFrom(e, e.target);
+      }
+
+      while (enabled && total > budgetBytes)
+      {
+        Entry* finest = nullptr;
+        for (auto& it : entries)
+        {
+          Entry& e = it.second;
+          if (e.target < e.start && (!finest || e.target < finest->target
+                || (e.target == finest->target && bytesAt(e, e.target) > bytesAt(*finest, finest->target))))
+            finest = &e;
+        }
+        if (!finest)
+          break;
+        total -= bytesAt(*finest, finest->target);
+        finest->target++;
+      }
+
+      residentBytes = 0;
+      inFlight = 0;
+      for (auto& it : entries)
+        if (it.second.loading.valid())
+          inFlight++;
+
+      for (auto& it : entries)
+      {
+        Entry& e = it.second;
+        stream(e);
+
+        // Fade towards the resident level, or one level coarser before an eviction
+        float goal = e.target > e.resident ? e.resident + 1.0f : (float)e.resident;
+        float step = fadeTime > 0.0f ? dt / fadeTime : 1.0f;
+        float lod = e.lod < goal ? std::min(goal, e.lod + step) : std::max(goal, e.lod - step);
+
+        if (e.target > e.resident && lod >= e.resident + 1.0f && !e.loading.valid())
+        {
+          // Evicted by redefining the level as empty
+          glState().BindTexture(e.bindTarget, e.texture);
+          if (e.bindTarget == GL_TEXTURE_2D_ARRAY)
+            glCompressedTexImage3D(e.bindTarget, e.resident, e.info.format, 0, 0, 0, 0, 0, NULL);
+          else
+            glCompressedTexImage2D(e.bindTarget, e.resident, e.info.format, 0, 0, 0, 0, NULL);
+          e.resident++;
+          glTexParameteri(e.bindTarget, GL_TEXTURE_BASE_LEVEL, e.resident);
+          resources().SetBytes(RESOURCE_TEXTURE, e.texture, bytesFrom(e, e.resident));
+          e.dirty = true;
+          evictions++;
+        }
+
+        if (lod != e.lod || e.dirty)
+        {
+          e.lod = lod;
+          e.dirty = false;
+          glState().BindTexture(e.bindTarget, e.texture);
+          glTexParameterf(e.bindTarget, GL_TEXTURE_MIN_LOD, std::max(0.0f, e.lod - e.resident));
+        }
+
+        residentBytes += bytesFrom(e, e.resident);
+      }
+    }
+
+    unsigned int Count() const { return entries.size(); }
+    unsigned int InFlight() const { return inFlight; }
+    size_t ResidentBytes() const { return residentBytes; }
+    size_t WantedBytes() const { return wantedBytes; }
+    unsigned int Evictions() const { return evictions; }
+
+  private:
+    struct Entry
+    {
+      unsigned int texture = 0;
+      GLenum bindTarget = GL_TEXTURE_2D;
+      std::vector<std::string> paths; // one per layer
+      std::vector<size_t> dataOffsets;
+      DDSImage info;                  // header only, same for every layer
+
+      unsigned int start = 0;       // coarsest streamed level, always resident
+      unsigned int resident = 0;    // finest level in VRAM
+      unsigned int wantedLevel = 0; // from the last frames' touches
+      unsigned int target = 0;      // wanted level after the budget
+      float wanted = INFINITY;      // touches of the current frame
+      unsigned long lastTouch = 0;
+      float lod = 0.0f;             // displayed finest level, fractional while fading
+      bool dirty = false;
+
+      std::shared_future<std::shared_ptr<std::vector<unsigned char>>> loading;
+      unsigned int loadingLevel = 0;
+    };
+
+    std::unordered_map<unsigned int, Entry> entries;
+
+    glm::vec3 cameraPos;
+    glm::mat4 model;
+    float scale = 1.0f;
+    float pixelsPerUnit = 1.0f; // at unit distance
+    bool viewSet = false;
+
+    unsigned long frame = 0;
+    std::chrono::high_resolution_clock::time_point lastUpdate;
+
+    unsigned int inFlight = 0;
+    size_t residentBytes = 0, wantedBytes = 0;
+    unsigned int evictions = 0;
+
+    static size_t bytesAt(const Entry& e, unsigned int level)
+    {
+      return (size_t)ddsLevelSize(e.info, level) * e.paths.size();
+    }
+
+    static size_t bytesFrom(const Entry& e, unsigned int level)
+    {
+      size_t bytes = 0;
+      for (unsigned int l = level; l < e.info.levels; l++)
+        bytes += ddsLevelSize(e.info, l);
+      return bytes * e.paths.size();
+    }
+
+    // Upload a finished read, or start reading the next finer level
+    void stream(Entry& e)
+    {
+      if (e.loading.valid())
+      {
+        if (e.loading.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+          return;
+
+        std::shared_ptr<std::vector<unsigned char>> data = e.loading.get();
+        if (!data)
+        {
+          // Unreadable, stop streaming this one
+          e.loading = decltype(e.loading)();
+          e.start = e.resident;
+          return;
+        }
+
+        unsigned int l = e.loadingLevel, w = std::max(1u, e.info.width >> l), h = std::max(1u, e.info.height >> l);
+        glState().BindTexture(e.bindTarget, e.texture);
+        bool uploaded = e.bindTarget == GL_TEXTURE_2D_ARRAY
+          ? uploadRing().UploadArray(l, e.info.format, w, h, e.paths.size(), data->data(), data->size())
+          : uploadRing().Upload(l, e.info.format, 0, true, w, h, data->data(), data->size());
+        if (!uploaded)
+          return; // over this frame's budget, retry next frame
+
+        e.loading = decltype(e.loading)();
+        e.resident = l;
+        glTexParameteri(e.bindTarget, GL_TEXTURE_BASE_LEVEL, e.resident);
+        resources().SetBytes(RESOURCE_TEXTURE, e.texture, bytesFrom(e, e.resident));
+        e.dirty = true;
+        return;
+      }
+
+      if (e.target >= e.resident || inFlight >= maxInFlight)
+        return;
+
+      std::vector<std::string> paths = e.paths;
+      std::vector<size_t> offsets = e.dataOffsets;
+      DDSImage info = e.info;
+      unsigned int l = e.resident - 1;
+      e.loadingLevel = l;
+      e.loading = workerPool().Submit([paths, offsets, info, l] {
+        // Layers one after the other, as glCompressedTexImage3D expects them
+        std::shared_ptr<std::vector<unsigned char>> data = std::make_shared<std::vector<unsigned char>>();
+        std::vector<unsigned char> layer;
+        for (unsigned int i = 0; i < paths.size(); i++)
+        {
+          if (!readDDSLevels(paths[i], info, offsets[i], l, l, layer))
+            return std::shared_ptr<std::vector<unsigned char>>();
+          data->insert(data->end(), layer.begin(), layer.end());
+        }
+        return data;
+      }).share();
+      inFlight++;
+    }
+};
+
+inline TextureStreamer& textureStreamer()
+{
+  static TextureStreamer streamer;
+  return streamer;
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+// Fixed-size pool of worker threads consuming a FIFO of jobs.
+// Jobs must not touch OpenGL: results are handed back to the render thread.
+class ThreadPool
+{
+  public:
+    ThreadPool(unsigned int threads = 0)
+    {
+      if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+      if (threads == 0)
+        threads = 2;
+
+      for (unsigned int i = 0; i < threads; i++)
+        workers.push_back(std::thread([this] { workerLoop(); }));
+    }
+
+    ~ThreadPool()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+      }
+      cv.notify_all();
+      for (auto& w : workers)
+        w.join();
+    }
+
+    template<class F>
+    auto Submit(F f) -> std::future<decltype(f())>
+    {
+      typedef decltype(f()) R;
+      auto task = std::make_shared<std::packaged_task<R()>>(f);
+      std::future<R> result = task->get_future();
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push([task] { (*task)(); });
+        pending++;
+      }
+      cv.notify_one();
+      return result;
+    }
+
+    // Block until every submitted job has finished
+    void WaitIdle()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      idle.wait(lock, [this] { return pending == 0; });
+    }
+
+    unsigned int Size() const { return workers.size(); }
+
+  private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::condition_variable idle;
+    unsigned int pending = 0;
+    bool stopping = false;
+
+    void workerLoop()
+    {
+      while (true)
+      {
+        std::function<void()> job;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+          if (stopping && jobs.empty())
+            return;
+          job = std::move(jobs.front());
+          jobs.pop();
+        }
+
+        job();
+
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          pending--;
+          if (pending == 0)
+            idle.notify_all();
+        }
+      }
+    }
+};
+
+// Shared pool for runtime background work (asset streaming, decoding...)
+inline ThreadPool& workerPool()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+#endif
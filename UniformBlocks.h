@@ -0,0 +1,110 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <string>
+
+#include <glad/glad.h>
+
+#include "dep/glm/glm.hpp"
+
+#include "ResourceManager.h"
+
+// std140 uniform blocks shared by the programs that declare them (ubershader, lamp,
+// shadow depth): the camera once per frame and the light when it changes. Programs get
+// the binding points by block name when they are linked (see Shader). Materials are
+// in the material table (see MaterialTable.h).
+enum UniformBlockBinding
+{
+  BLOCK_CAMERA = 0,
+  BLOCK_LIGHT,
+  BLOCK_BINDINGS
+};
+
+static GLint uniformBlockBinding(const std::string& name)
+{
+  static const char* names[BLOCK_BINDINGS] = { "Camera", "Light" };
+  for (GLint i = 0; i < BLOCK_BINDINGS; i++)
+    if (name == names[i])
+      return i;
+  return -1;
+}
+
+// Mirrors of the GLSL blocks, vec3 members padded to 16 bytes as std140 lays them out
+struct CameraBlock
+{
+  glm::mat4 projection;
+  glm::mat4 view;
+  glm::vec3 viewPos;
+  float pad0;
+};
+
+struct LightBlock
+{
+  glm::vec3 position;
+  float farPlane;     // of the shadow cubemap
+  glm::vec3 ambient;
+  float shininess;    // specular exponent, a scene wide setting (ShaderParams)
+  glm::vec3 diffuse;
+  float pad0;
+  glm::vec3 specular;
+  float pad1;
+};
+
+class UniformBlocks
+{
+  public:
+    // Once per frame, or when a pass renders with another projection
+    void SetCamera(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& viewPos)
+    {
+      CameraBlock block;
+      block.projection = projection;
+      block.view = view;
+      block.viewPos = viewPos;
+      block.pad0 = 0.0f;
+      upload(camera, BLOCK_CAMERA, &block, sizeof(block), "camera uniform block");
+    }
+
+    void SetLight(const LightBlock& block)
+    {
+      light = block;
+      upload(lightBuffer, BLOCK_LIGHT, &light, sizeof(light), "light uniform block");
+    }
+
+    // Shadow pass: only the position and range change
+    void SetLightPosition(const glm::vec3& position, float farPlane)
+    {
+      light.position = position;
+      light.farPlane = farPlane;
+      upload(lightBuffer, BLOCK_LIGHT, &light, sizeof(light), "light uniform block");
+    }
+
+  private:
+    unsigned int camera = 0, lightBuffer = 0;
+    LightBlock light = LightBlock();
+
+    static void upload(unsigned int& buffer, GLuint binding, const void* data, size_t size, const char* label)
+    {
+      if (!buffer)
+      {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, size, data, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+        resources().Add(RESOURCE_BUFFER, buffer, size, label);
+      }
+      else
+      {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+      }
+      glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+};
+
+inline UniformBlocks& uniformBlocks()
+{
+  static UniformBlocks blocks;
+  return blocks;
+}
+
+#endif
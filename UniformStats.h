@@ -0,0 +1,140 @@
+#ifndef UNIFORM_STATS_H
+#define UNIFORM_STATS_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <glad/glad.h>
+
+// Instrumentation of uniform traffic: with enabled, every Shader set call is recorded
+// per program and uniform name, and counted as wasted when it hits no active location
+// (the uniform was compiled out, or never existed), sets the value the location already
+// holds from earlier in the same frame (redundant, e.g. the same flag mesh after mesh),
+// or sets the value it kept since an earlier frame (a constant uploaded every frame).
+// The report lists the worst first.
+class UniformStats
+{
+  public:
+    bool enabled = false;
+
+    void Record(unsigned int program, const std::string& programName, GLint location, const std::string& name, const void* data, size_t size)
+    {
+      Row& row = rows[programName + '\n' + name];
+      if (!row.sets)
+      {
+        row.program = programName;
+        row.uniform = name;
+      }
+      row.sets++;
+      if (location < 0)
+      {
+        row.inactive++;
+        return;
+      }
+
+      Value& value = values[(uint64_t)program << 32 | (uint32_t)location];
+      if (value.frame && value.bytes.size() == size && memcmp(value.bytes.data(), data, size) == 0)
+      {
+        if (value.frame == frame)
+          row.repeated++;
+        else
+          row.unchanged++;
+      }
+      value.bytes.assign((const char*)data, size);
+      value.frame = frame;
+    }
+
+    // Once per frame, from the render loop
+    void EndFrame()
+    {
+      if (enabled)
+        frame++;
+    }
+
+    void Reset()
+    {
+      rows.clear();
+      values.clear();
+      frame = 1;
+    }
+
+    unsigned long Frames() const { return frame - 1; }
+
+    // Per frame averages, most wasted calls first, with what to do about them
+    void Print() const
+    {
+      std::vector<const Row*> sorted;
+      for (const auto& r : rows)
+        sorted.push_back(&r.second);
+      std::sort(sorted.begin(), sorted.end(), [](const Row* a, const Row* b) {
+        return a->wasted() != b->wasted() ? a->wasted() > b->wasted() : a->sets > b->sets;
+      });
+
+      double frames = std::max(1.0, (double)Frames());
+      unsigned long sets = 0, wasted = 0;
+      printf("%-32s %-24s %10s %10s %10s %10s  %s\n", "program", "uniform", "sets/frame", "inactive", "repeated", "unchanged", "suggestion");
+      for (const Row* r : sorted)
+      {
+        printf("%-32s %-24s %10.1f %10.1f %10.1f %10.1f  %s\n", shortName(r->program).c_str(), r->uniform.c_str(), r->sets / frames,
+            r->inactive / frames, r->repeated / frames, r->unchanged / frames, r->suggestion());
+        sets += r->sets;
+        wasted += r->wasted();
+      }
+      printf("%lu frames: %.1f uniform sets per frame, %.1f wasted (%.0f%%)\n", Frames(), sets / frames, wasted / frames,
+          sets ? 100.0 * wasted / sets : 0.0);
+    }
+
+  private:
+    struct Row
+    {
+      std::string program, uniform;
+      unsigned long sets = 0, inactive = 0, repeated = 0, unchanged = 0;
+
+      unsigned long wasted() const { return inactive + repeated + unchanged; }
+
+      const char* suggestion() const
+      {
+        if (inactive == sets)
+          return "remove, never active";
+        if (inactive)
+          return "skip where inactive (permutations)";
+        if (unchanged && unchanged + repeated + sets / 100 >= sets)
+          return "constant, set once";
+        if (repeated)
+          return "redundant, skip when current";
+        if (unchanged)
+          return "cache, often unchanged";
+        return "";
+      }
+    };
+
+    struct Value
+    {
+      std::string bytes;
+      unsigned long frame = 0;
+    };
+
+    std::unordered_map<std::string, Row> rows;           // by program and uniform name
+    std::unordered_map<uint64_t, Value> values;          // last value by program and location
+    unsigned long frame = 1;
+
+    static std::string shortName(const std::string& path)
+    {
+      size_t slash = path.find_last_of('/');
+      size_t dir = slash == std::string::npos || slash == 0 ? std::string::npos : path.find_last_of('/', slash - 1);
+      return dir == std::string::npos ? path : path.substr(dir + 1);
+    }
+};
+
+inline UniformStats& uniformStats()
+{
+  static UniformStats stats;
+  return stats;
+}
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+// Ring of pixel unpack buffers shared by every asynchronous texture upload (loader and
+// streamer, single textures and array layers). Data is copied into the next buffer whose fence has passed and the GL
+// upload reads from there; at most frameBudget bytes are accepted per frame, except
+// that a single oversized level always goes through.
+class UploadRing
+{
+  public:
+    size_t frameBudget = 8 * 1024 * 1024;
+
+    // Render thread, start of the frame
+    void BeginFrame()
+    {
+      uploadedLastFrame = uploaded;
+      uploaded = 0;
+    }
+
+    bool CanUpload(size_t size) const
+    {
+      return uploaded == 0 || uploaded + size <= frameBudget;
+    }
+
+    // Upload one level of the texture bound on GL_TEXTURE_2D, false when the budget is
+    // spent or the GPU still reads from the next buffer
+    bool Upload(unsigned int level, GLenum internalFormat, GLenum format, bool compressed,
+        unsigned int width, unsigned int height, const void* data, size_t size)
+    {
+      if (!stage(data, size))
+        return false;
+
+      if (compressed)
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0, size, 0);
+      else
+      {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+      }
+      commit(size);
+      return true;
+    }
+
+    // One level of one layer of the GL_TEXTURE_2D_ARRAY bound, whose storage exists
+    bool UploadLayer(unsigned int level, unsigned int layer, GLenum format, bool compressed,
+        unsigned int width, unsigned int height, const void* data, size_t size)
+    {
+      if (!stage(data, size))
+        return false;
+
+      if (compressed)
+        glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, format, size, 0);
+      else
+      {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, format, GL_UNSIGNED_BYTE, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+      }
+      commit(size);
+      return true;
+    }
+
+    // Define one compressed level of the bound GL_TEXTURE_2D_ARRAY, every layer at once
+    bool UploadArray(unsigned int level, GLenum internalFormat, unsigned int width, unsigned int height,
+        unsigned int layers, const void* data, size_t size)
+    {
+      if (!stage(data, size))
+        return false;
+
+      glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, width, height, layers, 0, size, 0);
+      commit(size);
+      return true;
+    }
+
+    // Compressed block into level 0 of the GL_TEXTURE_2D bound, whose storage exists
+    bool UploadRegion(unsigned int x, unsigned int y, unsigned int width, unsigned int height,
+        GLenum format, const void* data, size_t size)
+    {
+      if (!stage(data, size))
+        return false;
+
+      glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, format, size, 0);
+      commit(size);
+      return true;
+    }
+
+    size_t UploadedLastFrame() const { return uploadedLastFrame; }
+
+  private:
+    struct Slot
+    {
+      unsigned int pbo = 0;
+      GLsync fence = 0;
+    };
+
+    std::vector<Slot> ring;
+    unsigned int nextSlot = 0;
+    size_t uploaded = 0, uploadedLastFrame = 0;
+
+    // Copy data into the next free buffer and leave it bound as the unpack source
+    bool stage(const void* data, size_t size)
+    {
+      if (!CanUpload(size))
+        return false;
+
+      if (ring.empty())
+      {
+        ring.resize(4);
+        for (Slot& s : ring)
+          glGenBuffers(1, &s.pbo);
+      }
+
+      Slot& slot = ring[nextSlot];
+      if (slot.fence)
+      {
+        if (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+          return false;
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+      }
+
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+      void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+      memcpy(dst, data, size);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      return true;
+    }
+
+    // After the GL call reading the staged buffer
+    void commit(size_t size)
+    {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      ring[nextSlot].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      nextSlot = (nextSlot + 1) % ring.size();
+      uploaded += size;
+    }
+};
+
+inline UploadRing& uploadRing()
+{
+  static UploadRing ring;
+  return ring;
+}
+
+#endif
@@ -0,0 +1,406 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <future>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+
+#include <glad/glad.h>
+
+#include "dep/glm/glm.hpp"
+
+#include "GLState.h"
+#include "Shader.h"
+#include "GLExtensions.h"
+#include "ThreadPool.h"
+#include "UploadRing.h"
+#include "ResourceManager.h"
+#include "VirtualTexturePack.h"
+
+// Software virtual texturing over a cooked pack (cooker --vt, see VirtualTextureBuilder).
+// Only the pages the camera actually sees are kept in VRAM, in a fixed cache texture of
+// cacheSide x cacheSide pages. A feedback pass renders the scene at a fraction of the
+// resolution writing the page and mip every pixel wants; it is read back through a
+// pixel pack buffer a couple of frames later, missing pages are read from the pack on
+// the worker pool (coarse first) and copied into free or least recently used cache
+// slots. The indirection texture maps every virtual page of every mip to the cache slot
+// of the finest resident page covering it, which is what the ubershader samples through.
+class VirtualTexture
+{
+  public:
+    unsigned int cacheSide = 16;      // pages per side of the physical cache
+    unsigned int feedbackDivisor = 8; // feedback resolution is the screen's over this
+    unsigned int maxInFlight = 8;     // concurrent page reads
+
+    bool Open(const std::string& packPath)
+    {
+      if (!readVirtualTexturePack(packPath, pack))
+        return false;
+      path = packPath;
+
+      for (const VTTexture& t : pack.textures)
+        regions[t.path] = glm::vec4(t.x, t.y, t.w, t.h) / (float)pack.pages;
+
+      // Physical cache, BC1 like the pages so they are copied as they are
+      cacheTexels = cacheSide * VT_PAGE_TEXELS;
+      glGenTextures(1, &cache);
+      glState().BindTexture(GL_TEXTURE_2D, cache);
+      glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, cacheTexels, cacheTexels, 0,
+          (cacheTexels / 4) * (cacheTexels / 4) * 8, NULL);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      slots.assign(cacheSide * cacheSide, Slot());
+      resources().Add(RESOURCE_TEXTURE, cache, (cacheTexels / 4) * (cacheTexels / 4) * 8, "virtual texture cache");
+
+      // Indirection: one texel per virtual page and mip, rgb = cache slot x, y and the
+      // mip of the page found there (coarser than asked while the right one loads)
+      glGenTextures(1, &indirection);
+      glState().BindTexture(GL_TEXTURE_2D, indirection);
+      for (unsigned int m = 0; m < pack.mips; m++)
+        glTexImage2D(GL_TEXTURE_2D, m, GL_RGBA8, pack.pages >> m, pack.pages >> m, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, pack.mips - 1);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      resources().Add(RESOURCE_TEXTURE, indirection, pack.pages * pack.pages * 4 * 4 / 3, "virtual texture indirection");
+
+      // The single page of the coarsest mip always stays, so every lookup finds something
+      unsigned int root = key(pack.mips - 1, 0, 0);
+      std::shared_ptr<std::vector<unsigned char>> data = readPage(path, pack, pack.pageIndex[pack.mips - 1][0]);
+      if (!data)
+      {
+        std::cout << "Cannot read virtual texture " << path << std::endl;
+        return false;
+      }
+      glState().BindTexture(GL_TEXTURE_2D, cache);
+      glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, VT_PAGE_TEXELS, VT_PAGE_TEXELS,
+          GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, data->size(), data->data());
+      slots[0].page = root;
+      slots[0].pinned = true;
+      resident[root] = 0;
+      dirty = true;
+      updateIndirection();
+
+      std::cout << "Virtual texture " << path << ": " << pack.textures.size() << " textures, "
+        << pack.pages << "x" << pack.pages << " pages, " << cacheSide * cacheSide << " page cache" << std::endl;
+      return true;
+    }
+
+    bool IsOpen() const { return cache != 0; }
+
+    // Virtual region (xy offset, zw size, in [0, 1]) of a texture, nullptr when not packed
+    const glm::vec4* Region(const std::string& texPath) const
+    {
+      auto it = regions.find(texPath);
+      return it != regions.end() ? &it->second : nullptr;
+    }
+
+    // Cache on unit 5, indirection on unit 6 (see Scene::SetSamplerUnits)
+    void Bind(const Shader& shader) const
+    {
+      glState().BindTexture(5, GL_TEXTURE_2D, cache);
+      glState().BindTexture(6, GL_TEXTURE_2D, indirection);
+      shader.setVec4("vtParams", glm::vec4(pack.pages, pack.mips, VT_PAGE_SIZE, VT_BORDER));
+      shader.setFloat("vtCacheTexels", (float)cacheTexels);
+    }
+
+    // Render the feedback pass between these two (with res/shaders/vt/feedback.fs)
+    void BeginFeedback(unsigned int width, unsigned int height)
+    {
+      unsigned int w = std::max(1u, width / feedbackDivisor), h = std::max(1u, height / feedbackDivisor);
+      if (w != feedbackWidth || h != feedbackHeight)
+        createFeedbackTarget(w, h);
+
+      glState().BindFramebuffer(GL_FRAMEBUFFER, fbo);
+      glState().Viewport(0, 0, feedbackWidth, feedbackHeight);
+      glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // Derivatives are feedbackDivisor times larger in the feedback pass
+    float FeedbackMipBias() const { return -std::log2((float)feedbackDivisor); }
+
+    void EndFeedback(unsigned int width, unsigned int height)
+    {
+      // Read back asynchronously unless the previous frames' copies are all pending
+      Readback& r = readbacks[nextReadback];
+      if (!r.fence)
+      {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, r.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, feedbackWidth * feedbackHeight * 4, NULL, GL_STREAM_READ);
+        glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        r.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        r.size = feedbackWidth * feedbackHeight * 4;
+        nextReadback = (nextReadback + 1) % 2;
+      }
+
+      glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
+      glState().Viewport(0, 0, width, height);
+      glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    }
+
+    // Render thread, once per frame
+    void Update()
+    {
+      if (!cache)
+        return;
+      frame++;
+
+      // Oldest readback first
+      for (unsigned int i = 0; i < 2; i++)
+      {
+        Readback& r = readbacks[(nextReadback + i) % 2];
+        if (!r.fence || glClientWaitSync(r.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+          continue;
+        glDeleteSync(r.fence);
+        r.fence = 0;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, r.pbo);
+        const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, r.size, GL_MAP_READ_BIT);
+        if (pixels)
+          parseFeedback(pixels, r.size / 4);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      }
+
+      // Finished reads into the cache, then new reads for what is still missing
+      for (auto it = loading.begin(); it != loading.end();)
+      {
+        if (it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+          ++it;
+          continue;
+        }
+        std::shared_ptr<std::vector<unsigned char>> data = it->second.get();
+        if (data && !upload(it->first, *data))
+        {
+          ++it; // no room this frame, retry
+          continue;
+        }
+        it = loading.erase(it);
+      }
+
+      for (unsigned int page : missing)
+      {
+        if (loading.size() >= maxInFlight)
+          break;
+        if (resident.count(page) || loading.count(page))
+          continue;
+        unsigned int m = page >> 16, x = page & 0xff, y = (page >> 8) & 0xff;
+        uint32_t index = pack.pageIndex[m][y * (pack.pages >> m) + x];
+        std::string file = path;
+        VTPack info;
+        info.pageBytes = pack.pageBytes;
+        info.dataOffset = pack.dataOffset;
+        loading[page] = workerPool().Submit([file, info, index] {
+          return readPage(file, info, index);
+        }).share();
+        requests++;
+      }
+
+      if (dirty)
+        updateIndirection();
+    }
+
+    unsigned int ResidentPages() const { return resident.size(); }
+    unsigned int Capacity() const { return slots.size(); }
+    unsigned int InFlight() const { return loading.size(); }
+    unsigned int Requests() const { return requests; }
+    unsigned int Missing() const { return missing.size(); }
+
+  private:
+    struct Slot
+    {
+      unsigned int page = NO_SLOT;
+      unsigned long lastUsed = 0;
+      bool pinned = false;
+    };
+
+    struct Readback
+    {
+      unsigned int pbo = 0;
+      GLsync fence = 0;
+      size_t size = 0;
+    };
+
+    static const unsigned int NO_SLOT = 0xffffffff;
+
+    std::string path;
+    VTPack pack;
+    std::unordered_map<std::string, glm::vec4> regions;
+
+    unsigned int cache = 0, indirection = 0, cacheTexels = 0;
+    std::vector<Slot> slots;
+    std::unordered_map<unsigned int, unsigned int> resident; // page key -> slot
+    bool dirty = false;
+
+    unsigned int fbo = 0, colorBuffer = 0, depthBuffer = 0;
+    unsigned int feedbackWidth = 0, feedbackHeight = 0;
+    Readback readbacks[2];
+    unsigned int nextReadback = 0;
+
+    std::vector<unsigned int> missing; // from the last feedback, coarse first
+    std::unordered_map<unsigned int, std::shared_future<std::shared_ptr<std::vector<unsigned char>>>> loading;
+    unsigned long frame = 0, feedbackFrame = 0;
+    unsigned int requests = 0;
+
+    static unsigned int key(unsigned int mip, unsigned int x, unsigned int y)
+    {
+      return mip << 16 | y << 8 | x;
+    }
+
+    static std::shared_ptr<std::vector<unsigned char>> readPage(const std::string& file, const VTPack& info, uint32_t index)
+    {
+      std::ifstream in(file, std::ifstream::binary);
+      in.seekg(info.dataOffset + (size_t)index * info.pageBytes);
+      std::shared_ptr<std::vector<unsigned char>> data = std::make_shared<std::vector<unsigned char>>(info.pageBytes);
+      in.read((char*)data->data(), info.pageBytes);
+      if (!in)
+        return std::shared_ptr<std::vector<unsigned char>>();
+      return data;
+    }
+
+    void createFeedbackTarget(unsigned int w, unsigned int h)
+    {
+      if (!fbo)
+      {
+        glGenFramebuffers(1, &fbo);
+        glGenTextures(1, &colorBuffer);
+        glGenRenderbuffers(1, &depthBuffer);
+        for (Readback& r : readbacks)
+          glGenBuffers(1, &r.pbo);
+      }
+      feedbackWidth = w;
+      feedbackHeight = h;
+
+      glState().BindTexture(GL_TEXTURE_2D, colorBuffer);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+      glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+
+      glState().BindFramebuffer(GL_FRAMEBUFFER, fbo);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorBuffer, 0);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+      if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: Virtual texture feedback framebuffer is not complete!" << std::endl;
+      glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // Pixels are (page x, page y, mip, 255) where a virtual texture was drawn
+    void parseFeedback(const unsigned char* pixels, size_t count)
+    {
+      std::vector<unsigned int> wanted;
+      for (size_t i = 0; i < count; i++)
+      {
+        const unsigned char* p = pixels + i * 4;
+        if (p[3] != 255)
+          continue;
+        unsigned int m = std::min((unsigned int)p[2], pack.mips - 1), x = p[0], y = p[1];
+        // The coarser pages covering it are wanted too, they are the fallback
+        for (; m < pack.mips; m++, x /= 2, y /= 2)
+        {
+          unsigned int side = pack.pages >> m;
+          if (x >= side || y >= side || pack.pageIndex[m][y * side + x] == VT_NO_PAGE)
+            break;
+          wanted.push_back(key(m, x, y));
+        }
+      }
+      std::sort(wanted.begin(), wanted.end(), std::greater<unsigned int>()); // coarse first
+      wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+
+      feedbackFrame = frame;
+      missing.clear();
+      for (unsigned int page : wanted)
+      {
+        auto it = resident.find(page);
+        if (it != resident.end())
+          slots[it->second].lastUsed = frame;
+        else
+          missing.push_back(page);
+      }
+    }
+
+    // Into a free slot, or the least recently used one not seen in the last feedback
+    bool upload(unsigned int page, const std::vector<unsigned char>& data)
+    {
+      unsigned int best = NO_SLOT;
+      for (unsigned int i = 0; i < slots.size(); i++)
+      {
+        const Slot& s = slots[i];
+        if (s.pinned || (s.page != NO_SLOT && s.lastUsed == feedbackFrame))
+          continue;
+        if (best == NO_SLOT || s.page == NO_SLOT || s.lastUsed < slots[best].lastUsed)
+          best = i;
+        if (s.page == NO_SLOT)
+          break;
+      }
+      if (best == NO_SLOT)
+        return true; // cache full of visible pages, drop the request
+
+      unsigned int x = best % cacheSide, y = best / cacheSide;
+      glState().BindTexture(GL_TEXTURE_2D, cache);
+      if (!uploadRing().UploadRegion(x * VT_PAGE_TEXELS, y * VT_PAGE_TEXELS, VT_PAGE_TEXELS, VT_PAGE_TEXELS,
+            GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, data.data(), data.size()))
+        return false;
+
+      Slot& s = slots[best];
+      if (s.page != NO_SLOT)
+        resident.erase(s.page);
+      s.page = page;
+      s.lastUsed = frame;
+      resident[page] = best;
+      dirty = true;
+      return true;
+    }
+
+    // Coarse to fine, every page points at its own slot or inherits its parent's entry
+    void updateIndirection()
+    {
+      std::vector<unsigned char> parent, level;
+      glState().BindTexture(GL_TEXTURE_2D, indirection);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      for (int m = pack.mips - 1; m >= 0; m--)
+      {
+        unsigned int side = pack.pages >> m;
+        level.assign(side * side * 4, 0);
+        for (unsigned int y = 0; y < side; y++)
+          for (unsigned int x = 0; x < side; x++)
+          {
+            unsigned char* e = &level[(y * side + x) * 4];
+            auto it = resident.find(key(m, x, y));
+            if (it != resident.end())
+            {
+              e[0] = it->second % cacheSide;
+              e[1] = it->second / cacheSide;
+              e[2] = m;
+              e[3] = 255;
+            }
+            else if (!parent.empty())
+              memcpy(e, &parent[((y / 2) * (side / 2) + x / 2) * 4], 4);
+          }
+        glTexSubImage2D(GL_TEXTURE_2D, m, 0, 0, side, side, GL_RGBA, GL_UNSIGNED_BYTE, level.data());
+        parent.swap(level);
+      }
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+      dirty = false;
+    }
+};
+
+inline VirtualTexture& virtualTexture()
+{
+  static VirtualTexture vt;
+  return vt;
+}
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef VIRTUAL_TEXTURE_BUILDER_H
+#define VIRTUAL_TEXTURE_BUILDER_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "dep/stb_image/stb_image.h"
+
+#include "MipChain.h"
+#include "BCEncoder.h"
+#include "VirtualTexturePack.h"
+
+static unsigned int nextPowerOfTwo(unsigned int v)
+{
+  unsigned int p = 1;
+  while (p < v)
+    p *= 2;
+  return p;
+}
+
+// Shelf packing of power of two regions, tallest first. Every region ends up aligned
+// to its own size, so it stays page aligned down the mips while it covers a page.
+static bool layoutVirtualTexture(std::vector<VTTexture>& textures, unsigned int pages)
+{
+  std::vector<unsigned int> order(textures.size());
+  for (unsigned int i = 0; i < order.size(); i++)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&textures](unsigned int a, unsigned int b) {
+    return textures[a].h != textures[b].h ? textures[a].h > textures[b].h : textures[a].w > textures[b].w;
+  });
+
+  unsigned int x = 0, y = 0, shelf = 0;
+  for (unsigned int i : order)
+  {
+    VTTexture& t = textures[i];
+    if (x + t.w > pages)
+    {
+      x = 0;
+      y += shelf;
+      shelf = 0;
+    }
+    if (t.w > pages || y + t.h > pages)
+      return false;
+    t.x = x;
+    t.y = y;
+    x += t.w;
+    shelf = std::max(shelf, t.h);
+  }
+  return true;
+}
+
+// Pack the given images (their own paths are stored as the lookup keys)
+static bool buildVirtualTexturePack(const std::vector<std::string>& paths, const std::string& output, std::string& report)
+{
+  std::vector<VTTexture> textures;
+  std::vector<std::vector<MipImage>> chains;
+  unsigned int area = 0;
+  for (const std::string& path : paths)
+  {
+    MipImage img;
+    int n;
+    unsigned char* data = stbi_load(path.c_str(), &img.width, &img.height, &n, 4);
+    if (!data)
+    {
+      std::cerr << "Cannot read " << path << std::endl;
+      continue;
+    }
+    img.rgba.assign(data, data + (size_t)img.width * img.height * 4);
+    stbi_image_free(data);
+
+    int w = std::max(VT_PAGE_SIZE, nextPowerOfTwo(img.width)), h = std::max(VT_PAGE_SIZE, nextPowerOfTwo(img.height));
+    if (w != img.width || h != img.height)
+      img = resizeImage(img, w, h);
+
+    VTTexture t = { path, 0, 0, w / VT_PAGE_SIZE, h / VT_PAGE_SIZE };
+    textures.push_back(t);
+    chains.push_back(std::vector<MipImage>());
+    buildMipChain(img, MIP_SRGB, chains.back());
+    area += t.w * t.h;
+  }
+  if (textures.empty())
+    return false;
+
+  // Smallest power of two square that fits, page coordinates are stored in 8 bits
+  VTPack pack;
+  pack.pages = nextPowerOfTwo((unsigned int)std::ceil(std::sqrt((float)area)));
+  while (!layoutVirtualTexture(textures, pack.pages))
+    pack.pages *= 2;
+  if (pack.pages > 256)
+  {
+    std::cerr << "Too many textures for one virtual texture in " << output << std::endl;
+    return false;
+  }
+  pack.textures = textures;
+  pack.mips = 1 + (uint32_t)std::log2((float)pack.pages);
+  pack.pageBytes = (VT_PAGE_TEXELS / 4) * (VT_PAGE_TEXELS / 4) * 8;
+
+  // Texture owning each mip 0 page
+  std::vector<int> owner(pack.pages * pack.pages, -1);
+  for (unsigned int i = 0; i < textures.size(); i++)
+    for (unsigned int y = 0; y < textures[i].h; y++)
+      for (unsigned int x = 0; x < textures[i].w; x++)
+        owner[(textures[i].y + y) * pack.pages + textures[i].x + x] = i;
+
+  std::vector<unsigned char> pageData;
+  std::vector<uint8_t> page(VT_PAGE_TEXELS * VT_PAGE_TEXELS * 4);
+  pack.pageIndex.resize(pack.mips);
+  uint32_t count = 0;
+  for (unsigned int m = 0; m < pack.mips; m++)
+  {
+    unsigned int side = pack.pages >> m;
+    pack.pageIndex[m].assign(side * side, VT_NO_PAGE);
+    for (unsigned int py = 0; py < side; py++)
+      for (unsigned int px = 0; px < side; px++)
+      {
+        bool used = false;
+        for (unsigned int y = py << m; y < (py + 1) << m && !used; y++)
+          for (unsigned int x = px << m; x < (px + 1) << m && !used; x++)
+            used = owner[y * pack.pages + x] >= 0;
+        if (!used)
+          continue;
+
+        // Texels of the page plus border at mip m; the owner is looked up inside the
+        // page, the texel itself wraps around that texture
+        for (unsigned int j = 0; j < VT_PAGE_TEXELS; j++)
+          for (unsigned int i = 0; i < VT_PAGE_TEXELS; i++)
+          {
+            int vx = (int)(px * VT_PAGE_SIZE + i) - (int)VT_BORDER, vy = (int)(py * VT_PAGE_SIZE + j) - (int)VT_BORDER;
+            int cx = std::min(std::max(vx, (int)(px * VT_PAGE_SIZE)), (int)((px + 1) * VT_PAGE_SIZE - 1));
+            int cy = std::min(std::max(vy, (int)(py * VT_PAGE_SIZE)), (int)((py + 1) * VT_PAGE_SIZE - 1));
+            int t = owner[((cy << m) / VT_PAGE_SIZE) * pack.pages + (cx << m) / VT_PAGE_SIZE];
+            uint8_t* dst = &page[(j * VT_PAGE_TEXELS + i) * 4];
+            if (t < 0)
+            {
+              dst[0] = dst[1] = dst[2] = 0;
+              dst[3] = 255;
+              continue;
+            }
+
+            const MipImage& level = chains[t][std::min((size_t)m, chains[t].size() - 1)];
+            int lx = vx - (int)((textures[t].x * VT_PAGE_SIZE) >> m), ly = vy - (int)((textures[t].y * VT_PAGE_SIZE) >> m);
+            lx = ((lx % level.width) + level.width) % level.width;
+            ly = ((ly % level.height) + level.height) % level.height;
+            memcpy(dst, &level.rgba[((size_t)ly * level.width + lx) * 4], 4);
+          }
+
+        uint8_t block[64], out[8];
+        for (unsigned int by = 0; by < VT_PAGE_TEXELS; by += 4)
+          for (unsigned int bx = 0; bx < VT_PAGE_TEXELS; bx += 4)
+          {
+            for (unsigned int r = 0; r < 4; r++)
+              memcpy(&block[r * 16], &page[((by + r) * VT_PAGE_TEXELS + bx) * 4], 16);
+            encodeBC1Block(block, out);
+            pageData.insert(pageData.end(), out, out + 8);
+          }
+        pack.pageIndex[m][py * side + px] = count++;
+      }
+  }
+
+  std::ofstream out(output, std::ofstream::binary);
+  if (!out)
+  {
+    std::cerr << "Cannot write " << output << std::endl;
+    return false;
+  }
+  uint32_t header[6] = { VT_MAGIC, VT_VERSION, pack.pages, pack.mips, pack.pageBytes, (uint32_t)textures.size() };
+  out.write((const char*)header, sizeof(header));
+  for (const VTTexture& t : textures)
+  {
+    uint32_t length = t.path.size();
+    out.write((const char*)&length, sizeof(length));
+    out.write(t.path.data(), length);
+    out.write((const char*)&t.x, sizeof(uint32_t) * 4);
+  }
+  for (const std::vector<uint32_t>& index : pack.pageIndex)
+    out.write((const char*)index.data(), index.size() * sizeof(uint32_t));
+  out.write((const char*)pageData.data(), pageData.size());
+
+  char buffer[128];
+  snprintf(buffer, sizeof(buffer), "%u textures, %ux%u pages, %u mips, %u pages stored (%.1f MB)",
+      (unsigned int)textures.size(), pack.pages, pack.pages, pack.mips, count, pageData.size() / (1024.0f * 1024.0f));
+  report = buffer;
+  return (bool)out;
+}
+
+#endif
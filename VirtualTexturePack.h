@@ -0,0 +1,84 @@
+#ifndef VIRTUAL_TEXTURE_PACK_H
+#define VIRTUAL_TEXTURE_PACK_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+
+// Virtual texture pack (.vt): the diffuse maps of a material library laid out side by
+// side in one large virtual texture, cut into fixed size pages for every mip level.
+// Pages carry a border of neighbouring texels (wrapped within their texture, as the
+// materials repeat) so bilinear filtering works inside a page, and are stored BC1
+// compressed so they can be copied into the physical page cache as they are.
+//
+// [header][textures: path, region][page index per mip, row order][pages]
+const uint32_t VT_MAGIC = 0x58455456; // "VTEX"
+const uint32_t VT_VERSION = 1;
+const unsigned int VT_PAGE_SIZE = 128; // texels per page side, without the border
+const unsigned int VT_BORDER = 4;
+const unsigned int VT_PAGE_TEXELS = VT_PAGE_SIZE + 2 * VT_BORDER;
+const uint32_t VT_NO_PAGE = 0xffffffff;
+
+struct VTTexture
+{
+  std::string path;        // as referenced by the material
+  uint32_t x, y, w, h;     // region in mip 0 pages
+};
+
+struct VTPack
+{
+  uint32_t pages = 0;      // virtual size in pages at mip 0 (power of two)
+  uint32_t mips = 0;       // down to a single page
+  uint32_t pageBytes = 0;
+  std::vector<VTTexture> textures;
+  std::vector<std::vector<uint32_t>> pageIndex; // per mip, VT_NO_PAGE where nothing is mapped
+  size_t dataOffset = 0;   // of page 0 in the file
+};
+
+inline std::string virtualTexturePath(const std::string& mtlPath)
+{
+  return mtlPath.substr(0, mtlPath.find_last_of('.')) + ".vt";
+}
+
+// Everything but the pages, which are read on demand
+inline bool readVirtualTexturePack(const std::string& path, VTPack& pack)
+{
+  std::ifstream in(path, std::ifstream::binary);
+  if (!in)
+    return false;
+
+  uint32_t header[6];
+  in.read((char*)header, sizeof(header));
+  if (!in || header[0] != VT_MAGIC || header[1] != VT_VERSION)
+  {
+    std::cout << "Ignoring outdated virtual texture " << path << std::endl;
+    return false;
+  }
+
+  pack.pages = header[2];
+  pack.mips = header[3];
+  pack.pageBytes = header[4];
+  pack.textures.resize(header[5]);
+  for (VTTexture& t : pack.textures)
+  {
+    uint32_t length = 0;
+    in.read((char*)&length, sizeof(length));
+    t.path.resize(length);
+    in.read(&t.path[0], length);
+    in.read((char*)&t.x, sizeof(uint32_t) * 4);
+  }
+
+  pack.pageIndex.resize(pack.mips);
+  for (unsigned int m = 0; m < pack.mips; m++)
+  {
+    unsigned int side = pack.pages >> m;
+    pack.pageIndex[m].resize(side * side);
+    in.read((char*)pack.pageIndex[m].data(), side * side * sizeof(uint32_t));
+  }
+  pack.dataOffset = in.tellg();
+  return (bool)in;
+}
+
+#endif
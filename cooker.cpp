@@ -0,0 +1,299 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstring>
+
+#include <dirent.h>
+
+#include "AssetCooker.h"
+#include "CookedMesh.h"
+#include "ChunkedModel.h"
+#include "HLODBuilder.h"
+#include "TextureCooker.h"
+#include "VirtualTextureBuilder.h"
+
+// Offline asset cooker: builds the dependency graph of the given models (or every
+// OBJ under res/models) and rebuilds only the outputs whose inputs changed.
+//
+//   ./cooker [-f] [-j threads] [--graph] [--chunk cellSize] [--hlod clusterSize] [--vt] [model.obj ...]
+//
+// --chunk also partitions each model into spatial cells of the given size for
+// out-of-core streaming (see StreamedModel).
+// --hlod builds merged, simplified cluster proxies for distant views (see HLOD).
+// --vt packs the diffuse maps of each material library into a virtual texture
+// (see VirtualTexture).
+//
+// Textures referenced by the models, and the images in res/textures, are block
+// compressed into .dds files next to them (see TextureCooker.h). Skyboxes in
+// res/skyboxes (base_ft.tga ... base_lf.tga) become one cubemap base.dds each.
+// Masks and specular maps are also packed into the alpha of their diffuse map
+// (diffuse+mask.dds, see ChannelPack.h).
+
+static void findFiles(const std::string& dir, const std::string& ext, std::vector<std::string>& files)
+{
+  DIR* d = opendir(dir.c_str());
+  if (!d)
+    return;
+
+  while (struct dirent* e = readdir(d))
+  {
+    std::string name = e->d_name;
+    if (name == "." || name == "..")
+      continue;
+
+    std::string path = dir + "/" + name;
+    if (e->d_type == DT_DIR)
+      findFiles(path, ext, files);
+    else if (name.size() > ext.size() && name.substr(name.size() - ext.size()) == ext)
+      files.push_back(path);
+  }
+  closedir(d);
+}
+
+static void findImages(const std::string& dir, std::vector<std::string>& images)
+{
+  DIR* d = opendir(dir.c_str());
+  if (!d)
+    return;
+
+  while (struct dirent* e = readdir(d))
+  {
+    std::string name = e->d_name;
+    std::string ext = name.substr(name.find_last_of('.') + 1);
+    // Heightmaps are read back as data, block compression would terrace them
+    if (e->d_type != DT_DIR && (ext == "png" || ext == "jpg" || ext == "tga") && name.find("heightmap") == std::string::npos)
+      images.push_back(dir + "/" + name);
+  }
+  closedir(d);
+}
+
+static bool cookMesh(const CookJob& job)
+{
+  std::vector<MeshData> meshes;
+  OBJImporter importer;
+  if (!importer.importOBJ(job.inputs[0].c_str(), meshes))
+    return false;
+  return writeCookedMeshes(job.output, meshes);
+}
+
+static bool cookChunks(const CookJob& job)
+{
+  std::vector<MeshData> meshes;
+  OBJImporter importer;
+  if (!importer.importOBJ(job.inputs[0].c_str(), meshes))
+    return false;
+  return writeChunkedModel(job.output, meshes, std::stof(job.params));
+}
+
+static bool cookHLOD(const CookJob& job)
+{
+  std::vector<MeshData> meshes;
+  OBJImporter importer;
+  if (!importer.importOBJ(job.inputs[0].c_str(), meshes))
+    return false;
+
+  HLODData hlod;
+  buildHLOD(meshes, std::stof(job.params), 16, hlod);
+  return writeHLOD(job.output, hlod);
+}
+
+// Diffuse maps of a material library, sorted
+static std::vector<std::string> diffuseMaps(const std::string& mtlPath)
+{
+  std::unordered_map<std::string, Material> materials;
+  OBJImporter importer;
+  importer.importMtl(mtlPath.c_str(), materials);
+
+  std::vector<std::string> maps;
+  for (auto& m : materials)
+  {
+    struct stat st;
+    if (!m.second.texPath.empty() && stat(m.second.texPath.c_str(), &st) == 0)
+      maps.push_back(m.second.texPath);
+  }
+  std::sort(maps.begin(), maps.end());
+  maps.erase(std::unique(maps.begin(), maps.end()), maps.end());
+  return maps;
+}
+
+// Packed diffuse + mask or specular images of a material library (see ChannelPack.h)
+static std::vector<std::string> packedMaps(const std::string& mtlPath)
+{
+  std::unordered_map<std::string, Material> materials;
+  OBJImporter importer;
+  importer.importMtl(mtlPath.c_str(), materials);
+
+  std::vector<std::string> maps;
+  for (auto& m : materials)
+  {
+    PackedAlpha usage;
+    std::string packed = packedTexturePath(m.second.texPath, packedAlphaMap(m.second.maskPath, m.second.specularPath, usage));
+    if (!packed.empty())
+      maps.push_back(packed);
+  }
+  std::sort(maps.begin(), maps.end());
+  maps.erase(std::unique(maps.begin(), maps.end()), maps.end());
+  return maps;
+}
+
+static bool cookVirtualTexture(CookJob& job)
+{
+  return buildVirtualTexturePack(diffuseMaps(job.inputs[0]), job.output, job.report);
+}
+
+static bool cookTextureJob(CookJob& job)
+{
+  return cookTexture(job.inputs[0], job.output, job.params, job.report);
+}
+
+static bool cookPackedJob(CookJob& job)
+{
+  return cookPackedTexture(job.params, job.output, job.report);
+}
+
+static bool cookCubemapJob(CookJob& job)
+{
+  return cookCubemap(job.inputs, job.output, job.report);
+}
+
+int main(int argc, char** argv)
+{
+  bool force = false;
+  bool graph = false;
+  bool virtualTextures = false;
+  unsigned int threads = 0;
+  std::string cellSize;
+  std::string clusterSize;
+  std::vector<std::string> models;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-f"))
+      force = true;
+    else if (!strcmp(argv[i], "--graph"))
+      graph = true;
+    else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+      threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--chunk") && i + 1 < argc)
+      cellSize = argv[++i];
+    else if (!strcmp(argv[i], "--hlod") && i + 1 < argc)
+      clusterSize = argv[++i];
+    else if (!strcmp(argv[i], "--vt"))
+      virtualTextures = true;
+    else
+      models.push_back(argv[i]);
+  }
+
+  // Material libraries are scanned on their own too, some ship without their OBJ
+  std::vector<std::string> materials;
+  if (models.empty())
+  {
+    findFiles("res/models", ".obj", models);
+    findFiles("res/models", ".mtl", materials);
+  }
+
+  AssetCooker cooker("res/cooked.manifest");
+  cooker.AddRule({ "mesh", COOKED_MESH_VERSION, cookMesh });
+  cooker.AddRule({ "chunks", CHUNKED_MODEL_VERSION, cookChunks });
+  cooker.AddRule({ "hlod", HLOD_VERSION, cookHLOD });
+  cooker.AddRule({ "texture", TEXTURE_COOK_VERSION, cookTextureJob });
+  cooker.AddRule({ "vt", VT_VERSION, cookVirtualTexture });
+  cooker.AddRule({ "cubemap", CUBEMAP_COOK_VERSION, cookCubemapJob });
+  cooker.AddRule({ "packed", PACKED_COOK_VERSION, cookPackedJob });
+
+  for (const std::string& model : models)
+  {
+    std::vector<std::string> inputs = cooker.ScanModel(model);
+    cooker.AddJob("mesh", cookedMeshPath(model), inputs);
+    if (!cellSize.empty())
+      cooker.AddJob("chunks", chunkedModelPath(model), inputs, cellSize);
+    if (!clusterSize.empty())
+    {
+      // The atlas is baked from the diffuse maps, they are inputs too
+      std::vector<std::string> hlodInputs = inputs;
+      for (const std::string& t : cooker.ModelTextures(model))
+        hlodInputs.push_back(t);
+      cooker.AddJob("hlod", hlodPath(model), hlodInputs, clusterSize);
+    }
+  }
+
+  for (const std::string& mtl : materials)
+    cooker.ScanMtl(mtl);
+
+  // Every material library, of the models and scanned
+  for (const std::string& model : models)
+    if (const AssetNode* node = cooker.Node(model))
+      materials.insert(materials.end(), node->deps.begin(), node->deps.end());
+  std::sort(materials.begin(), materials.end());
+  materials.erase(std::unique(materials.begin(), materials.end()), materials.end());
+
+  for (const std::string& mtl : materials)
+    for (const std::string& packed : packedMaps(mtl))
+    {
+      std::string diffusePath, alphaPath;
+      splitPackedTexturePath(packed, diffusePath, alphaPath);
+      cooker.AddJob("packed", ddsPath(packed), { diffusePath, alphaPath }, packed);
+    }
+
+  if (virtualTextures)
+  {
+    for (const std::string& mtl : materials)
+    {
+      std::vector<std::string> inputs = diffuseMaps(mtl);
+      if (inputs.empty())
+        continue;
+      inputs.insert(inputs.begin(), mtl);
+      cooker.AddJob("vt", virtualTexturePath(mtl), inputs);
+    }
+  }
+
+  std::vector<std::string> textures = cooker.Textures();
+  findImages("res/textures", textures);
+  std::sort(textures.begin(), textures.end());
+  textures.erase(std::unique(textures.begin(), textures.end()), textures.end());
+  for (const std::string& texture : textures)
+  {
+    // Some models ship hand made .dds files, leave those alone
+    std::string dds = ddsPath(texture);
+    struct stat st;
+    if (stat(dds.c_str(), &st) == 0 && !cooker.IsCookedOutput(dds))
+      continue;
+    if (stat(texture.c_str(), &st) != 0)
+      continue;
+
+    const AssetNode* node = cooker.Node(texture);
+    cooker.AddJob("texture", dds, { texture }, textureUsage(texture, node ? node->mtlKey : ""));
+  }
+
+  std::vector<std::string> skyboxes;
+  findFiles("res/skyboxes", "_ft.tga", skyboxes);
+  for (const std::string& front : skyboxes)
+  {
+    std::string base = front.substr(0, front.size() - strlen("_ft.tga"));
+    cooker.AddJob("cubemap", base + ".dds", cubemapFaces(base));
+  }
+
+  ThreadPool pool(threads);
+  bool ok = cooker.Cook(pool, force);
+
+  if (graph)
+    cooker.PrintGraph();
+  cooker.PrintSummary();
+
+  bool header = false;
+  for (const CookJob& job : cooker.Jobs())
+  {
+    if ((job.rule != "texture" && job.rule != "cubemap" && job.rule != "packed") || job.report.empty())
+      continue;
+    if (!header)
+      printf("\n%-70s %8s  %s\n", "texture", "ms", "encoding");
+    header = true;
+    printf("%-70s %8.1f  %s\n", job.output.c_str(), job.ms, job.report.c_str());
+  }
+
+  for (const CookJob& job : cooker.Jobs())
+    if (job.rule == "vt" && !job.report.empty())
+      printf("\nvirtual texture %s: %s (%.1f ms)\n", job.output.c_str(), job.report.c_str(), job.ms);
+
+  return ok ? 0 : 1;
+}
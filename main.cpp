@@ -45,6 +45,7 @@ int main()
     std::cout << "Failed to initialize GLAD" << std::endl;
     return -1;
   }
+  loadGLExtensions((GLADloadproc)glfwGetProcAddress);
 
   //StencilScene scene(window, SCR_WIDTH, SCR_HEIGHT);
   //FBOScene scene(window, SCR_WIDTH, SCR_HEIGHT);
@@ -61,7 +62,20 @@ int main()
   // -----------
   while (!glfwWindowShouldClose(window))
   {
+    // Upload the textures decoded since the last frame, then stream mips and virtual
+    // texture pages for the previous frames' view
+    uploadRing().BeginFrame();
+    textureLoader().Update();
+    textureStreamer().Update();
+    textureArrays().BeginFrame();
+    virtualTexture().Update();
+    Shader::UpdateReloads();
+    resources().Update();
+
     scene.Draw();  
+    uniformStats().EndFrame();
+    glState().EndFrame();
+    meshArena().EndFrame();
     // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
     // -------------------------------------------------------------------------------
     glfwSwapBuffers(window);
@@ -2,7 +2,7 @@
 out vec4 FragColor;
 
 struct Material {
-  sampler2D diffuse;
+  sampler2DArray diffuse;
   float shininess;
 };
 
@@ -20,17 +20,18 @@ in vec2 TexCoord;
 uniform Material material;
 uniform Light light;
 uniform vec3 viewPos;
+uniform ivec4 layers; // texture array layers, diffuse in x
 
 void main()
 {
     // ambient
-    vec3 ambient = light.ambient * texture(material.diffuse, TexCoord).rgb;
+    vec3 ambient = light.ambient * texture(material.diffuse, vec3(TexCoord, layers.x)).rgb;
   	
     // diffuse 
     vec3 norm = normalize(Normal);
     vec3 lightDir = normalize(light.position - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = light.diffuse * diff * texture(material.diffuse, TexCoord).rgb;
+    vec3 diffuse = light.diffuse * diff * texture(material.diffuse, vec3(TexCoord, layers.x)).rgb;
     
     // specular
     vec3 viewDir = normalize(viewPos - FragPos);
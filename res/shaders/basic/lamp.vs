@@ -2,8 +2,9 @@
 layout (location = 0) in vec3 aPos;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// Shared with the ubershader
+#include "../include/blocks.glsl"
 
 void main()
 {
@@ -14,12 +14,13 @@ struct Light {
 };
 
 uniform Light lights[4];
-uniform sampler2D diffuseMap;
+uniform sampler2DArray diffuseMap;
+uniform ivec4 layers; // texture array layers, diffuse in x
 uniform vec3 viewPos;
 
 void main()
 {           
-  vec3 color = texture(diffuseMap, fs_in.TexCoords).rgb;
+  vec3 color = texture(diffuseMap, vec3(fs_in.TexCoords, layers.x)).rgb;
   vec3 normal = normalize(fs_in.Normal);
   // ambient
   vec3 ambient = 0.0 * color;
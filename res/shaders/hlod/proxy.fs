@@ -0,0 +1,30 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+flat in vec4 Tile;
+
+struct Light {
+  vec3 position;
+  vec3 ambient;
+  vec3 diffuse;
+};
+
+uniform Light light;
+uniform sampler2D atlas;
+
+void main()
+{
+  // Wrap the original (tiling) UVs inside the material's atlas tile, gradients are
+  // taken before the wrap so mip selection doesn't break at the seams
+  vec2 uv = Tile.xy + fract(TexCoords) * Tile.zw;
+  vec3 color = textureGrad(atlas, uv, dFdx(TexCoords) * Tile.zw, dFdy(TexCoords) * Tile.zw).rgb;
+
+  vec3 normal = normalize(Normal);
+  vec3 lightDir = normalize(light.position - FragPos);
+  float diff = max(dot(lightDir, normal), 0.0);
+
+  FragColor = vec4((light.ambient + diff * light.diffuse) * color, 1.0);
+}
@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec4 aTile;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+flat out vec4 Tile;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+  FragPos = vec3(model * vec4(aPos, 1.0));
+  Normal = transpose(inverse(mat3(model))) * aNormal;
+  TexCoords = aTexCoords;
+  Tile = aTile;
+  gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
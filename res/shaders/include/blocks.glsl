@@ -0,0 +1,17 @@
+// Shared uniform blocks (see UniformBlocks.h): the camera and light of the frame.
+// Every program including this gets the same binding points when it is linked (see
+// Shader).
+layout (std140) uniform Camera {
+  mat4 projection;
+  mat4 view;
+  vec3 viewPos;
+};
+
+layout (std140) uniform Light {
+  vec3 position;
+  float farPlane;
+  vec3 ambient;
+  float shininess;
+  vec3 diffuse;
+  vec3 specular;
+} light;
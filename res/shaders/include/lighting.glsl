@@ -0,0 +1,12 @@
+// Blinn-Phong terms, directions normalized and pointing away from the surface
+
+float lambert(vec3 normal, vec3 lightDir)
+{
+  return max(dot(lightDir, normal), 0.0);
+}
+
+float blinnPhong(vec3 normal, vec3 lightDir, vec3 viewDir, float shininess)
+{
+  vec3 halfwayDir = normalize(lightDir + viewDir);
+  return pow(max(dot(normal, halfwayDir), 0.0), shininess);
+}
@@ -0,0 +1,31 @@
+// Material table (see MaterialTable.h): five RGBA32F texels per entry, the entry of a
+// draw given by its material ID attribute
+uniform samplerBuffer materialTable;
+
+struct MaterialEntry
+{
+  vec3 ambient;
+  vec3 diffuse;
+  vec3 specular;
+  ivec4 layers;           // texture array layers of the diffuse, normal, specular and mask maps, -1 for none
+  int diffuseAlpha;       // 0 nothing, 1 the alpha mask, 2 the specular intensity (see ChannelPack.h)
+  bool hasVirtualTexture;
+  vec4 vtRegion;          // of the diffuse map in the virtual texture
+};
+
+MaterialEntry fetchMaterial(uint id)
+{
+  int base = int(id) * 5;
+  vec4 ambient = texelFetch(materialTable, base);
+  vec4 diffuse = texelFetch(materialTable, base + 1);
+
+  MaterialEntry m;
+  m.ambient = ambient.rgb;
+  m.diffuse = diffuse.rgb;
+  m.specular = texelFetch(materialTable, base + 2).rgb;
+  m.layers = ivec4(texelFetch(materialTable, base + 3));
+  m.diffuseAlpha = int(ambient.w);
+  m.hasVirtualTexture = diffuse.w > 0.5;
+  m.vtRegion = texelFetch(materialTable, base + 4);
+  return m;
+}
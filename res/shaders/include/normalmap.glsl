@@ -0,0 +1,8 @@
+// Tangent space normal from the red and green of a normal map texel: X and Y in [0,1]
+// are brought to [-1,1] and Z is rebuilt, the normal being unit length (cooked normal
+// maps are BC5 and only store these two channels)
+vec3 unpackNormal(vec2 rg)
+{
+  vec2 xy = rg * 2.0 - 1.0;
+  return normalize(vec3(xy, sqrt(max(0.0, 1.0 - dot(xy, xy)))));
+}
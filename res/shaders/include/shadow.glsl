@@ -0,0 +1,28 @@
+// Omnidirectional shadows (see ShadowMap.h): the cubemap holds the distance to the
+// light over farPlane. Returns how much of the light is blocked at fragToLight
+// (fragment minus light position), with 20 samples over a disk of diskRadius when soft.
+float omniShadow(samplerCube shadowMap, vec3 fragToLight, float farPlane, float bias, bool soft, float diskRadius)
+{
+  float currentDepth = length(fragToLight);
+  if (!soft)
+    return currentDepth - bias > texture(shadowMap, fragToLight).r * farPlane ? 1.0 : 0.0;
+
+  vec3 sampleOffsetDirections[20] = vec3[]
+  (
+   vec3( 1,  1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1,  1,  1), 
+   vec3( 1,  1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1,  1, -1),
+   vec3( 1,  1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1,  1,  0),
+   vec3( 1,  0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1,  0, -1),
+   vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
+  );
+
+  float shadow = 0.0;
+  for (int i = 0; i < 20; ++i)
+  {
+    float closestDepth = texture(shadowMap, fragToLight + sampleOffsetDirections[i] * diskRadius).r;
+    closestDepth *= farPlane;   // Undo mapping [0;1]
+    if (currentDepth - bias > closestDepth)
+      shadow += 1.0;
+  }
+  return shadow / 20.0;
+}
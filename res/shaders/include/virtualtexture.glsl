@@ -0,0 +1,11 @@
+// Virtual texturing (see VirtualTexture.h): region of the mesh's texture in the virtual
+// texture, and params = pages, mips, page size, border
+
+// Mip wanted at uv, from the derivatives in virtual texels before the wrap
+float virtualTextureMip(vec2 uv, vec4 region, vec4 params, float bias)
+{
+  vec2 texels = uv * region.zw * params.x * params.z;
+  vec2 dx = dFdx(texels), dy = dFdy(texels);
+  float mip = floor(0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + bias);
+  return clamp(mip, 0.0, params.y - 1.0);
+}
@@ -15,37 +15,33 @@ struct Light {
   vec3 specular;
 }; 
 
-uniform sampler2D diffuseMap;
-uniform sampler2D normalMap;
+uniform sampler2DArray diffuseMap;
+uniform sampler2DArray normalMap;
+uniform ivec4 layers; // texture array layers, diffuse in x and normal in y
 uniform Light light;
 uniform float shininess;
 
+#include "../include/lighting.glsl"
+#include "../include/normalmap.glsl"
+
 void main()
 {           
-  // obtain normal from normal map in range [0,1]
-  vec3 normal = texture(normalMap, fs_in.TexCoords).rgb;
-
-  // transform normal vector to range [-1,1]
-  normal = normalize(normal * 2.0 - 1.0);  // this normal is in tangent space
+  // tangent space normal from the normal map
+  vec3 normal = unpackNormal(texture(normalMap, vec3(fs_in.TexCoords, layers.y)).rg);
 
   // get diffuse color
-  vec3 color = texture(diffuseMap, fs_in.TexCoords).rgb;
+  vec3 color = texture(diffuseMap, vec3(fs_in.TexCoords, layers.x)).rgb;
 
   // ambient
   vec3 ambient = light.ambient * color;
 
   // diffuse
   vec3 lightDir = normalize(fs_in.TangentLightPos - fs_in.TangentFragPos);
-  float diff = max(dot(lightDir, normal), 0.0);
-  vec3 diffuse = light.diffuse * diff * color;
+  vec3 diffuse = light.diffuse * lambert(normal, lightDir) * color;
 
   // specular
   vec3 viewDir = normalize(fs_in.TangentViewPos - fs_in.TangentFragPos);
-  vec3 reflectDir = reflect(-lightDir, normal);
-  vec3 halfwayDir = normalize(lightDir + viewDir);  
-  float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
-
-  vec3 specular = light.specular * spec;
+  vec3 specular = light.specular * blinnPhong(normal, lightDir, viewDir, shininess);
 
   FragColor = vec4(ambient + diffuse + specular, 1.0);
   //FragColor = vec4(texture(diffuseMap, fs_in.TexCoords).rgb, 1.0);
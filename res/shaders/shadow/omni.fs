@@ -1,15 +1,15 @@
 #version 330 core
 in vec4 FragPos;
 
-uniform vec3 lightPos;
-uniform float far_plane;
+// Shared with the ubershader
+#include "../include/blocks.glsl"
 
 void main()
 {
-    float lightDistance = length(FragPos.xyz - lightPos);
+    float lightDistance = length(FragPos.xyz - light.position);
     
-    // map to [0;1] range by dividing by far_plane
-    lightDistance = lightDistance / far_plane;
+    // map to [0;1] range by dividing by the far plane
+    lightDistance = lightDistance / light.farPlane;
     
     // write this as modified depth
     gl_FragDepth = lightDistance;
@@ -15,7 +15,7 @@ in vec2 TexCoord;
 uniform Light light;
 uniform vec3 viewPos;
 
-uniform sampler2D heightmap;
+uniform sampler2D terrainMap; // height in alpha
 uniform sampler2D grass;
 uniform sampler2D snow;
 uniform sampler2D dirt;
@@ -23,7 +23,7 @@ uniform sampler2D dirt;
 void main()
 {    
   // Texture mix
-  float h = texture(heightmap, TexCoord).r;
+  float h = texture(terrainMap, TexCoord).a;
   
   vec3 texMix;
   if (h < 0.5)
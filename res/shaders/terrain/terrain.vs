@@ -11,30 +11,19 @@ out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoord;
 
-uniform sampler2D heightmap;
+// Baked by Terrain::SetElevation: normal in rgb, height in alpha
+uniform sampler2D terrainMap;
 uniform float elevation;
 
-float height(vec2 i)
-{
-  float h = texture(heightmap, i).r;
-  return (h*2)-1;
-}
-
 void main()
 {
-  vec3 elevPos = vec3(aPos.x, height(aPos.xz) * elevation, aPos.z);
+  // One fetch for the texel under the vertex (aPos.xz is x / width, z / height)
+  vec4 texel = texelFetch(terrainMap, ivec2(aPos.xz * vec2(textureSize(terrainMap, 0)) + 0.5), 0);
+  vec3 elevPos = vec3(aPos.x, (texel.a * 2 - 1) * elevation, aPos.z);
 
   FragPos = vec3(model * vec4(elevPos, 1.0));
   TexCoord = aPos.xz;
   gl_Position = projection * view * model * vec4(elevPos, 1.0);
 
-  // Central difference method to compute normals
-  vec3 off = vec3(1.2, 0.0, 1.2);
-  float hL = height(aPos.xz - off.xy);
-  float hR = height(aPos.xz + off.xy);
-  float hD = height(aPos.xz - off.yz);
-  float hU = height(aPos.xz + off.yz);
-  
-  // Deduce terrain normal
-  Normal = normalize(vec3(hL - hR, 2.0, hD - hU));
+  Normal = texel.rgb * 2 - 1;
 }
@@ -10,114 +10,121 @@ in VS_OUT {
   vec3 TangentLightPos;
   vec3 TangentViewPos;
   vec3 TangentFragPos;
-} fs_in;
-
-struct Material {
-  sampler2D diffuseMap;
-  vec3 ambient;
-  vec3 diffuse;
-  vec3 specular;
-  float shininess;
-};
-
-struct Light {
-    vec3 position;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
 
-uniform Material material;
-uniform Light light;
+  flat uint MaterialID;
+} fs_in;
 
-uniform vec3 viewPos;
+#include "include/blocks.glsl"
+#include "include/lighting.glsl"
+#include "include/normalmap.glsl"
+#include "include/shadow.glsl"
+#include "include/virtualtexture.glsl"
+#include "include/materials.glsl"
+
+uniform sampler2DArray diffuseMap;
+
+// Feature switches: tested at run time, or constants when compiled as a permutation
+// (see ShaderVariants.h) so the unused paths compile out, the mask's discard included.
+// Scene switches are uniforms, material switches are set from the draw's entry in the
+// material table (see readMaterial).
+#ifdef PERMUTATION
+#define FEATURE(type, name, value) const type name = value
+#define MATERIAL_FEATURE(type, name, value) const type name = value
+#else
+#define FEATURE(type, name, value) uniform type name
+#define MATERIAL_FEATURE(type, name, value) type name
+#endif
+
+// The draw's material: colors, texture array layers, virtual texture region
+MaterialEntry material;
 
 // Shadows
 uniform samplerCube shadowMap;
-uniform bool softShadows;
-uniform bool hasShadows;
-uniform float far_plane;
+FEATURE(bool, softShadows, SOFT_SHADOWS);
+FEATURE(bool, hasShadows, HAS_SHADOWS);
 uniform float bias;
 
 // Normal mapping
-uniform bool hasNormalMap;
-uniform sampler2D normalMap;
+MATERIAL_FEATURE(bool, hasNormalMap, HAS_NORMAL_MAP);
+uniform sampler2DArray normalMap;
 
 // Specular map
-uniform bool hasSpecularMap;
-uniform sampler2D specularMap;
+MATERIAL_FEATURE(bool, hasSpecularMap, HAS_SPECULAR_MAP);
+uniform sampler2DArray specularMap;
 
 // Alpha masking
-uniform bool hasMaskMap;
-uniform sampler2D maskMap;
+MATERIAL_FEATURE(bool, hasMaskMap, HAS_MASK_MAP);
+uniform sampler2DArray maskMap;
+
+// What the diffuse alpha holds (see ChannelPack.h): 0 nothing, 1 the alpha mask,
+// 2 the specular intensity
+MATERIAL_FEATURE(int, diffuseAlpha, DIFFUSE_ALPHA);
+
+// Virtual texturing of the diffuse map (see VirtualTexture.h): physical page cache,
+// indirection (rgb = cache slot, resident mip), and pages, mips, page size, border;
+// the region of the mesh's texture is in its material
+MATERIAL_FEATURE(bool, hasVirtualTexture, HAS_VIRTUAL_TEXTURE);
+uniform sampler2D vtCache;
+uniform sampler2D vtIndirection;
+uniform vec4 vtParams;
+uniform float vtCacheTexels;
 
 float ShadowCalculation(vec3 fragPos)
 {
-  vec3 fragToLight = fragPos - light.position;
-  float closestDepth = texture(shadowMap, fragToLight).r;
-  closestDepth *= far_plane;
+  float viewDistance = length(viewPos - fragPos);
+  float diskRadius = (1.0 + (viewDistance / light.farPlane)) / 25.0;
+  return omniShadow(shadowMap, fragPos - light.position, light.farPlane, bias, softShadows, diskRadius);
+}
 
-  float currentDepth = length(fragToLight);
+vec3 computeNormal()
+{
+  return unpackNormal(texture(normalMap, vec3(fs_in.TexCoords, material.layers.y)).rg);
+}
 
-  float shadow = 0.0;
+vec3 sampleVirtualTexture(vec2 uv)
+{
+  float mip = virtualTextureMip(uv, material.vtRegion, vtParams, 0.0);
 
-  if (!softShadows)
-  {
-    // Hard shadows
-    shadow = currentDepth - bias > closestDepth  ? 1.0 : 0.0;
-  }
-  else
-  {
-    // Soft shadows
-    vec3 sampleOffsetDirections[20] = vec3[]
-    (
-     vec3( 1,  1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1,  1,  1), 
-     vec3( 1,  1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1,  1, -1),
-     vec3( 1,  1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1,  1,  0),
-     vec3( 1,  0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1,  0, -1),
-     vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
-    );
-
-    int samples  = 20;
-    float viewDistance = length(viewPos - fragPos);
-    float diskRadius = (1.0 + (viewDistance / far_plane)) / 25.0;
-    for(int i = 0; i < samples; ++i)
-    {
-      float closestDepth = texture(shadowMap, fragToLight + sampleOffsetDirections[i] * diskRadius).r;
-      closestDepth *= far_plane;   // Undo mapping [0;1]
-      if(currentDepth - bias > closestDepth)
-        shadow += 1.0;
-    }
-    shadow /= float(samples);  
-  }
-      
-  FragColor = vec4(vec3(closestDepth / far_plane), 1.0);
+  vec2 virtualUV = material.vtRegion.xy + fract(uv) * material.vtRegion.zw;
+  float side = vtParams.x / exp2(mip);
+  vec4 entry = floor(texelFetch(vtIndirection, ivec2(min(virtualUV * side, side - 1.0)), int(mip)) * 255.0 + 0.5);
 
-  return shadow;
+  // Position inside the page actually resident, which may be coarser than mip
+  vec2 inPage = fract(virtualUV * (vtParams.x / exp2(entry.z)));
+  vec2 texel = entry.xy * (vtParams.z + 2.0 * vtParams.w) + vtParams.w + inPage * vtParams.z;
+  return textureLod(vtCache, texel / vtCacheTexels, 0.0).rgb;
 }
 
-vec3 computeNormal()
+void readMaterial()
 {
-  // obtain normal from normal map in range [0,1]
-  vec3 normal = texture(normalMap, fs_in.TexCoords).rgb;
-
-  // transform normal vector to range [-1,1]
-  normal = normalize(normal * 2.0 - 1.0);  // this normal is in tangent space
-
-  return normal;
+  material = fetchMaterial(fs_in.MaterialID);
+#ifndef PERMUTATION
+  hasNormalMap = material.layers.y >= 0;
+  hasSpecularMap = material.layers.z >= 0;
+  hasMaskMap = material.layers.w >= 0;
+  diffuseAlpha = material.diffuseAlpha;
+  hasVirtualTexture = material.hasVirtualTexture;
+#endif
 }
 
 void main()
-{           
+{
+  readMaterial();
+
   // Alpha masking
   if (hasMaskMap) {
-    vec4 alpha = texture(maskMap, fs_in.TexCoords).rgba;
+    vec4 alpha = texture(maskMap, vec3(fs_in.TexCoords, material.layers.w)).rgba;
     FragColor = vec4(0.0, alpha.a, 0.0, 1.0);
     if (alpha.r < 0.1)
       discard;
   }
 
-  vec3 color = texture(material.diffuseMap, fs_in.TexCoords).rgb;
+  vec4 diffuseTexel = hasVirtualTexture ? vec4(sampleVirtualTexture(fs_in.TexCoords), 1.0)
+    : texture(diffuseMap, vec3(fs_in.TexCoords, material.layers.x));
+  if (diffuseAlpha == 1 && diffuseTexel.a < 0.1)
+    discard;
+
+  vec3 color = diffuseTexel.rgb;
   vec3 normal = hasNormalMap ? computeNormal() : normalize(fs_in.Normal);
 
   // Ambient
@@ -125,18 +132,16 @@ void main()
 
   // Diffuse
   vec3 lightDir = hasNormalMap ? normalize(fs_in.TangentLightPos - fs_in.TangentFragPos) : normalize(light.position - fs_in.FragPos);
-  float diff = max(dot(lightDir, normal), 0.0);
-  vec3 diffuse = diff * material.diffuse * color * light.diffuse;
+  vec3 diffuse = lambert(normal, lightDir) * material.diffuse * color * light.diffuse;
 
   // Specular
   vec3 viewDir = hasNormalMap ? normalize(fs_in.TangentViewPos - fs_in.TangentFragPos) : normalize(viewPos - fs_in.FragPos);
-  float spec = 0.0;
-  vec3 halfwayDir = normalize(lightDir + viewDir);  
-  spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-  vec3 specular = spec * material.specular * light.specular;    
+  vec3 specular = blinnPhong(normal, lightDir, viewDir, light.shininess) * material.specular * light.specular;
 
   if (hasSpecularMap)
-    specular *= texture(specularMap, fs_in.TexCoords).rgb;
+    specular *= texture(specularMap, vec3(fs_in.TexCoords, material.layers.z)).rgb;
+  else if (diffuseAlpha == 2)
+    specular *= diffuseTexel.a;
 
   // Calculate shadow
   float shadow = hasShadows ? ShadowCalculation(fs_in.FragPos) : 0.0;
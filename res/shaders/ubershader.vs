@@ -3,6 +3,7 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 layout (location = 3) in vec3 aTangent;
+layout (location = 5) in uint aMaterial; // entry in the material table
 
 out VS_OUT {
   vec3 FragPos;
@@ -13,16 +14,22 @@ out VS_OUT {
   vec3 TangentLightPos;
   vec3 TangentViewPos;
   vec3 TangentFragPos;
+
+  flat uint MaterialID;
 } vs_out;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
-// Normal mapping
-uniform bool hasNormalMap;
-uniform vec3 lightPos;
-uniform vec3 viewPos;
+#include "include/blocks.glsl"
+#include "include/materials.glsl"
+
+// Normal mapping, a constant in permutations (see ShaderVariants.h), from the
+// material's normal map layer otherwise
+#ifdef PERMUTATION
+const bool hasNormalMap = HAS_NORMAL_MAP;
+#else
+#define hasNormalMap (fetchMaterial(aMaterial).layers.y >= 0)
+#endif
 
 uniform float time;
 
@@ -30,6 +37,7 @@ void main()
 {
   vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
   vs_out.TexCoords = aTexCoords;
+  vs_out.MaterialID = aMaterial;
 
   // Calculate TBN for normal mapping
   if (hasNormalMap)
@@ -41,7 +49,7 @@ void main()
     vec3 B = cross(N, T);
 
     mat3 TBN = transpose(mat3(T, B, N));    
-    vs_out.TangentLightPos = TBN * lightPos;
+    vs_out.TangentLightPos = TBN * light.position;
     vs_out.TangentViewPos  = TBN * viewPos;
     vs_out.TangentFragPos  = TBN * vs_out.FragPos;
   }
@@ -0,0 +1,51 @@
+#version 330 core
+out vec4 FragColor;
+
+// Same interface as ubershader.vs, which the feedback pass reuses
+in VS_OUT {
+  vec3 FragPos;
+  vec3 Normal;
+  vec2 TexCoords;
+
+  // Normal mapping
+  vec3 TangentLightPos;
+  vec3 TangentViewPos;
+  vec3 TangentFragPos;
+
+  flat uint MaterialID;
+} fs_in;
+
+// Virtual texture (see VirtualTexture.h): pages, mips, page size, border; the region
+// of the mesh's texture is in its material
+uniform vec4 vtParams;
+// The feedback buffer is smaller than the screen, derivatives are larger by as much
+uniform float vtMipBias;
+
+// Alpha masking, so cut out texels do not request pages
+uniform sampler2DArray maskMap;
+uniform sampler2DArray diffuseMap;
+
+#include "../include/virtualtexture.glsl"
+#include "../include/materials.glsl"
+
+void main()
+{
+  MaterialEntry material = fetchMaterial(fs_in.MaterialID);
+  if (material.layers.w >= 0 && texture(maskMap, vec3(fs_in.TexCoords, material.layers.w)).r < 0.1)
+    discard;
+  if (material.diffuseAlpha == 1 && texture(diffuseMap, vec3(fs_in.TexCoords, material.layers.x)).a < 0.1)
+    discard;
+
+  if (!material.hasVirtualTexture)
+  {
+    FragColor = vec4(0.0);
+    return;
+  }
+
+  // Page and mip wanted, as in sampleVirtualTexture of ubershader.fs
+  float mip = virtualTextureMip(fs_in.TexCoords, material.vtRegion, vtParams, vtMipBias);
+
+  vec2 virtualUV = material.vtRegion.xy + fract(fs_in.TexCoords) * material.vtRegion.zw;
+  vec2 page = min(floor(virtualUV * (vtParams.x / exp2(mip))), vtParams.x / exp2(mip) - 1.0);
+  FragColor = vec4(page, mip, 255.0) / 255.0;
+}